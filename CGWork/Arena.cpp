@@ -0,0 +1,75 @@
+/* Implementation of the Arena class */
+
+#include "Arena.h"
+
+Arena::Arena() : m_blocks(nullptr), m_current(nullptr), m_end(nullptr),
+                 m_next_block_size(ARENA_FIRST_BLOCK_SIZE), m_allocations_nr(0), m_blocks_nr(0),
+                 m_bytes_allocated(0), m_bytes_reserved(0)
+{
+}
+
+Arena::~Arena()
+{
+    Release();
+}
+
+void Arena::Grow(size_t size, size_t alignment)
+{
+    size_t block_size = m_next_block_size;
+
+    // Big allocations get a block of their own size
+    if (block_size < size + alignment)
+        block_size = size + alignment;
+
+    Block *block = static_cast<Block *>(::operator new(sizeof(Block) + block_size));
+    block->next = m_blocks;
+    block->size = block_size;
+    m_blocks = block;
+
+    m_current = (char *)(block + 1);
+    m_end = m_current + block_size;
+
+    if (m_next_block_size < ARENA_MAX_BLOCK_SIZE)
+        m_next_block_size *= 2;
+
+    m_blocks_nr++;
+    m_bytes_reserved += block_size;
+}
+
+void Arena::FreeBlocksAfter(Block *first)
+{
+    Block *block = (first) ? first->next : m_blocks;
+
+    while (block) {
+        Block *next = block->next;
+
+        m_bytes_reserved -= block->size;
+        ::operator delete(block);
+        block = next;
+    }
+
+    if (first)
+        first->next = nullptr;
+    else
+        m_blocks = nullptr;
+}
+
+void Arena::Reset()
+{
+    if (!m_blocks)
+        return;
+
+    FreeBlocksAfter(m_blocks);
+
+    m_current = (char *)(m_blocks + 1);
+    m_end = m_current + m_blocks->size;
+}
+
+void Arena::Release()
+{
+    FreeBlocksAfter(nullptr);
+
+    m_current = nullptr;
+    m_end = nullptr;
+    m_next_block_size = ARENA_FIRST_BLOCK_SIZE;
+}
@@ -0,0 +1,166 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+/* Header file for the arena allocator */
+
+#include <stddef.h>
+#include <new>
+#include <utility>
+
+// Size of an arena's first block, the following ones grow up to the max
+#define ARENA_FIRST_BLOCK_SIZE (64 * 1024)
+#define ARENA_MAX_BLOCK_SIZE (1024 * 1024)
+
+/* A bump allocator.
+ *
+ * Memory is handed out from a few large blocks by advancing a pointer,
+ * and is only given back all at once, by Reset() or when the arena is
+ * destroyed. Objects allocated from an arena never have their destructor
+ * called by it, so it should only hold trivially destructible types, or
+ * objects which are destroyed by hand before the arena is reset.
+ */
+class Arena
+{
+    struct Block
+    {
+        Block *next;
+        size_t size; // Usable bytes following the header
+    };
+
+    Block *m_blocks; // Newest (and biggest) first
+    char *m_current;
+    char *m_end;
+    size_t m_next_block_size;
+
+    // Statistics, for as long as the arena lives
+    size_t m_allocations_nr;
+    size_t m_blocks_nr;
+    size_t m_bytes_allocated;
+    size_t m_bytes_reserved;
+
+    // Allocates a new block which can hold at least @size bytes
+    void Grow(size_t size, size_t alignment);
+
+    // Frees all the blocks after @first
+    void FreeBlocksAfter(Block *first);
+
+public:
+    Arena();
+
+    ~Arena();
+
+    // Arenas own their blocks
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    /* Returns @size bytes aligned to @alignment (which must be a power of 2).
+     * Never returns null - throws std::bad_alloc like new does.
+     */
+    void *Allocate(size_t size, size_t alignment = alignof(double))
+    {
+        char *aligned = (char *)(((size_t)m_current + alignment - 1) & ~(alignment - 1));
+
+        if (!m_current || size > (size_t)(m_end - aligned)) {
+            Grow(size, alignment);
+            aligned = (char *)(((size_t)m_current + alignment - 1) & ~(alignment - 1));
+        }
+
+        m_current = aligned + size;
+        m_allocations_nr++;
+        m_bytes_allocated += size;
+
+        return aligned;
+    }
+
+    // Constructs a T in the arena
+    template <class T, class... Args>
+    T *New(Args &&... args)
+    {
+        return new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    /* Frees everything that was allocated from the arena. The biggest block
+     * is kept, so an arena which is reused doesn't have to grow again.
+     */
+    void Reset();
+
+    // Like Reset(), but gives all the blocks back to the system
+    void Release();
+
+    size_t getAllocationsNr() const
+    {
+        return m_allocations_nr;
+    }
+
+    size_t getBlocksNr() const
+    {
+        return m_blocks_nr;
+    }
+
+    size_t getBytesAllocated() const
+    {
+        return m_bytes_allocated;
+    }
+
+    size_t getBytesReserved() const
+    {
+        return m_bytes_reserved;
+    }
+};
+
+/* Lets standard containers allocate from an arena. Deallocating does
+ * nothing - the memory is freed when the arena is.
+ * A default constructed allocator uses the regular heap.
+ */
+template <class T>
+class ArenaAllocator
+{
+    template <class U>
+    friend class ArenaAllocator;
+
+    Arena *m_arena;
+
+public:
+    typedef T value_type;
+
+    ArenaAllocator() : m_arena(nullptr)
+    {
+    }
+
+    ArenaAllocator(Arena *arena) : m_arena(arena)
+    {
+    }
+
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : m_arena(other.m_arena)
+    {
+    }
+
+    T *allocate(size_t count)
+    {
+        if (!m_arena)
+            return static_cast<T *>(::operator new(count * sizeof(T)));
+
+        return static_cast<T *>(m_arena->Allocate(count * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *pointer, size_t)
+    {
+        if (!m_arena)
+            ::operator delete(pointer);
+    }
+
+    template <class U>
+    bool operator==(const ArenaAllocator<U> &other) const
+    {
+        return m_arena == other.m_arena;
+    }
+
+    template <class U>
+    bool operator!=(const ArenaAllocator<U> &other) const
+    {
+        return m_arena != other.m_arena;
+    }
+};
+
+#endif // __ARENA_H__
@@ -12,16 +12,21 @@ CEx2Dialog::CEx2Dialog(CWnd* pParent /*=NULL*/)
 	: CDialog(IDD_SENS_DISTANCE, pParent),
 	m_sensitivity(1.0),
 	m_distance(1.0),
-	m_fineness(20.0)
+	m_fineness(20.0),
+	m_tessellation_mode(0),
+	m_tolerance(0.01)
 {
 }
 
-CEx2Dialog::CEx2Dialog(double sensitivity, double distance, double fineness, CWnd* pParent)
+CEx2Dialog::CEx2Dialog(double sensitivity, double distance, double fineness, int tessellation_mode,
+					   double tolerance, CWnd* pParent)
 	: CDialog(IDD_SENS_DISTANCE, pParent)
 {
 	m_sensitivity = sensitivity;
 	m_distance = distance;
 	m_fineness = fineness;
+	m_tessellation_mode = tessellation_mode;
+	m_tolerance = tolerance;
 }
 
 CEx2Dialog::~CEx2Dialog()
@@ -31,14 +36,23 @@ CEx2Dialog::~CEx2Dialog()
 BOOL CEx2Dialog::OnInitDialog()
 {
 	CString string;
+	CComboBox *modes = (CComboBox *)GetDlgItem(IDC_TESSELLATION_MODE);
+
+	// In the order of TessellationMode, before the data exchange selects one
+	modes->AddString(_T("Uniform (fineness)"));
+	modes->AddString(_T("Chordal deviation"));
+	modes->AddString(_T("Normal deviation (degrees)"));
+
 	BOOL result = CDialog::OnInitDialog();
 
 	string.Format(_T("%0.3f"), m_sensitivity);
 	GetDlgItem(IDC_SENS)->SetWindowText(string);
 	string.Format(_T("%0.3f"), m_distance);
 	GetDlgItem(IDC_DISTANCE)->SetWindowText(string);
-	string.Format(_T("%0.3f"), m_distance);
+	string.Format(_T("%0.3f"), m_fineness);
 	GetDlgItem(IDC_FINENESS)->SetWindowText(string);
+	string.Format(_T("%g"), m_tolerance);
+	GetDlgItem(IDC_TOLERANCE)->SetWindowText(string);
 
 	return result;
 }
@@ -52,6 +66,9 @@ void CEx2Dialog::DoDataExchange(CDataExchange* pDX)
 	DDV_MinMaxDouble(pDX, m_distance, 0.1, INT_MAX);
 	DDX_Text(pDX, IDC_FINENESS, m_fineness);
 	DDV_MinMaxDouble(pDX, m_fineness, 2.0, INT_MAX);
+	DDX_CBIndex(pDX, IDC_TESSELLATION_MODE, m_tessellation_mode);
+	DDX_Text(pDX, IDC_TOLERANCE, m_tolerance);
+	DDV_MinMaxDouble(pDX, m_tolerance, 1e-6, INT_MAX);
 }
 
 
@@ -13,9 +13,12 @@ public:
 	double m_sensitivity,
 		m_distance,
 		m_fineness;
+	int m_tessellation_mode;	// A TessellationMode
+	double m_tolerance;
 
 	CEx2Dialog(CWnd* pParent = NULL);   // standard constructor
-	CEx2Dialog(double sensitivity, double distance, double fineness, CWnd* pParent = nullptr);
+	CEx2Dialog(double sensitivity, double distance, double fineness, int tessellation_mode,
+			   double tolerance, CWnd* pParent = nullptr);
 
 
 	virtual ~CEx2Dialog();
@@ -8,6 +8,8 @@
 #include "CGDialog.h"
 
 #include <math.h>
+#include <chrono>
+#include <vector>
 
 #include <iostream>
 using std::cout;
@@ -33,9 +35,15 @@ static char THIS_FILE[] = __FILE__;
 // Use this macro to display text messages in the status bar.
 #define STATUS_BAR_TEXT(str) (((CMainFrame*)GetParentFrame())->getStatusBar().SetWindowText(str))
 
+// Characters for the names of the files selected in the load dialog
+#define LOAD_FILE_NAMES_BUFFER_SIZE (64 * 1024)
+
+typedef std::chrono::steady_clock CGWorkClock;
+
 IritWorld world;
 
 static CPoint mouse_location;
+static LONG last_mouse_x; // Where the previous mouse move event was
 
 static bool is_mouse_down;
 IritFigure *chosen_figure;
@@ -58,6 +66,8 @@ BEGIN_MESSAGE_MAP(CCGWorkView, CView)
 	ON_UPDATE_COMMAND_UI(ID_VIEW_ORTHOGRAPHIC, OnUpdateViewOrthographic)
 	ON_COMMAND(ID_VIEW_PERSPECTIVE, OnViewPerspective)
 	ON_UPDATE_COMMAND_UI(ID_VIEW_PERSPECTIVE, OnUpdateViewPerspective)
+	ON_COMMAND(ID_VIEW_FRAME_STATS, OnViewFrameStats)
+	ON_UPDATE_COMMAND_UI(ID_VIEW_FRAME_STATS, OnUpdateViewFrameStats)
 	ON_COMMAND(ID_ACTION_ROTATE, OnActionRotate)
 	ON_UPDATE_COMMAND_UI(ID_ACTION_ROTATE, OnUpdateActionRotate)
 	ON_COMMAND(ID_ACTION_SCALE, OnActionScale)
@@ -97,6 +107,9 @@ BEGIN_MESSAGE_MAP(CCGWorkView, CView)
 	ON_WM_LBUTTONDOWN()
 	ON_WM_MOUSEMOVE()
 	ON_WM_LBUTTONUP()
+	ON_MESSAGE(WM_LOAD_PROGRESS, OnLoadProgress)
+	ON_MESSAGE(WM_TESSELLATION_DONE, OnTessellationDone)
+	ON_WM_KEYDOWN()
 END_MESSAGE_MAP()
 
 
@@ -132,6 +145,9 @@ CCGWorkView::CCGWorkView()
 	m_lights[LIGHT_ID_1].enabled=true;
 	m_pDbBitMap = NULL;
 	m_pDbDC = NULL;
+	m_is_tessellation_report_pending = false;
+	m_is_tessellation_report_wanted = false;
+	m_is_frame_stats_shown = false;
 }
 
 CCGWorkView::~CCGWorkView()
@@ -319,9 +335,28 @@ void CCGWorkView::OnDraw(CDC* pDC)
 		bitmap[i] = *((int*)&background);
 	}
 
+	CGWorkClock::time_point draw_start = CGWorkClock::now();
+
 	if (!world.isEmpty())
 		world.draw(bitmap, w, h);
 
+	// Frames which only repaint transform nothing, the objects keep their transformed vertices
+	if (m_is_frame_stats_shown && !m_load && !m_tessellation) {
+		const FrameStats &stats = world.getFrameStats();
+		CString status;
+
+		status.Format(_T("Frame: %lld vertices transformed, %lld lines drawn in %.1f ms"),
+					  stats.vertices_transformed, stats.lines_drawn,
+					  std::chrono::duration<double, std::milli>(CGWorkClock::now() - draw_start).count());
+		STATUS_BAR_TEXT(status);
+	}
+
+	// Tessellations are compared by how many polygons they have, and how long they take to draw
+	if (m_is_tessellation_report_pending) {
+		m_is_tessellation_report_pending = false;
+		ReportTessellation(std::chrono::duration<double, std::milli>(CGWorkClock::now() - draw_start).count());
+	}
+
 	SetDIBits(hdcMem, bm, 0, h, bitmap, &bminfo, DIB_RGB_COLORS);
 
 	BitBlt(pDC->m_hDC, rect.left, rect.top, w, h, hdcMem, rect.left, rect.top, SRCCOPY);
@@ -338,6 +373,16 @@ void CCGWorkView::OnDraw(CDC* pDC)
 
 void CCGWorkView::OnDestroy() 
 {
+	// Don't leave the loader threads working on a world nobody draws
+	if (m_load) {
+		m_load->cancel();
+		FinishLoad();
+	}
+	if (m_tessellation) {
+		m_tessellation->cancel();
+		FinishTessellation();
+	}
+
 	CView::OnDestroy();
 
 	// delete the DC
@@ -366,22 +411,174 @@ void CCGWorkView::OnFileLoad()
 {
 	TCHAR szFilters[] = _T ("IRIT Data Files (*.itd)|*.itd|All Files (*.*)|*.*||");
 
-	CFileDialog dlg(TRUE, _T("itd"), _T("*.itd"), OFN_FILEMUSTEXIST | OFN_HIDEREADONLY ,szFilters);
+	CFileDialog dlg(TRUE, _T("itd"), _T("*.itd"), OFN_FILEMUSTEXIST | OFN_HIDEREADONLY | OFN_ALLOWMULTISELECT,
+					szFilters);
+	// Room for the names of many selected files
+	std::vector<TCHAR> file_names_buffer(LOAD_FILE_NAMES_BUFFER_SIZE, 0);
+
+	_tcscpy_s(file_names_buffer.data(), file_names_buffer.size(), _T("*.itd"));
+	dlg.m_ofn.lpstrFile = file_names_buffer.data();
+	dlg.m_ofn.nMaxFile = (DWORD)file_names_buffer.size();
 
 	if (dlg.DoModal () == IDOK) {
-		m_strItdFileName = dlg.GetPathName();		// Full path and filename
+		std::vector<CString> file_names;
+		POSITION position = dlg.GetStartPosition();
+
+		while (position != NULL)
+			file_names.push_back(dlg.GetNextPathName(position));	// Full path and filename
+
+		m_strItdFileName = file_names.front();
+		HWND view_window = GetSafeHwnd();
 		PngWrapper p;
 
-		// Reset the world before loading a new file
-		CGSkelProcessIritDataFiles(m_strItdFileName, 1);
-		// Open the file and read it.
-		// Your code here...
+		// Only one load at a time
+		if (m_load) {
+			m_load->cancel();
+			FinishLoad();
+		}
+
+		/* Every file is loaded into a figure of its own, all at the same time and
+		 * in the background. Objects are shown as soon as they are loaded */
+		m_load.reset(new CGSkelAsyncLoad(file_names.data(), (int)file_names.size(),
+										 CGSkelGetTessellationParams(world.state),
+										 [view_window]() {
+			::PostMessage(view_window, WM_LOAD_PROGRESS, 0, 0);
+		}));
+		STATUS_BAR_TEXT(_T("Loading... (Esc to cancel)"));
 
 		Invalidate();	// force a WM_PAINT for drawing.
 	} 
 
 }
 
+LRESULT CCGWorkView::OnLoadProgress(WPARAM wParam, LPARAM lParam)
+{
+	CString status;
+
+	// A message which was posted before the load was finished
+	if (!m_load)
+		return 0;
+
+	/* publish() lets the loader post again, so it's called before the load
+	 * is checked. A load which is done right after the check posts once more */
+	m_load->publish(world);
+	if (m_load->isDone()) {
+		FinishLoad();
+		return 0;
+	}
+
+	if (!world.isEmpty())
+		world.setOrthoMat();
+
+	status.Format(_T("Loading %d%%... (Esc to cancel)"), m_load->getProgress());
+	STATUS_BAR_TEXT(status);
+
+	Invalidate();
+	return 0;
+}
+
+void CCGWorkView::FinishLoad()
+{
+	// finish() may show message boxes, which handle messages of their own
+	std::unique_ptr<CGSkelAsyncLoad> load = std::move(m_load);
+
+	load->finish(world);
+
+	// The figure being dragged may have been removed with a file which failed
+	bool is_chosen_figure_alive = false;
+	for (int i = 0; i < world.getFiguresNr(); i++)
+		is_chosen_figure_alive |= &world.getFigure(i) == chosen_figure;
+	if (!is_chosen_figure_alive)
+		chosen_figure = NULL;
+
+	if (!world.isEmpty())
+		world.setOrthoMat();
+
+	STATUS_BAR_TEXT(_T(""));
+	Invalidate();
+
+	// The fineness may have changed while the files were loaded
+	Retessellate();
+}
+
+void CCGWorkView::Retessellate(bool is_report_wanted)
+{
+	HWND view_window = GetSafeHwnd();
+
+	// Only the last fineness matters
+	if (m_tessellation) {
+		m_tessellation->cancel();
+		FinishTessellation();
+	}
+	m_is_tessellation_report_wanted = is_report_wanted;
+
+	/* Figures which were tessellated with this fineness before are shown at
+	 * once, the others are tessellated in the background */
+	m_tessellation.reset(new CGSkelAsyncTessellation(world, CGSkelGetTessellationParams(world.state),
+													 [view_window]() {
+		::PostMessage(view_window, WM_TESSELLATION_DONE, 0, 0);
+	}));
+
+	if (m_tessellation->isDone())
+		FinishTessellation();
+	else
+		STATUS_BAR_TEXT(_T("Tessellating..."));
+
+	Invalidate();
+}
+
+LRESULT CCGWorkView::OnTessellationDone(WPARAM wParam, LPARAM lParam)
+{
+	// A message which was posted before the tessellation was finished
+	if (m_tessellation && m_tessellation->isDone())
+		FinishTessellation();
+
+	return 0;
+}
+
+void CCGWorkView::FinishTessellation()
+{
+	std::unique_ptr<CGSkelAsyncTessellation> tessellation = std::move(m_tessellation);
+
+	tessellation->finish();
+
+	// Reported once the new tessellation is drawn, if there is one or it was asked for
+	if (tessellation->hasChanged() || m_is_tessellation_report_wanted)
+		m_is_tessellation_report_pending = true;
+	m_is_tessellation_report_wanted = false;
+	Invalidate();
+}
+
+void CCGWorkView::ReportTessellation(double draw_ms)
+{
+	static const TCHAR *mode_names[TESSELLATION_MODES_NR] = {
+		_T("Uniform"), _T("Chordal deviation"), _T("Normal deviation")
+	};
+	CString report;
+	int polygons_nr = world.getVisiblePolygonsNr();
+
+	if (world.state.tessellation_mode == TESSELLATION_UNIFORM)
+		report.Format(_T("%s, fineness %g: %d polygons, drawn in %.1f ms"),
+					  mode_names[world.state.tessellation_mode], world.state.fineness, polygons_nr, draw_ms);
+	else
+		report.Format(_T("%s, tolerance %g: %d polygons, drawn in %.1f ms"),
+					  mode_names[world.state.tessellation_mode], world.state.tessellation_tolerance,
+					  polygons_nr, draw_ms);
+
+	TRACE(_T("%s\n"), (const TCHAR *)report);
+	STATUS_BAR_TEXT(report);
+}
+
+void CCGWorkView::OnKeyDown(UINT nChar, UINT nRepCnt, UINT nFlags)
+{
+	if (nChar == VK_ESCAPE && m_load) {
+		m_load->cancel();
+		STATUS_BAR_TEXT(_T("Cancelling..."));
+	}
+
+	CView::OnKeyDown(nChar, nRepCnt, nFlags);
+}
+
 // VIEW HANDLERS ///////////////////////////////////////////
 
 // Note: that all the following Message Handlers act in a similar way.
@@ -411,6 +608,19 @@ void CCGWorkView::OnUpdateViewPerspective(CCmdUI* pCmdUI)
 	pCmdUI->SetCheck(m_nView == ID_VIEW_PERSPECTIVE);
 }
 
+void CCGWorkView::OnViewFrameStats()
+{
+	m_is_frame_stats_shown = !m_is_frame_stats_shown;
+	if (!m_is_frame_stats_shown)
+		STATUS_BAR_TEXT(_T(""));
+	Invalidate();
+}
+
+void CCGWorkView::OnUpdateViewFrameStats(CCmdUI* pCmdUI)
+{
+	pCmdUI->SetCheck(m_is_frame_stats_shown);
+}
+
 
 
 
@@ -571,33 +781,18 @@ void resetWorld() {
 	world.state.view_mat = createViewMatrix(DEAULT_VIEW_PARAMETERS);
 
 	world.state.projection_plane_distance = DEFAULT_PROJECTION_PLANE_DISTANCE;
+
+	world.invalidateProjection();
 }
 
 // TODO: tweak sensitivity
-Matrix createRotateMatrix(double x, double y, double z, double angle) {
+Quaternion createRotateQuaternion(double x, double y, double z, double angle) {
 	if (x == 0 && y == 0 && z == 0) {
-		return Matrix::Identity();
+		return Quaternion();
 	}
 	double move = angle * world.state.sensitivity;
-	Matrix transform = Matrix::Identity();
-
-	Vector axis = Vector(x, y, z, 1);
-	axis.Normalize();
-
-	double sin_val = sin(move / (2 * M_PI));
-	double cos_val = cos(move / (2 * M_PI));
 
-	transform.array[0][0] = cos_val + pow(axis[0], 2) * (1 - cos_val);
-	transform.array[0][1] = axis[0] * axis[1] * (1 - cos_val) - axis[2] * sin_val;
-	transform.array[0][2] = axis[0] * axis[2] * (1 - cos_val) + axis[1] * sin_val;
-	transform.array[1][0] = axis[1] * axis[0] * (1 - cos_val) + axis[2] * sin_val;
-	transform.array[1][1] = cos_val + pow(axis[1], 2) * (1 - cos_val);
-	transform.array[1][2] = axis[1] * axis[2] * (1 - cos_val) - axis[0] * sin_val;
-	transform.array[2][0] = axis[2] * axis[0] * (1 - cos_val) - axis[1] * sin_val;
-	transform.array[2][1] = axis[2] * axis[1] * (1 - cos_val) + axis[0] * sin_val;
-	transform.array[2][2] = cos_val + pow(axis[2], 2) * (1 - cos_val);
-
-	return transform;
+	return Quaternion::FromAxisAngle(x, y, z, move / (2 * M_PI));
 }
 
 Matrix createScaleMatrix(double x, double y, double z) {
@@ -625,6 +820,7 @@ void CCGWorkView::OnLButtonDown(UINT nFlags, CPoint point)
 	chosen_figure = world.getFigureInPoint(point);
 	is_mouse_down = true;
 	mouse_location = point;
+	last_mouse_x = point.x;
 
 	if (chosen_figure)
 		chosen_figure->backup_transformation(world.state);
@@ -656,7 +852,13 @@ void CCGWorkView::OnMouseMove(UINT nFlags, CPoint point)
 			shift[1] = (world.state.is_axis_active[Y_AXIS]) ? 1.0 : 0.0;
 			shift[2] = (world.state.is_axis_active[Z_AXIS]) ? 1.0 : 0.0;
 
-			transform = createRotateMatrix(shift[0], shift[1], shift[2], distance);
+			/* Rotations are accumulated one mouse event at a time, the
+			 * matrix is only built when the figure is drawn */
+			distance = (point.x - last_mouse_x) * world.state.sensitivity / 10.0;
+			last_mouse_x = point.x;
+
+			chosen_figure->rotate(createRotateQuaternion(shift[0], shift[1], shift[2], distance),
+								  world.state);
 			break;
 		case ID_ACTION_SCALE :
 			shift[0] = 1.0 + ((world.state.is_axis_active[X_AXIS]) ? (distance / 10.0) : 0.0);
@@ -674,7 +876,10 @@ void CCGWorkView::OnMouseMove(UINT nFlags, CPoint point)
 		default:
 			break;
 	}		
-		*mat_to_transform = transform * chosen_figure->backup_transformation_matrix;
+		if (m_nAction != ID_ACTION_ROTATE) {
+			*mat_to_transform = transform * chosen_figure->backup_transformation_matrix;
+			chosen_figure->invalidateTransform();
+		}
 
 		Invalidate();
 	}
@@ -783,12 +988,20 @@ void CCGWorkView::OnNormalColor()
 }
 
 void CCGWorkView::OnSensDistance() {
-	CEx2Dialog diag(world.state.sensitivity, world.state.projection_plane_distance, world.state.fineness);
+	CEx2Dialog diag(world.state.sensitivity, world.state.projection_plane_distance, world.state.fineness,
+					world.state.tessellation_mode, world.state.tessellation_tolerance);
 
 	if (diag.DoModal() == IDOK) {
 		world.state.sensitivity = diag.m_sensitivity;
 		world.state.projection_plane_distance = diag.m_distance;
-		world.state.fineness = diag.m_fineness;
+		if (diag.m_fineness != world.state.fineness ||
+			diag.m_tessellation_mode != world.state.tessellation_mode ||
+			diag.m_tolerance != world.state.tessellation_tolerance) {
+			world.state.fineness = diag.m_fineness;
+			world.state.tessellation_mode = (TessellationMode)diag.m_tessellation_mode;
+			world.state.tessellation_tolerance = diag.m_tolerance;
+			Retessellate(true);
+		}
 		Invalidate();
 	}
 	return;
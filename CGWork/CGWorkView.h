@@ -15,6 +15,15 @@
 
 
 #include "Light.h"
+#include <memory>
+
+// Posted by the loader threads when the load has something to show
+#define WM_LOAD_PROGRESS (WM_APP + 1)
+// Posted by the tessellation thread when the new tessellations are ready
+#define WM_TESSELLATION_DONE (WM_APP + 2)
+
+class CGSkelAsyncLoad;
+class CGSkelAsyncTessellation;
 
 class CCGWorkView : public CView
 {
@@ -35,6 +44,11 @@ private:
 	int m_nView;				// Orthographic, perspective
 
 	CString m_strItdFileName;		// file name of IRIT data
+	std::unique_ptr<CGSkelAsyncLoad> m_load;	// The files being loaded, if any
+	std::unique_ptr<CGSkelAsyncTessellation> m_tessellation;	// Freeforms with new parameters
+	bool m_is_tessellation_report_pending;	// Until the next draw
+	bool m_is_tessellation_report_wanted;	// Even if no figure changes
+	bool m_is_frame_stats_shown;			// In the status bar, after every draw
 
 	int m_nLightShading;			// shading: Flat, Gouraud.
 
@@ -93,6 +107,8 @@ protected:
 	afx_msg void OnUpdateViewOrthographic(CCmdUI* pCmdUI);
 	afx_msg void OnViewPerspective();
 	afx_msg void OnUpdateViewPerspective(CCmdUI* pCmdUI);
+	afx_msg void OnViewFrameStats();
+	afx_msg void OnUpdateViewFrameStats(CCmdUI* pCmdUI);
 	afx_msg void OnActionRotate();
 	afx_msg void OnUpdateActionRotate(CCmdUI* pCmdUI);
 	afx_msg void OnActionScale();
@@ -133,6 +149,26 @@ public:
 	afx_msg void OnNormalColor();
 	afx_msg void OnDifferentNormals();
 	afx_msg void OnUpdateDifferentNormals(CCmdUI* pCmdUI);
+	afx_msg LRESULT OnLoadProgress(WPARAM wParam, LPARAM lParam);
+	afx_msg LRESULT OnTessellationDone(WPARAM wParam, LPARAM lParam);
+	afx_msg void OnKeyDown(UINT nChar, UINT nRepCnt, UINT nFlags);
+
+private:
+	// Waits for the current load to end and adds what's left of it to the world
+	void FinishLoad();
+
+	/* Shows the freeforms with the current tessellation parameters,
+	 * tessellating them in the background if they weren't tessellated with
+	 * them before. The result is reported if a figure changed, or always if
+	 * @is_report_wanted */
+	void Retessellate(bool is_report_wanted = false);
+
+	// Waits for the current tessellation to end and shows it
+	void FinishTessellation();
+
+	/* Shows the number of polygons drawn and how long drawing them took
+	 * in the status bar */
+	void ReportTessellation(double draw_ms);
 };
 
 #ifndef _DEBUG  // debug version in CGWorkView.cpp
@@ -1,45 +1,28 @@
 #include "IritObjects.h"
+#include "LineBands.h"
+#include <algorithm>
+#include <math.h>
+#include <thread>
 
 Matrix createTranslationMatrix(double &x, double &y, double z = 0);
 Matrix createTranslationMatrix(Vector &v);
-void lineDraw(int *bits, int width, int height, RGBQUAD color, Vector first, Vector second);
 
 #define BOX_NUM_OF_VERTICES 8
-
-IritPolygon::IritPolygon() : m_point_nr(0), m_points(nullptr), normal_start(Vector(0, 0, 0, 1)),
-			normal_end(Vector(0, 0, 0, 1)), is_irit_normal(false), m_next_polygon(nullptr) {
+#define BOX_NUM_OF_EDGES 12
+// Pixels around the bitmap which line ends are clipped to before they're rasterized
+#define LINE_GUARD_BAND (1 << 20)
+// Points nearer to the eye than this part of the projection plane's distance are clipped
+#define CLIP_NEAR_W 0.01
+
+IritPolygon::IritPolygon(IritObject *object) : m_object(object), m_first_index(0), m_point_nr(0),
+			normal_start(Vector(0, 0, 0, 1)), normal_end(Vector(0, 0, 0, 1)), is_irit_normal(false) {
 }
 
 IritPolygon::~IritPolygon() {
-	struct IritPoint *next_point;
-	while (m_points) {
-		next_point = m_points->next_point;
-		delete m_points;
-		m_points = next_point;
-	}
 }
 
 bool IritPolygon::addPoint(struct IritPoint &point) {
-
-	IritPoint *new_point = new IritPoint(point);
-	if (!new_point)
-		return false;
-	new_point->next_point = nullptr;
-
-	m_point_nr++;
-
-	if (!m_points) {
-		// first point
-		m_points = new_point;
-		return true;
-	}
-
-	IritPoint *last_point = m_points;
-	while (last_point->next_point)
-		last_point = last_point->next_point;
-	last_point->next_point = new_point;
-
-	return true;
+	return m_object->addPoint(*this, point);
 }
 
 bool IritPolygon::addPoint(double &x, double &y, double &z, double &normal_x, double &normal_y,
@@ -72,81 +55,61 @@ bool IritPolygon::addPoint(IPVertexStruct *vertex, bool is_irit_normal, Vector n
 	return addPoint(new_point);
 }
 
-IritPolygon *IritPolygon::getNextPolygon() {
-	return m_next_polygon;
+int IritPolygon::getPointsNr() const {
+	return m_point_nr;
 }
 
-void IritPolygon::setNextPolygon(IritPolygon *polygon) {
-	m_next_polygon = polygon;
+int IritPolygon::getFirstIndex() const {
+	return m_first_index;
 }
 
+int IritPolygon::getVertexIndex(int i) const {
+	return m_object->getIndices()[m_first_index + i];
+}
 
-void IritPolygon::draw(int *bitmap, int width, int height, RGBQUAD color, struct State state,
-					   Matrix &vertex_transform) {
-	struct IritPoint *current_point = m_points;
-	Vector current_vertex = current_point->vertex;
-	Vector next_vertex;
-	Vector polygon_normal[2];
-	RGBQUAD current_color = (state.is_default_color) ? color : state.wire_color;
-	RGBQUAD normal_color;
 
-	// For vertex normal drawing
-	Vector normal;
+void IritPolygon::draw(int *bitmap, int width, int height, RGBQUAD color, const Vector *screen_vertices,
+					   FrameStats &stats, LineBands *bands) {
+	const int *indices = m_object->getIndices() + m_first_index;
+	// A polygon of two points is a single line
+	int lines_nr = (m_point_nr > 2) ? m_point_nr : m_point_nr - 1;
 
 	/* Draw shape's lines */
-	while (current_point->next_point != nullptr) {
-		current_vertex = current_point->vertex;
-		next_vertex = current_point->next_point->vertex;
-		current_vertex = vertex_transform * current_vertex;
-		next_vertex = vertex_transform * next_vertex;
-
-		if (state.is_perspective_view) {
-			current_vertex.Homogenize();
-			next_vertex.Homogenize();
-
-			if (current_vertex[X_AXIS] > 4.5 || current_vertex[X_AXIS] < -4.5 || current_vertex[Y_AXIS] > 4.5 || current_vertex[Y_AXIS] < -4.5)
-				goto pass_this_point;
-		}
+	for (int i = 0; i < lines_nr; i++) {
+		clipLineDraw(bitmap, width, height, color, screen_vertices[indices[i]],
+					 screen_vertices[indices[(i + 1) % m_point_nr]], bands);
+	}
 
-		current_vertex = state.screen_mat * current_vertex;
-		next_vertex = state.screen_mat * next_vertex;
+	stats.lines_drawn += max(lines_nr, 0);
+}
 
-		lineDraw(bitmap, width, height, current_color, current_vertex, next_vertex);
+void IritPolygon::drawNormals(int *bitmap, int width, int height, const struct State &state,
+							  const Vector *screen_normals, const Vector *screen_polygon_normal,
+							  FrameStats &stats, LineBands *bands) {
+	const unsigned char *is_irit_normals = m_object->getIsIritNormal();
+	const int *indices = m_object->getIndices() + m_first_index;
+	RGBQUAD normal_color;
 
-		if (state.show_vertex_normal) {
-			normal = current_point->normal * 0.3;
-			normal += current_point->vertex;
-			normal = vertex_transform * normal;
-			if (state.is_perspective_view)
-				normal.Homogenize();
-			normal = state.screen_mat * normal;
+	if (state.show_vertex_normal) {
+		for (int i = 0; i < m_point_nr; i++) {
+			int current_index = indices[i];
 
 			normal_color = state.normal_color;
 			if (state.tell_normals_apart) {
-				if (current_point->is_irit_normal)
+				if (is_irit_normals[current_index])
 					normal_color = IRIT_NORMAL_COLOR;
 				else
 					normal_color = CALC_NORMAL_COLOR;
 			}
 
-			lineDraw(bitmap, width, height, normal_color, current_vertex, normal);
+			clipLineDraw(bitmap, width, height, normal_color, screen_normals[2 * current_index],
+						 screen_normals[2 * current_index + 1], bands);
 		}
-pass_this_point:
-		current_point = current_point->next_point;
+
+		stats.lines_drawn += m_point_nr;
 	}
 
 	if (state.show_polygon_normal) {
-		polygon_normal[0] = vertex_transform * normal_start;
-		polygon_normal[1] = vertex_transform * normal_end;
-
-		if (state.is_perspective_view) {
-			polygon_normal[0].Homogenize();
-			polygon_normal[1].Homogenize();
-		}
-
-		polygon_normal[0] = state.screen_mat * polygon_normal[0];
-		polygon_normal[1] = state.screen_mat * polygon_normal[1];
-		
 		normal_color = state.normal_color;
 		if (state.tell_normals_apart) {
 			if (this->is_irit_normal)
@@ -154,60 +117,292 @@ pass_this_point:
 			else
 				normal_color = CALC_NORMAL_COLOR;
 		}
-		lineDraw(bitmap, width, height, normal_color, polygon_normal[0], polygon_normal[1]);
+		clipLineDraw(bitmap, width, height, normal_color, screen_polygon_normal[0], screen_polygon_normal[1],
+					 bands);
+		stats.lines_drawn++;
 	}
 }
 
-IritPolygon &IritPolygon::operator++() {
-	return *m_next_polygon;
-}
-
-IritObject::IritObject() : m_polygons_nr(0), m_polygons(nullptr), m_iterator(nullptr) {
+IritObject::IritObject(Arena *arena) : m_polygons(arena), m_positions(arena), m_normals(arena),
+									 m_is_irit_normal(arena), m_indices(arena),
+									 m_attached_positions(nullptr), m_attached_normals(nullptr),
+									 m_attached_is_irit_normal(nullptr), m_attached_indices(nullptr),
+									 m_attached_vertices_nr(0), m_attached_indices_nr(0),
+									 m_wire_vertices(arena), m_edges(arena),
+									 m_attached_wire_vertices(nullptr), m_attached_edges(nullptr),
+									 m_attached_wire_vertices_nr(0), m_attached_edges_nr(0),
+									 m_screen_vertices_version(0), m_screen_normals_version(0),
+									 m_screen_polygon_normals_version(0) {
 	object_color = WIRE_DEFAULT_COLOR;
+	is_hidden = false;
 }
 
 IritObject::~IritObject() {
-	IritPolygon *next_polygon;
-	while (m_polygons) {
-		next_polygon = m_polygons->getNextPolygon();
-		delete m_polygons;
-		m_polygons = next_polygon;
-	}
 }
 
-void IritObject::addPolygonP(IritPolygon *polygon) {
+bool IritObject::addPoint(IritPolygon &polygon, const struct IritPoint &point) {
+	int vertex_index = (int)m_positions.size();
 
-	if (!m_polygons) {
-		m_polygons = polygon;
-	} else {
-		if (!m_iterator)
-			m_iterator = m_polygons;
+	if (polygon.m_object != this || m_attached_positions)
+		return false;
+
+	if (polygon.m_point_nr == 0)
+		polygon.m_first_index = (int)m_indices.size();
+	else if (polygon.m_first_index + polygon.m_point_nr != (int)m_indices.size())
+		return false;
+
+	m_positions.push_back(point.vertex);
+	m_normals.push_back(Vec4f(point.normal));
+	m_is_irit_normal.push_back(point.is_irit_normal);
+
+	m_indices.push_back(vertex_index);
+	polygon.m_point_nr++;
+
+	return true;
+}
+
+void IritObject::reserveVertices(int vertices_nr) {
+	size_t size = m_positions.size() + vertices_nr;
+
+	m_positions.reserve(size);
+	m_normals.reserve(size);
+	m_is_irit_normal.reserve(size);
+	m_indices.reserve(m_indices.size() + vertices_nr);
+}
+
+bool IritObject::attachBuffers(const Vector *positions, const Vec4f *normals,
+							   const unsigned char *is_irit_normal, int vertices_nr,
+							   const int *indices, int indices_nr) {
+	if (!m_positions.empty() || m_attached_positions)
+		return false;
+
+	m_attached_positions = positions;
+	m_attached_normals = normals;
+	m_attached_is_irit_normal = is_irit_normal;
+	m_attached_vertices_nr = vertices_nr;
+	m_attached_indices = indices;
+	m_attached_indices_nr = indices_nr;
+
+	return true;
+}
+
+int IritObject::getVerticesNr() const {
+	return (m_attached_positions) ? m_attached_vertices_nr : (int)m_positions.size();
+}
+
+int IritObject::getIndicesNr() const {
+	return (m_attached_positions) ? m_attached_indices_nr : (int)m_indices.size();
+}
+
+const Vector *IritObject::getPositions() const {
+	return (m_attached_positions) ? m_attached_positions : m_positions.data();
+}
 
-		while (m_iterator->getNextPolygon())
-			m_iterator = m_iterator->getNextPolygon();
-		m_iterator->setNextPolygon(polygon);
+const Vec4f *IritObject::getNormals() const {
+	return (m_attached_positions) ? m_attached_normals : m_normals.data();
+}
+
+const unsigned char *IritObject::getIsIritNormal() const {
+	return (m_attached_positions) ? m_attached_is_irit_normal : m_is_irit_normal.data();
+}
+
+const int *IritObject::getIndices() const {
+	return (m_attached_positions) ? m_attached_indices : m_indices.data();
+}
+
+bool IritObject::buildEdges(const int *point_vertices, int vertices_nr) {
+	const int *indices = getIndices();
+	std::vector<unsigned long long> keys;
+
+	if (hasEdges())
+		return false;
+
+	// Every welded vertex is drawn at the first point welded into it
+	m_wire_vertices.assign(vertices_nr, -1);
+	for (int i = 0; i < getIndicesNr(); i++) {
+		if (m_wire_vertices[point_vertices[i]] < 0)
+			m_wire_vertices[point_vertices[i]] = indices[i];
 	}
-	m_polygons_nr++;
+
+	/* An edge is the key (smaller vertex << 32 | larger vertex), so the
+	 * edge of both polygons around it has the same key */
+	keys.reserve(getIndicesNr());
+	m_polygons.ForEach([&](IritPolygon &polygon) {
+		int first = polygon.m_first_index, points_nr = polygon.m_point_nr;
+
+		for (int i = 0; i < points_nr; i++) {
+			unsigned int a = point_vertices[first + i], b = point_vertices[first + (i + 1) % points_nr];
+
+			if (a != b)
+				keys.push_back(((unsigned long long)min(a, b) << 32) | max(a, b));
+		}
+	});
+
+	std::sort(keys.begin(), keys.end());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+	m_edges.reserve(2 * keys.size());
+	for (unsigned long long key : keys) {
+		m_edges.push_back((int)(key >> 32));
+		m_edges.push_back((int)(key & 0xffffffff));
+	}
+
+	return true;
+}
+
+bool IritObject::attachEdges(const int *wire_vertices, int wire_vertices_nr, const int *edges,
+							 int edges_nr) {
+	if (hasEdges())
+		return false;
+
+	m_attached_wire_vertices = wire_vertices;
+	m_attached_wire_vertices_nr = wire_vertices_nr;
+	m_attached_edges = edges;
+	m_attached_edges_nr = edges_nr;
+
+	return true;
+}
+
+bool IritObject::hasEdges() const {
+	return m_attached_edges || !m_wire_vertices.empty();
+}
+
+int IritObject::getWireVerticesNr() const {
+	return (m_attached_edges) ? m_attached_wire_vertices_nr : (int)m_wire_vertices.size();
+}
+
+int IritObject::getEdgesNr() const {
+	return (m_attached_edges) ? m_attached_edges_nr : (int)m_edges.size() / 2;
+}
+
+const int *IritObject::getWireVertices() const {
+	return (m_attached_edges) ? m_attached_wire_vertices : m_wire_vertices.data();
+}
+
+const int *IritObject::getEdges() const {
+	return (m_attached_edges) ? m_attached_edges : m_edges.data();
 }
 
 IritPolygon *IritObject::createPolygon() {
-	IritPolygon *new_polygon = new IritPolygon();
-	if (!new_polygon)
+	return &m_polygons.EmplaceBack(this);
+}
+
+IritPolygon *IritObject::createPolygon(int first_index, int points_nr) {
+	if (first_index < 0 || points_nr < 0 || first_index > getIndicesNr() - points_nr)
 		return nullptr;
-	addPolygonP(new_polygon);
-	return new_polygon;
+
+	IritPolygon *polygon = &m_polygons.EmplaceBack(this);
+	polygon->m_first_index = first_index;
+	polygon->m_point_nr = points_nr;
+
+	return polygon;
 }
 
-void IritObject::draw(int *bitmap, int width, int height, struct State state,
-					  Matrix &vertex_transform) {
-	m_iterator = m_polygons;
-	while (m_iterator) {
-		m_iterator->draw(bitmap, width, height, object_color, state, vertex_transform);
-		m_iterator = m_iterator->getNextPolygon();
+int IritObject::getPolygonsNr() const {
+	return m_polygons.Size();
+}
+
+IritPolygon &IritObject::getPolygon(int i) {
+	return m_polygons[i];
+}
+
+void IritObject::updateScreenBuffers(const struct State &state, const Matrix &screen_transform,
+									 unsigned int transform_version, FrameStats &stats) {
+	const Vector *positions = getPositions();
+	int vertices_nr = getVerticesNr();
+
+	if (m_screen_vertices_version != transform_version) {
+		if (hasEdges()) {
+			const int *wire_vertices = getWireVertices();
+			int wire_vertices_nr = getWireVerticesNr();
+
+			// Gathered, then transformed in place
+			m_screen_vertices.resize(wire_vertices_nr);
+			for (int i = 0; i < wire_vertices_nr; i++)
+				m_screen_vertices[i] = positions[wire_vertices[i]];
+			screen_transform.TransformVectors(m_screen_vertices.data(), m_screen_vertices.data(),
+											  wire_vertices_nr);
+		} else {
+			m_screen_vertices.resize(vertices_nr);
+			screen_transform.TransformVectors(positions, m_screen_vertices.data(), vertices_nr);
+		}
+
+		stats.vertices_transformed += m_screen_vertices.size();
+		m_screen_vertices_version = transform_version;
+	}
+
+	if (state.show_vertex_normal && m_screen_normals_version != transform_version) {
+		const Vec4f *normals = getNormals();
+
+		m_screen_normals.resize(2 * vertices_nr);
+		for (int i = 0; i < vertices_nr; i++) {
+			m_screen_normals[2 * i] = positions[i];
+			m_screen_normals[2 * i + 1] = Vector(normals[i]) * 0.3;
+			m_screen_normals[2 * i + 1] += positions[i];
+		}
+		screen_transform.TransformVectors(m_screen_normals.data(), m_screen_normals.data(), 2 * vertices_nr);
+
+		stats.vertices_transformed += 2 * vertices_nr;
+		m_screen_normals_version = transform_version;
+	}
+
+	if (state.show_polygon_normal && m_screen_polygon_normals_version != transform_version) {
+		int i = 0;
+
+		m_screen_polygon_normals.resize(2 * getPolygonsNr());
+		m_polygons.ForEach([&](IritPolygon &polygon) {
+			m_screen_polygon_normals[i++] = polygon.normal_start;
+			m_screen_polygon_normals[i++] = polygon.normal_end;
+		});
+		screen_transform.TransformVectors(m_screen_polygon_normals.data(), m_screen_polygon_normals.data(),
+										  i);
+
+		stats.vertices_transformed += i;
+		m_screen_polygon_normals_version = transform_version;
+	}
+}
+
+void IritObject::draw(int *bitmap, int width, int height, const struct State &state,
+					  const Matrix &screen_transform, unsigned int transform_version, FrameStats &stats,
+					  LineBands *bands) {
+	RGBQUAD color = (state.is_default_color) ? object_color : state.wire_color;
+	const Vector *screen_vertices;
+
+	updateScreenBuffers(state, screen_transform, transform_version, stats);
+	screen_vertices = m_screen_vertices.data();
+
+	if (hasEdges()) {
+		const int *edges = getEdges();
+		int edges_nr = getEdgesNr();
+
+		for (int i = 0; i < edges_nr; i++) {
+			clipLineDraw(bitmap, width, height, color, screen_vertices[edges[2 * i]],
+						 screen_vertices[edges[2 * i + 1]], bands);
+		}
+
+		stats.lines_drawn += edges_nr;
+	} else {
+		m_polygons.ForEach([&](IritPolygon &polygon) {
+			polygon.draw(bitmap, width, height, color, screen_vertices, stats, bands);
+		});
+	}
+
+	if (state.show_vertex_normal || state.show_polygon_normal) {
+		// The buffers of normals which aren't shown may be empty
+		Vector *screen_polygon_normal = (state.show_polygon_normal) ? m_screen_polygon_normals.data() : nullptr;
+
+		m_polygons.ForEach([&](IritPolygon &polygon) {
+			polygon.drawNormals(bitmap, width, height, state, m_screen_normals.data(), screen_polygon_normal,
+								stats, bands);
+			if (screen_polygon_normal)
+				screen_polygon_normal += 2;
+		});
 	}
 }
 
-IritFigure::IritFigure() : m_objects_nr(0), m_objects_arr(nullptr) {
+IritFigure::IritFigure() : m_objects(&m_arena), m_published_objects_nr(0), m_is_loading(false),
+						   m_is_transform_dirty(true), m_projection_version(0), m_transform_version(0),
+						   m_rotated_mat(nullptr) {
 
 	max_bound_coord = Vector();
 	max_bound_coord[3] = 1;
@@ -219,52 +414,136 @@ IritFigure::IritFigure() : m_objects_nr(0), m_objects_arr(nullptr) {
 }
 
 IritFigure::~IritFigure() {
-	delete[] m_objects_arr;
 }
 
-IritObject *IritFigure::createObject() {
-	IritObject *new_object = new IritObject();
-	if (!new_object)
-		return nullptr;
+void IritFigure::attachMappedFile(std::unique_ptr<MappedFile> mapped_file) {
+	m_mapped_file = std::move(mapped_file);
+}
 
-	if (!addObjectP(new_object))
-		return nullptr;
+void IritFigure::attachSource(std::unique_ptr<IritFigureSource> source) {
+	m_source = std::move(source);
+}
 
-	return new_object;
+IritFigureSource *IritFigure::getSource() {
+	return m_source.get();
 }
 
-bool IritFigure::addObjectP(IritObject *p_object) {
+IritObject *IritFigure::createObject(bool is_hidden) {
+	std::lock_guard<std::mutex> lock(m_objects_mutex);
+	IritObject *object = &m_objects.EmplaceBack(&m_arena);
 
-	IritObject **new_objects_array = new IritObject*[m_objects_nr + 1];
-	if (!new_objects_array)
-		return false;
+	object->is_hidden = is_hidden;
 
-	for (int i = 0; i < m_objects_nr; i++)
-		new_objects_array[i] = m_objects_arr[i];
-	new_objects_array[m_objects_nr] = p_object;
+	if (!m_is_loading)
+		m_published_objects_nr = m_objects.Size();
 
-	delete m_objects_arr;
-	m_objects_arr = new_objects_array;
-	m_objects_nr++;
+	return object;
+}
 
-	return true;
+int IritFigure::getObjectsNr() const {
+	return m_objects.Size();
 }
 
-void IritFigure::draw(int *bitmap, int width, int height, Matrix transform, State &state) {
-	Matrix shrink = Matrix::Identity() * (1.0 / 10.0);
+IritObject &IritFigure::getObject(int i) {
+	return m_objects[i];
+}
+
+void IritFigure::setLoading(bool is_loading) {
+	std::lock_guard<std::mutex> lock(m_objects_mutex);
 
-	Matrix vertex_transform = transform * world_mat * object_mat;
+	m_is_loading = is_loading;
+	if (!m_is_loading)
+		m_published_objects_nr = m_objects.Size();
+}
 
-	// Draw all objects
-	for (int i = 0; i < m_objects_nr; i++)
-		m_objects_arr[i]->draw(bitmap, width, height, state, vertex_transform);
+void IritFigure::publishObjects(const Vector &min_bound, const Vector &max_bound) {
+	std::lock_guard<std::mutex> lock(m_objects_mutex);
+
+	m_published_objects_nr = m_objects.Size();
+	min_bound_coord = min_bound;
+	max_bound_coord = max_bound;
+}
+
+int IritFigure::getPublishedObjectsNr() {
+	std::lock_guard<std::mutex> lock(m_objects_mutex);
+
+	return m_published_objects_nr;
+}
+
+void IritFigure::getBoundingFrame(Vector &min_bound, Vector &max_bound) {
+	std::lock_guard<std::mutex> lock(m_objects_mutex);
+
+	min_bound = min_bound_coord;
+	max_bound = max_bound_coord;
+}
+
+void IritFigure::setObjectsHidden(int first_object, int objects_nr, bool is_hidden) {
+	std::lock_guard<std::mutex> lock(m_objects_mutex);
+
+	for (int i = first_object; i < first_object + objects_nr; i++)
+		m_objects[i].is_hidden = is_hidden;
+}
+
+void IritFigure::clearObjects() {
+	std::lock_guard<std::mutex> lock(m_objects_mutex);
+
+	m_objects.Clear();
+	m_published_objects_nr = 0;
+	// Nothing else is allocated from the arena
+	m_arena.Reset();
+}
+
+void IritFigure::removeObjects(int objects_nr) {
+	std::lock_guard<std::mutex> lock(m_objects_mutex);
+
+	while (m_objects.Size() > objects_nr)
+		m_objects.PopBack();
+	m_published_objects_nr = min(m_published_objects_nr, objects_nr);
+}
+
+const Arena &IritFigure::getArena() const {
+	return m_arena;
+}
+
+void IritFigure::invalidateTransform() {
+	m_is_transform_dirty = true;
+}
+
+void IritFigure::updateTransform(const Matrix &projection_mat, unsigned int projection_version,
+								 State &state) {
+	if (!m_is_transform_dirty && m_projection_version == projection_version)
+		return;
+
+	applyDragRotation();
+
+	// The screen matrix is affine, so it can be applied before the
+	// perspective divide as well as after it
+	m_screen_transform = state.screen_mat * projection_mat * world_mat * object_mat;
+
+	m_projection_version = projection_version;
+	m_transform_version++;
+	m_is_transform_dirty = false;
+}
+
+void IritFigure::draw(int *bitmap, int width, int height, const Matrix &transform,
+					  unsigned int projection_version, State &state, FrameStats &stats, LineBands *bands) {
+	std::lock_guard<std::mutex> lock(m_objects_mutex);
+
+	updateTransform(transform, projection_version, state);
+
+	// Draw all the published objects
+	m_objects.ForEachFirst(m_published_objects_nr, [&](IritObject &object) {
+		if (!object.is_hidden)
+			object.draw(bitmap, width, height, state, m_screen_transform, m_transform_version, stats, bands);
+	});
 
 	// Draw a frame around all objects
-	if (state.object_frame)
-		drawFrame(bitmap, width, height, state, vertex_transform);
+	if (state.object_frame && m_published_objects_nr > 0)
+		drawFrame(bitmap, width, height, state, stats, bands);
 }
 
-void IritFigure::drawFrame(int *bitmap, int width, int height, struct State state, Matrix &transform) {
+void IritFigure::drawFrame(int *bitmap, int width, int height, struct State state, FrameStats &stats,
+						   LineBands *bands) {
 	double frame_max_x = max_bound_coord[0],
 		frame_max_y = max_bound_coord[1],
 		frame_max_z = max_bound_coord[2],
@@ -283,47 +562,74 @@ void IritFigure::drawFrame(int *bitmap, int width, int height, struct State stat
 		Vector(frame_min_x, frame_min_y, frame_min_z, 1)  // Back bottom left
 	};
 
-	// Update box to current transformation
-	for (int i = 0; i < BOX_NUM_OF_VERTICES; i++) {
-		coords[i] = transform * coords[i];
-
-		if (state.is_perspective_view)
-			coords[i].Homogenize();
-
-		coords[i] = state.screen_mat * coords[i];
-	}
+	// Update box to current transformation. The divide is left to the clipping
+	m_screen_transform.TransformVectors(coords, coords, BOX_NUM_OF_VERTICES);
+	stats.vertices_transformed += BOX_NUM_OF_VERTICES;
+	stats.lines_drawn += BOX_NUM_OF_EDGES;
 
 	// Draw "front side"
 
-	lineDraw(bitmap, width, height, state.frame_color, coords[0], coords[1]);
-	lineDraw(bitmap, width, height, state.frame_color, coords[1], coords[3]);
-	lineDraw(bitmap, width, height, state.frame_color, coords[3], coords[2]);
-	lineDraw(bitmap, width, height, state.frame_color, coords[2], coords[0]);
+	clipLineDraw(bitmap, width, height, state.frame_color, coords[0], coords[1], bands);
+	clipLineDraw(bitmap, width, height, state.frame_color, coords[1], coords[3], bands);
+	clipLineDraw(bitmap, width, height, state.frame_color, coords[3], coords[2], bands);
+	clipLineDraw(bitmap, width, height, state.frame_color, coords[2], coords[0], bands);
 
 	// Draw "back side"
 
-	lineDraw(bitmap, width, height, state.frame_color, coords[4], coords[5]);
-	lineDraw(bitmap, width, height, state.frame_color, coords[5], coords[7]);
-	lineDraw(bitmap, width, height, state.frame_color, coords[7], coords[6]);
-	lineDraw(bitmap, width, height, state.frame_color, coords[6], coords[4]);
+	clipLineDraw(bitmap, width, height, state.frame_color, coords[4], coords[5], bands);
+	clipLineDraw(bitmap, width, height, state.frame_color, coords[5], coords[7], bands);
+	clipLineDraw(bitmap, width, height, state.frame_color, coords[7], coords[6], bands);
+	clipLineDraw(bitmap, width, height, state.frame_color, coords[6], coords[4], bands);
 
 	// Draw "sides"
 
 	// Top right
-	lineDraw(bitmap, width, height, state.frame_color, coords[0], coords[4]);
+	clipLineDraw(bitmap, width, height, state.frame_color, coords[0], coords[4], bands);
 	// Bottom right
-	lineDraw(bitmap, width, height, state.frame_color, coords[1], coords[5]);
+	clipLineDraw(bitmap, width, height, state.frame_color, coords[1], coords[5], bands);
 	// Top left
-	lineDraw(bitmap, width, height, state.frame_color, coords[2], coords[6]);
+	clipLineDraw(bitmap, width, height, state.frame_color, coords[2], coords[6], bands);
 	// Bottom left
-	lineDraw(bitmap, width, height, state.frame_color, coords[3], coords[7]);
+	clipLineDraw(bitmap, width, height, state.frame_color, coords[3], coords[7], bands);
+}
+
+int IritFigure::getVisiblePolygonsNr() {
+	std::lock_guard<std::mutex> lock(m_objects_mutex);
+	int polygons_nr = 0;
+
+	m_objects.ForEachFirst(m_published_objects_nr, [&](IritObject &object) {
+		if (!object.is_hidden)
+			polygons_nr += object.getPolygonsNr();
+	});
+
+	return polygons_nr;
 }
 
 bool IritFigure::isEmpty() {
-	return m_objects_nr == 0;
+	return m_objects.IsEmpty();
+}
+
+void IritFigure::applyDragRotation() {
+	if (!m_rotated_mat)
+		return;
+
+	*m_rotated_mat = m_drag_rotation.ToMatrix() * backup_transformation_matrix;
+	m_rotated_mat = nullptr;
+}
+
+void IritFigure::rotate(const Quaternion &delta, State &state) {
+	m_drag_rotation = delta * m_drag_rotation;
+	m_drag_rotation.Renormalize();
+
+	m_rotated_mat = (state.object_transform) ? &object_mat : &world_mat;
+	m_is_transform_dirty = true;
 }
 
 void IritFigure::backup_transformation(State &state) {
+	// Don't lose a rotation that wasn't drawn yet
+	applyDragRotation();
+	m_drag_rotation = Quaternion();
+
 	if (state.object_transform) {
 		backup_transformation_matrix = object_mat;
 	} else {
@@ -331,7 +637,8 @@ void IritFigure::backup_transformation(State &state) {
 	}
 }
 
-IritWorld::IritWorld() : m_figures_nr(0), m_figures_arr(nullptr) {
+IritWorld::IritWorld() : m_is_projection_dirty(true), m_projection_version(0), m_frame_stats(),
+						 m_is_line_bands_checked(false) {
 	state.show_vertex_normal = false;
 	state.show_polygon_normal = false;
 	state.object_frame = false;
@@ -359,6 +666,8 @@ IritWorld::IritWorld() : m_figures_nr(0), m_figures_arr(nullptr) {
 	state.projection_plane_distance = DEFAULT_PROJECTION_PLANE_DISTANCE;
 	state.sensitivity = 1.0;
 	state.fineness = DEFAULT_FINENESS;
+	state.tessellation_mode = TESSELLATION_UNIFORM;
+	state.tessellation_tolerance = DEFAULT_TESSELLATION_TOLERANCE;
 
 	state.bg_color = BG_DEFAULT_COLOR;
 	state.wire_color = WIRE_DEFAULT_COLOR;
@@ -366,7 +675,8 @@ IritWorld::IritWorld() : m_figures_nr(0), m_figures_arr(nullptr) {
 	state.normal_color = NORMAL_DEFAULT_COLOR;
 }
 
-IritWorld::IritWorld(Vector axes[NUM_OF_AXES], Vector &axes_origin) : m_figures_nr(0), m_figures_arr(nullptr) {
+IritWorld::IritWorld(Vector axes[NUM_OF_AXES], Vector &axes_origin) : m_is_projection_dirty(true),
+					 m_projection_version(0), m_frame_stats(), m_is_line_bands_checked(false) {
 	state.show_vertex_normal = false;
 	state.show_polygon_normal = false;
 	state.object_frame = false;
@@ -394,6 +704,8 @@ IritWorld::IritWorld(Vector axes[NUM_OF_AXES], Vector &axes_origin) : m_figures_
 	state.projection_plane_distance = DEFAULT_PROJECTION_PLANE_DISTANCE;
 	state.sensitivity = 1.0;
 	state.fineness = DEFAULT_FINENESS;
+	state.tessellation_mode = TESSELLATION_UNIFORM;
+	state.tessellation_tolerance = DEFAULT_TESSELLATION_TOLERANCE;
 
 	state.bg_color = BG_DEFAULT_COLOR;
 	state.wire_color = WIRE_DEFAULT_COLOR;
@@ -402,7 +714,6 @@ IritWorld::IritWorld(Vector axes[NUM_OF_AXES], Vector &axes_origin) : m_figures_
 }
 
 IritWorld::~IritWorld() {
-	delete[] m_figures_arr; 
 }
 
 void IritWorld::setScreenMat(Vector axes[NUM_OF_AXES], Vector &axes_origin, int screen_width, int screen_height) {
@@ -428,6 +739,8 @@ void IritWorld::setScreenMat(Vector axes[NUM_OF_AXES], Vector &axes_origin, int
 	// Center to screen
 	center_mat = createTranslationMatrix(axes_origin);
 	state.center_mat = center_mat;
+
+	invalidateProjection();
 }
 
 void IritWorld::setOrthoMat()
@@ -446,38 +759,97 @@ void IritWorld::setOrthoMat()
 	state.ortho_mat.array[X_AXIS][3] = -(max_x + min_x) / (max_x - min_x);
 	state.ortho_mat.array[Y_AXIS][3] = -(max_y + min_y) / (max_y - min_y);
 	state.ortho_mat.array[Z_AXIS][3] =  (max_z + min_z) / (max_z - min_z);
+
+	invalidateProjection();
+}
+
+void IritWorld::invalidateProjection() {
+	m_is_projection_dirty = true;
+}
+
+void IritWorld::updateProjection() {
+	if (!m_is_projection_dirty &&
+		m_cached_is_perspective == state.is_perspective_view &&
+		m_cached_plane_distance == state.projection_plane_distance)
+		return;
+
+	m_projection_mat = createProjectionMatrix();
+	state.screen_mat = state.center_mat * state.ratio_mat;
+
+	m_cached_is_perspective = state.is_perspective_view;
+	m_cached_plane_distance = state.projection_plane_distance;
+	m_is_projection_dirty = false;
+	m_projection_version++;
 }
 
 IritFigure *IritWorld::createFigure() {
-	IritFigure *new_figure = new IritFigure();
-	if (!new_figure)
-		return nullptr;
+	m_figures.emplace_back(new IritFigure());
+	return m_figures.back().get();
+}
 
-	if (!addFigureP(new_figure))
-		return nullptr;
+int IritWorld::getFiguresNr() const {
+	return (int)m_figures.size();
+}
 
-	return new_figure;
+IritFigure &IritWorld::getFigure(int i) {
+	return *m_figures[i];
 }
 
-bool IritWorld::addFigureP(IritFigure *p_figure) {
+void IritWorld::removeLastFigure() {
+	assert(!m_figures.empty());
 
-	IritFigure **new_figures_array = new IritFigure*[m_figures_nr + 1];
-	if (!new_figures_array)
-		return false;
+	m_figures.pop_back();
+}
 
-	for (int i = 0; i < m_figures_nr; i++)
-		new_figures_array[i] = m_figures_arr[i];
-	new_figures_array[m_figures_nr] = p_figure;
+void IritWorld::addFigures(std::vector<std::unique_ptr<IritFigure>> &figures) {
+	for (std::unique_ptr<IritFigure> &figure : figures)
+		m_figures.push_back(std::move(figure));
 
-	delete m_figures_arr;
-	m_figures_arr = new_figures_array;
-	m_figures_nr++;
+	figures.clear();
+	updateBoundingFrame();
+}
 
-	return true;
+void IritWorld::removeFigure(IritFigure *figure) {
+	for (int i = 0; i < (int)m_figures.size(); i++) {
+		if (m_figures[i].get() == figure) {
+			m_figures.erase(m_figures.begin() + i);
+			break;
+		}
+	}
+
+	updateBoundingFrame();
+}
+
+void IritWorld::updateBoundingFrame() {
+	Vector figure_min, figure_max;
+
+	for (int f = 0; f < (int)m_figures.size(); f++) {
+		m_figures[f]->getBoundingFrame(figure_min, figure_max);
+
+		if (f == 0) {
+			min_bound_coord = figure_min;
+			max_bound_coord = figure_max;
+			continue;
+		}
+
+		for (int i = 0; i < 3; i++) {
+			min_bound_coord[i] = min(min_bound_coord[i], figure_min[i]);
+			max_bound_coord[i] = max(max_bound_coord[i], figure_max[i]);
+		}
+	}
+}
+
+int IritWorld::getVisiblePolygonsNr() {
+	int polygons_nr = 0;
+
+	for (std::unique_ptr<IritFigure> &figure : m_figures)
+		polygons_nr += figure->getVisiblePolygonsNr();
+
+	return polygons_nr;
 }
 
 bool IritWorld::isEmpty() {
-	return m_figures_nr == 0;
+	return m_figures.empty();
 };
 
 Matrix IritWorld::getPerspectiveMatrix(const double &angleOfView, const double &near_z, const double &far_z)
@@ -521,33 +893,49 @@ Matrix IritWorld::createProjectionMatrix() {
 }
 
 void IritWorld::draw(int *bitmap, int width, int height) {
-		Matrix projection_mat = createProjectionMatrix();
-
-		this->state.screen_mat = state.center_mat * state.ratio_mat;
+		updateProjection();
+		m_frame_stats = FrameStats();
+
+		// The pool's threads are only started once something is drawn
+		if (!m_is_line_bands_checked) {
+			if (std::thread::hardware_concurrency() > 1)
+				m_line_bands.reset(new LineBands());
+			m_is_line_bands_checked = true;
+		}
 
 		// Draw all objects
-		for (int i = 0; i < m_figures_nr; i++)
-			m_figures_arr[i]->draw(bitmap, width, height, projection_mat, state);
+		for (std::unique_ptr<IritFigure> &figure : m_figures)
+			figure->draw(bitmap, width, height, m_projection_mat, m_projection_version, state, m_frame_stats,
+						 m_line_bands.get());
+
+		if (m_line_bands)
+			m_line_bands->Finish(bitmap, width, height);
+}
+
+const FrameStats &IritWorld::getFrameStats() const {
+	return m_frame_stats;
 }
 
 IritFigure *IritWorld::getFigureInPoint(CPoint &point) {
 	IritFigure *figure;
-	Matrix projection_mat = createProjectionMatrix();
 	Matrix transformation_mat;
 
-	Vector min_2d_point, max_2d_point;
+	Vector min_2d_point, max_2d_point, min_bound, max_bound;
 
 	int max_x, min_x, max_y, min_y;
+
+	updateProjection();
 	
-	for (int i = 0; i < m_figures_nr; i++) {
-		figure = m_figures_arr[i];
+	for (int i = 0; i < (int)m_figures.size(); i++) {
+		figure = m_figures[i].get();
 		/* The received point assumes that the point is given in a coordinate system in which 
 		 * the y value grows down (left-upper corner is (0, 0) ). To match our coordinate system
 		   to the point's, we rotate the object by 'coord_mat' */
-		transformation_mat = projection_mat * state.coord_mat * figure->world_mat * figure->object_mat;
+		transformation_mat = m_projection_mat * state.coord_mat * figure->world_mat * figure->object_mat;
 
-		min_2d_point = projectPoint(figure->min_bound_coord, transformation_mat);
-		max_2d_point = projectPoint(figure->max_bound_coord, transformation_mat);
+		figure->getBoundingFrame(min_bound, max_bound);
+		min_2d_point = projectPoint(min_bound, transformation_mat);
+		max_2d_point = projectPoint(max_bound, transformation_mat);
 
 		max_x = (int)max(min_2d_point[X_AXIS], max_2d_point[X_AXIS]);
 		min_x = (int)min(min_2d_point[X_AXIS], max_2d_point[X_AXIS]);
@@ -563,9 +951,9 @@ IritFigure *IritWorld::getFigureInPoint(CPoint &point) {
 }
 
 IritFigure &IritWorld::getLastFigure() {
-	assert(m_figures_nr > 0);
+	assert(!m_figures.empty());
 
-	return *m_figures_arr[m_figures_nr - 1];
+	return *m_figures.back();
 }
 
 Matrix createTranslationMatrix(double &x, double &y, double z) {
@@ -595,135 +983,233 @@ Matrix createViewMatrix(double x, double y, double z)
 	return camera_translation.Inverse();
 }
 
-void lineDrawOct0(int *bits, int width, int height, RGBQUAD color, Vector first, Vector second) {
-	int dx = (int)(second[0] - first[0]),
-		dy = (int)(second[1] - first[1]),
-		error = (2 * dy) - dx,
-		x = (int)first[0],
-		y = (int)first[1],
-		end_x = (int)second[0],
-		end_y = (int)second[1];
-
-	while (x != end_x) {
-		if ((x >= 0) && (x < width) && (y >= 0) && (y < height)) {
-			bits[y * width + x] = *((int*)&color);
-		}			
-		if (error > 0) {
-			y++;
-			x++;
-			error += 2 * (dy -  dx); // North-East
-		} else {
-			x++;
-			error += 2 * dy;         // East
-		}
-	}
+/* Smallest integer >= a / b, for b > 0 */
+static long long ceilDivide(long long a, long long b) {
+	return (a >= 0) ? (a + b - 1) / b : -(-a / b);
 }
 
-void lineDrawOct1(int *bits, int width, int height, RGBQUAD color, Vector first, Vector second) {
-	int dx = (int)(second[0] - first[0]),
-		dy = (int)(second[1] - first[1]),
-		error = dy - (2 * dx),
-		x = (int)first[0],
-		y = (int)first[1],
-		end_x = (int)second[0],
-		end_y = (int)second[1];
-
-	while (y != end_y) {
-		if ((x >= 0) && (x < width) && (y >= 0) && (y < height))
-			bits[y * width + x] = *((int*)&color);
-		if (error > 0) {
-			y++;
-			error += -2 * dx;       // North
+/* Liang-Barsky: clips the segment first + t * (second - first), t in [0, 1],
+ * to the rectangle [min_x, max_x] x [min_y, max_y]. Returns false if none of
+ * it is in the rectangle
+ */
+static bool clipSegment(double &first_x, double &first_y, double &second_x, double &second_y,
+						double min_x, double min_y, double max_x, double max_y) {
+	double dx = second_x - first_x, dy = second_y - first_y;
+	// For every edge, p * t <= q holds for the part of the segment inside it
+	double p[4] = {-dx, dx, -dy, dy},
+		   q[4] = {first_x - min_x, max_x - first_x, first_y - min_y, max_y - first_y};
+	double t_enter = 0, t_exit = 1;
+
+	for (int i = 0; i < 4; i++) {
+		if (p[i] == 0) {
+			if (q[i] < 0)
+				return false; // Parallel to the edge, and outside it
+		} else if (p[i] < 0) {
+			t_enter = max(t_enter, q[i] / p[i]);
 		} else {
-			y++;
-			x++;
-			error += 2 * (dy - dx); // North-East
+			t_exit = min(t_exit, q[i] / p[i]);
 		}
 	}
+
+	if (t_enter > t_exit)
+		return false;
+
+	second_x = first_x + t_exit * dx;
+	second_y = first_y + t_exit * dy;
+	first_x += t_enter * dx;
+	first_y += t_enter * dy;
+
+	return true;
 }
 
-void lineDrawOct6(int *bits, int width, int height, RGBQUAD color, Vector first, Vector second) {
-	int dx = (int)(second[0] - first[0]),
-		dy = (int)(second[1] - first[1]),
-		error = dy + (2 * dx),
-		x = (int)first[0],
-		y = (int)first[1],
-		end_x = (int)second[0],
-		end_y = (int)second[1];
-
-	while (y != end_y) {
-		if ((x >= 0) && (x < width) && (y >= 0) && (y < height))
-			bits[y * width + x] = *((int*)&color);
-		if (error > 0) {
-			y--;
-			x++;
-			error += 2 * (dy + dx); // South-East
-		} else {
-			y--;
-			error += 2 * dx;        // South
-		}
-	}
+/* Draws a line from the pixel of first to the pixel of second, not including
+ * the last one, so the edges of a polygon don't draw its vertices twice.
+ *
+ * The pixels are Bresenham's, and only the ones inside the bitmap are walked:
+ * the range of steps along the major axis which stay inside is solved for in
+ * closed form (the integer version of Liang-Barsky), and the error term is
+ * computed for the first of them. So the loop has no bounds test, and picks
+ * the minor axis step with masks instead of a branch. Endpoints far outside
+ * the bitmap are first clipped to a guard band around it in sub-pixel
+ * precision, so their pixels fit in an int.
+ */
+void lineDraw(int *bits, int width, int height, RGBQUAD color, Vector first, Vector second) {
+	lineDraw(bits, width, height, color, first, second, 0, height);
 }
 
-void lineDrawOct7(int *bits, int width, int height, RGBQUAD color, Vector first, Vector second) {
-	int dx = (int)(second[0] - first[0]),
-		dy = (int)(second[1] - first[1]),
-		error = (2 * dy) + dx,
-		x = (int)first[0],
-		y = (int)first[1],
-		end_x = (int)second[0],
-		end_y = (int)second[1];
-
-	while (x != end_x) {
-		if ((x >= 0) && (x < width) && (y >= 0) && (y < height))
-			bits[y * width + x] = *((int*)&color);
-		if (error > 0) {
-			x++;
-			error += 2 * dy; // East
+void lineDraw(int *bits, int width, int height, RGBQUAD color, Vector first, Vector second,
+			  int first_row, int last_row) {
+	double first_x = first[0], first_y = first[1], second_x = second[0], second_y = second[1];
+
+	first_row = max(first_row, 0);
+	last_row = min(last_row, height);
+
+	// Not a number, or infinite (like the projection of a point on the eye plane)
+	if (!(fabs(first_x) + fabs(first_y) + fabs(second_x) + fabs(second_y) < HUGE_VAL))
+		return;
+
+	if ((min(first_x, second_x) < -LINE_GUARD_BAND || max(first_x, second_x) > width + LINE_GUARD_BAND ||
+		 min(first_y, second_y) < -LINE_GUARD_BAND || max(first_y, second_y) > height + LINE_GUARD_BAND) &&
+		!clipSegment(first_x, first_y, second_x, second_y, -LINE_GUARD_BAND, -LINE_GUARD_BAND,
+					 width + LINE_GUARD_BAND, height + LINE_GUARD_BAND))
+		return;
+
+	int x0 = (int)floor(first_x), y0 = (int)floor(first_y),
+		x1 = (int)floor(second_x), y1 = (int)floor(second_y);
+	int step_x = (x1 >= x0) ? 1 : -1, step_y = (y1 >= y0) ? 1 : -1;
+	long long delta_x = (long long)(x1 - x0) * step_x, delta_y = (long long)(y1 - y0) * step_y;
+
+	// Everything along the axis which changes more (x on ties) is the major one
+	bool is_x_major = delta_x >= delta_y;
+	long long major_delta = is_x_major ? delta_x : delta_y,
+			  minor_delta = is_x_major ? delta_y : delta_x;
+	long long major_start = is_x_major ? x0 : y0, minor_start = is_x_major ? y0 : x0;
+	int major_step = is_x_major ? step_x : step_y, minor_step = is_x_major ? step_y : step_x;
+	// Coordinates along each axis which are drawn, [low, high)
+	long long major_low = is_x_major ? 0 : first_row, major_high = is_x_major ? width : last_row,
+			  minor_low = is_x_major ? first_row : 0, minor_high = is_x_major ? last_row : width;
+	int major_stride = is_x_major ? step_x : step_y * width,
+		minor_stride = is_x_major ? step_y * width : step_x;
+
+	if (major_delta == 0)
+		return; // The same pixel, which isn't drawn since the last pixel isn't
+
+	/* Pixel k is major_start + major_step * k along the major axis, and
+	 * minor_start + minor_step * m(k) along the minor one, where
+	 * m(k) = floor((2 * k * minor_delta + major_delta - 1) / (2 * major_delta))
+	 * is k's minor offset, rounded with ties down, as the error term decides it */
+	long long first_step = 0, last_step = major_delta; // [first_step, last_step)
+
+	// Lines inside the drawn rows (most of a scene which isn't zoomed in) skip the divisions
+	if (min(x0, x1) < 0 || max(x0, x1) >= width || min(y0, y1) < first_row || max(y0, y1) >= last_row) {
+		// Steps inside the drawn rows along the major axis
+		if (major_step > 0) {
+			first_step = max(first_step, major_low - major_start);
+			last_step = min(last_step, major_high - major_start);
 		} else {
-			x++;
-			y--;
-			error += 2 * (dx + dy); // South-East
+			first_step = max(first_step, major_start - major_high + 1);
+			last_step = min(last_step, major_start - major_low + 1);
 		}
-	}
-}
 
-void lineDraw(int *bits, int width, int height, RGBQUAD color, Vector first, Vector second) {
-	double delta_x, delta_y, ratio;
+		// Minor offsets inside the drawn rows, then the steps which have them
+		long long min_offset = (minor_step > 0) ? minor_low - minor_start : minor_start - minor_high + 1,
+				  max_offset = (minor_step > 0) ? minor_high - 1 - minor_start : minor_start - minor_low;
 
-	// Handle case where they are vertical
-	if (first[0] == second[0]) {
-		if (first[1] < second[1]) {
-			lineDrawOct1(bits, width, height, color, first, second);
+		if (minor_delta == 0) {
+			if (min_offset > 0 || max_offset < 0)
+				return;
 		} else {
-			if (first[1] > second[2]) {
-				lineDrawOct6(bits, width, height, color, first, second);
-			} else {
-				return; // They are the same point
-			}
+			// The first step whose offset is at least o is ceil(((2 * o - 1) * major + 1) / (2 * minor))
+			if (min_offset > 0)
+				first_step = max(first_step, ceilDivide((2 * min_offset - 1) * major_delta + 1, 2 * minor_delta));
+			last_step = min(last_step, max(0LL, ceilDivide((2 * max_offset + 1) * major_delta + 1, 2 * minor_delta)));
 		}
 	}
 
-	if (first[0] > second[0]) { // Octants 2 3 4 5
-		// Just draw the lines the opposite direction, this way we need only 4 drawing functions
-		Vector temp = first;
-		first = second;
-		second = temp;
+	if (first_step >= last_step)
+		return;
+
+	long long offset = (first_step == 0) ? 0 : (2 * first_step * minor_delta + major_delta - 1) / (2 * major_delta);
+	int index = (int)((major_start + major_step * first_step) * (is_x_major ? 1 : width) +
+					  (minor_start + minor_step * offset) * (is_x_major ? width : 1));
+	// The guard band keeps the error term and the steps in an int
+	int error = (int)(2 * minor_delta * (first_step + 1) - major_delta - 2 * major_delta * offset),
+		two_minor_delta = (int)(2 * minor_delta), two_major_delta = (int)(2 * major_delta);
+	int value = *((int*)&color);
+
+	for (int steps_nr = (int)(last_step - first_step); steps_nr > 0; steps_nr--) {
+		// All ones if the minor axis steps too, zero otherwise
+		int mask = -(error > 0);
+
+		bits[index] = value;
+		index += major_stride + (minor_stride & mask);
+		error += two_minor_delta - (two_major_delta & mask);
+	}
+}
+
+// Planes lines are clipped against before the perspective divide
+enum ClipPlane {
+	CLIP_NEAR,
+	CLIP_LEFT,
+	CLIP_RIGHT,
+	CLIP_TOP,
+	CLIP_BOTTOM,
+	CLIP_PLANES_NR
+};
+
+/* Fills the signed distances of a point in homogeneous screen coordinates
+ * from the near plane and from the sides of the guard band, positive on their
+ * inner side. Returns a bit for every plane the point is outside of
+ */
+static int clipDistances(const Vector &point, int width, int height, double distances[CLIP_PLANES_NR]) {
+	double x = point[0], y = point[1], w = point[3];
+	int outside = 0;
+
+	distances[CLIP_NEAR] = w - CLIP_NEAR_W;
+	distances[CLIP_LEFT] = x + LINE_GUARD_BAND * w;
+	distances[CLIP_RIGHT] = (width + LINE_GUARD_BAND) * w - x;
+	distances[CLIP_TOP] = y + LINE_GUARD_BAND * w;
+	distances[CLIP_BOTTOM] = (height + LINE_GUARD_BAND) * w - y;
+
+	for (int i = 0; i < CLIP_PLANES_NR; i++) {
+		if (distances[i] < 0)
+			outside |= 1 << i;
 	}
 
-	// Now we should be in octants 0 1 6 7
+	return outside;
+}
+
+/* Returns a bit for every edge of the bitmap a point in homogeneous screen
+ * coordinates is outside of
+ */
+static int bitmapOutcode(const Vector &point, int width, int height) {
+	double x = point[0], y = point[1], w = point[3];
+
+	return (x < 0) | ((x >= width * w) << 1) | ((y < 0) << 2) | ((y >= height * w) << 3);
+}
+
+void clipLineDraw(int *bits, int width, int height, RGBQUAD color, const Vector &first,
+				  const Vector &second, LineBands *bands) {
+	double first_distances[CLIP_PLANES_NR], second_distances[CLIP_PLANES_NR];
+	int first_outside = clipDistances(first, width, height, first_distances),
+		second_outside = clipDistances(second, width, height, second_distances);
+
+	// Both ends are on the outer side of the same plane, or of the same edge of the bitmap
+	if ((first_outside & second_outside) ||
+		(bitmapOutcode(first, width, height) & bitmapOutcode(second, width, height)))
+		return;
+
+	Vector first_end = first, second_end = second;
 
-	delta_x = second[0] - first[0];
-	delta_y = second[1] - first[1];
-	ratio = delta_y / delta_x;
+	/* Only lines which cross the near plane or the guard band are clipped.
+	 * The rest of the lines which cross the bitmap's edges are clipped
+	 * by lineDraw, after the divide, which is cheaper */
+	if (first_outside | second_outside) {
+		double t_enter = 0, t_exit = 1;
 
-	if (ratio >= 1.0) {							   // Octant 1
-		lineDrawOct1(bits, width, height, color, first, second);
-	} else if ((ratio >= 0.0) && (ratio < 1.0)) {  // Octant 0
-		lineDrawOct0(bits, width, height, color, first, second);
-	} else if ((ratio >= -1.0) && (ratio < 0.0)) { // Octant 7
-		lineDrawOct7(bits, width, height, color, first, second);
-	} else {									   // Octant 6
-		lineDrawOct6(bits, width, height, color, first, second);
+		for (int i = 0; i < CLIP_PLANES_NR; i++) {
+			double t = first_distances[i] / (first_distances[i] - second_distances[i]);
+
+			if (first_distances[i] < 0)
+				t_enter = max(t_enter, t);
+			else if (second_distances[i] < 0)
+				t_exit = min(t_exit, t);
+		}
+
+		if (t_enter >= t_exit)
+			return;
+
+		for (int i = 0; i < 4; i++) {
+			first_end[i] = first[i] + t_enter * (second[i] - first[i]);
+			second_end[i] = first[i] + t_exit * (second[i] - first[i]);
+		}
 	}
+
+	first_end.Homogenize();
+	second_end.Homogenize();
+
+	if (bands)
+		bands->Add(color, first_end, second_end);
+	else
+		lineDraw(bits, width, height, color, first_end, second_end);
 }
@@ -1,9 +1,16 @@
 #pragma once
 #include <afxwin.h>
 #include <assert.h>
+#include <vector>
 #include <iritprsr.h>
 #include "Vector.h"
 #include "Matrix.h"
+#include "Quaternion.h"
+#include "Arena.h"
+#include "StableArray.h"
+#include "MappedFile.h"
+#include <memory>
+#include <mutex>
 
 // The color scheme here is    <B G R *reserved*>
 #define BG_DEFAULT_COLOR		{0, 0, 0, 0}       // Black
@@ -16,6 +23,7 @@
 #define DEFAULT_PROJECTION_PLANE_DISTANCE 20
 #define DEAULT_VIEW_PARAMETERS 0, 0, -20
 #define DEFAULT_FINENESS 20.0
+#define DEFAULT_TESSELLATION_TOLERANCE 0.01
 
 #define RGB_TO_RGBQUAD(x) {(BYTE)((x & 0xff0000) >> 16), (BYTE)((x & 0xff00) >> 8), (BYTE)(x & 0xff), 0}
 
@@ -26,6 +34,31 @@
 */
 Matrix createViewMatrix(double x, double y, double z);
 
+/* Draws a line between two points in screen coordinates, clipped to the bitmap
+ * @bits, width, height - the bitmap, row by row
+ * @first, second - the line's ends. Only their x and y are used
+ */
+void lineDraw(int *bits, int width, int height, RGBQUAD color, Vector first, Vector second);
+
+/* Draws only the pixels of the line above which are in rows [@first_row,
+ * @last_row). Drawing a line in several row ranges draws the same pixels as
+ * drawing it at once, so disjoint ranges can be drawn by different threads
+ */
+void lineDraw(int *bits, int width, int height, RGBQUAD color, Vector first, Vector second,
+			  int first_row, int last_row);
+
+class LineBands;
+
+/* Draws a line between two points in homogeneous screen coordinates (before
+ * the perspective divide). The line is clipped to the near plane, and, if it
+ * goes far off the bitmap, to a guard band around it, before it's divided
+ * @first, second - the line's ends, as the screen transform left them
+ * @bands - if not null, the line is added to it, to be drawn with the rest
+ *			of the frame, instead of being drawn right away
+ */
+void clipLineDraw(int *bits, int width, int height, RGBQUAD color, const Vector &first,
+				  const Vector &second, LineBands *bands = nullptr);
+
 // this enum prob isnt needed, beacuse of built in axis info - m_nAxis
 enum Axis {
 	X_AXIS,
@@ -35,14 +68,21 @@ enum Axis {
 };
 
 class IritPolygon;
+class IritObject;
 
 struct IritPoint {
 	Vector vertex;
 	Vector normal;
 
 	bool is_irit_normal;
+};
 
-	struct IritPoint *next_point;
+// How freeforms are tessellated
+enum TessellationMode {
+	TESSELLATION_UNIFORM,	// fineness polygons along every direction
+	TESSELLATION_CHORDAL,	// Subdivided until the polygons are within the tolerance of the surface
+	TESSELLATION_NORMAL,	// Subdivided until the normals vary by less than the tolerance (degrees)
+	TESSELLATION_MODES_NR
 };
 
 struct State {
@@ -57,6 +97,8 @@ struct State {
 	double projection_plane_distance;
 	double sensitivity;
 	double fineness;
+	TessellationMode tessellation_mode;
+	double tessellation_tolerance;	// Of the adaptive modes
 
 	bool is_axis_active[3];
 
@@ -77,30 +119,37 @@ struct State {
 	RGBQUAD normal_color;
 };
 
+// What drawing a frame took, counted by the world while it draws
+struct FrameStats {
+	long long vertices_transformed;	// Points multiplied by a figure's transform
+	long long lines_drawn;			// Edges and normals, before they're clipped
+};
+
 struct PolygonList {
 	IPPolygonStruct *skel_polygon;
 	IritPolygon *polygon;
 	PolygonList *next;
 };
 
-struct VertexList {
-	IPVertexStruct *vertex;
-	PolygonList *polygon_list;
-	VertexList *next;
-};
-
+/* A polygon is a view of its object's vertex buffers - its points are
+ * m_point_nr consecutive entries of the object's index buffer, starting
+ * at m_first_index. Polygons are created by their object, and the points
+ * of one polygon have to be added one after the other (without adding
+ * points to other polygons of the object in between).
+ */
 class IritPolygon {
+	IritObject *m_object;
+	int m_first_index;
 	int m_point_nr;
-	struct IritPoint *m_points;
 
-	IritPolygon *m_next_polygon;
+	friend class IritObject;
 
 public:
 	Vector normal_start;
 	Vector normal_end;
 	bool is_irit_normal;
 
-	IritPolygon();
+	IritPolygon(IritObject *object);
 
 	~IritPolygon();
 	
@@ -112,69 +161,200 @@ public:
 
 	bool addPoint(IPVertexStruct *vertex, bool is_irit_normal, Vector normal);
 
-	IritPolygon *getNextPolygon();
+	int getPointsNr() const;
 
-	void setNextPolygon(IritPolygon *polygon);
+	// Index of the polygon's first point in its object's index buffer
+	int getFirstIndex() const;
 
-	/* Draws an polygon (draw lines between each of its points).
-	 * Each of the points is multiplied by a transformation matrix.
-	 * @pDCToUse - a pointer to the the DC with which the
-	 *				polygon is drawn
-	 * @state - world state (current coordinate system, scaling function
-	 *					 etc.)
-	 * @normal_transform - a transformation matrix for the normal vectors
-	 * @vertex_transform - a transformation matrix for the the vertices (each
-	 *						vertex is multiplied by this matrix before being drawn
+	/* Returns the position of the polygon's @i'th point in its object's
+	 * vertex buffers */
+	int getVertexIndex(int i) const;
+
+	/* Draws an polygon (draw lines between each of its points, and from
+	 * the last one back to the first).
+	 * @screen_vertices - the object's vertices in homogeneous screen
+	 *					  coordinates, which are clipped and drawn
+	 * @bands - see clipLineDraw()
 	*/
-	void draw(int *bitmap, int width, int height, RGBQUAD color, struct State state,
-			  Matrix &vertex_transform);
+	void draw(int *bitmap, int width, int height, RGBQUAD color, const Vector *screen_vertices,
+			  FrameStats &stats, LineBands *bands);
 
-	// Operators overriding
-	IritPolygon &operator++();
+	/* Draws the normals the state shows, of the polygon and of its points
+	 * @screen_normals - both ends of the normal of every vertex of the
+	 *					 object, in homogeneous screen coordinates
+	 * @screen_polygon_normal - both ends of the polygon's normal
+	 */
+	void drawNormals(int *bitmap, int width, int height, const struct State &state,
+					 const Vector *screen_normals, const Vector *screen_polygon_normal,
+					 FrameStats &stats, LineBands *bands);
 };
 
 /* This class represents an object in the IRIT world. An object is formed from
  * a list of polygons (each represented by its vertices)
  */
 class IritObject {
-	int m_polygons_nr;
-	IritPolygon *m_polygons;
-	IritPolygon *m_iterator;
+	StableArray<IritPolygon> m_polygons;
+
+	/* Vertex buffers, one entry per vertex. Positions are kept in double
+	 * precision since the rasterizer truncates them, but normals are only
+	 * drawn as short lines so single precision is enough for them */
+	std::vector<Vector, ArenaAllocator<Vector> > m_positions;
+	std::vector<Vec4f, ArenaAllocator<Vec4f> > m_normals;
+	std::vector<unsigned char, ArenaAllocator<unsigned char> > m_is_irit_normal;
+
+	// The polygons' points, each polygon is a range of it
+	std::vector<int, ArenaAllocator<int> > m_indices;
+
+	/* Buffers which the object doesn't own (a mapped mesh cache), used
+	 * instead of the ones above when m_attached_positions isn't null */
+	const Vector *m_attached_positions;
+	const Vec4f *m_attached_normals;
+	const unsigned char *m_attached_is_irit_normal;
+	const int *m_attached_indices;
+	int m_attached_vertices_nr;
+	int m_attached_indices_nr;
+
+	/* The wireframe, as a list of the object's edges, each listed once
+	 * although the two polygons around it share it. Edges are pairs of
+	 * wire vertices - the welded vertices of the object - and wire vertex
+	 * w is drawn at point m_wire_vertices[w] of the vertex buffers (one of
+	 * the points which were welded into it). Attached like the buffers */
+	std::vector<int, ArenaAllocator<int> > m_wire_vertices;
+	std::vector<int, ArenaAllocator<int> > m_edges;
+	const int *m_attached_wire_vertices;
+	const int *m_attached_edges;
+	int m_attached_wire_vertices_nr;
+	int m_attached_edges_nr;
+
+	/* The object in homogeneous screen coordinates, which all of its
+	 * drawing reads. The buffers are transformed in batches, only when the
+	 * figure's transform changed since they were (their version differs):
+	 * m_screen_vertices holds the wire vertices (or all the vertices, for
+	 * objects without edges), m_screen_normals both ends of every vertex's
+	 * normal and m_screen_polygon_normals those of every polygon's, the
+	 * last two only once normals are shown */
+	std::vector<Vector> m_screen_vertices;
+	std::vector<Vector> m_screen_normals;
+	std::vector<Vector> m_screen_polygon_normals;
+	unsigned int m_screen_vertices_version;
+	unsigned int m_screen_normals_version;
+	unsigned int m_screen_polygon_normals_version;
+
+	void updateScreenBuffers(const struct State &state, const Matrix &screen_transform,
+							 unsigned int transform_version, FrameStats &stats);
 
 public:
 	RGBQUAD object_color;
 
-	IritObject();
+	/* Hidden objects aren't drawn, e.g. the tessellation of a freeform with
+	 * another fineness. Changed only through IritFigure::setObjectsHidden()
+	 */
+	bool is_hidden;
+
+	/* @arena - where the object's polygons and vertices are allocated.
+	 * It must outlive the object. If null, the heap is used.
+	 */
+	IritObject(Arena *arena = nullptr);
 	
 	~IritObject();
 
-	/* Received a pointer to a new polygon, and adds this polygon to the list
-	 * of polygons in the object. The polygon is always added as the last
-	 * polygon.
-	 * @polygon - a pointer to the polygon to add
+	/* Adds a vertex to the object's vertex buffers and appends it to
+	 * @polygon, which must be one of the object's polygons.
+	 * returns false if @polygon isn't the object's, or if points were
+	 * added to another polygon since its last point was added
+	 */
+	bool addPoint(IritPolygon &polygon, const struct IritPoint &point);
+
+	/* Makes room for @vertices_nr more vertices. Adding them won't
+	 * reallocate the vertex buffers (which wastes arena memory) */
+	void reserveVertices(int vertices_nr);
+
+	/* Makes the object use buffers it doesn't own, which must outlive it.
+	 * Points can't be added to an object with attached buffers, its
+	 * polygons are created over ranges of @indices instead.
+	 * returns false if the object already has vertices
+	 */
+	bool attachBuffers(const Vector *positions, const Vec4f *normals,
+					   const unsigned char *is_irit_normal, int vertices_nr,
+					   const int *indices, int indices_nr);
+
+	int getVerticesNr() const;
+
+	int getIndicesNr() const;
+
+	const Vector *getPositions() const;
+
+	const Vec4f *getNormals() const;
+
+	const unsigned char *getIsIritNormal() const;
+
+	const int *getIndices() const;
+
+	/* Builds the wireframe's edge list, once all the polygons were added
+	 * @point_vertices - the welded vertex of every entry of the index buffer
+	 * @vertices_nr - the number of welded vertices
+	 * returns false if the object already has edges
+	 */
+	bool buildEdges(const int *point_vertices, int vertices_nr);
+
+	/* Makes the object use an edge list it doesn't own (as built by
+	 * buildEdges()), which must outlive it.
+	 * returns false if the object already has edges
 	 */
-	void addPolygonP(IritPolygon *polygon);
+	bool attachEdges(const int *wire_vertices, int wire_vertices_nr, const int *edges, int edges_nr);
+
+	// Objects without edges draw every polygon's outline instead
+	bool hasEdges() const;
+
+	int getWireVerticesNr() const;
+
+	int getEdgesNr() const;
+
+	const int *getWireVertices() const;
+
+	// Pairs of wire vertices, getEdgesNr() of them
+	const int *getEdges() const;
 
 	/* Creates an empty polygon and returns a pointer to it.
 	 * the polygon is added to the list of polygons of the object
-	 * as the last polygon.
-	 * returns null pointer on memory failure
+	 * as the last polygon. The pointer stays valid as long as the
+	 * object exists.
 	 */
 	IritPolygon *createPolygon();
 
-	/* Draws an object (each of its polygons at a time). Each
-	 * of the points of the object are multiplied by a transformation
-	 * matrix.
-	 * @pDCToUse - a pointer to the the DC with which the
-	 *				object is drawn
+	/* Creates a polygon of the @points_nr points at @first_index of the
+	 * index buffer, for objects with attached buffers. returns null if the
+	 * range is outside the buffer
+	 */
+	IritPolygon *createPolygon(int first_index, int points_nr);
+
+	int getPolygonsNr() const;
+
+	IritPolygon &getPolygon(int i);
+
+	/* Draws an object (its edges, or each of its polygons at a time if it
+	 * has no edge list). Each of the points of the object are multiplied by
+	 * a transformation matrix.
 	 * @state - world state (current coordinate system, scaling function
 	 *					 etc.)
-	 * @normal_transform - a transformation matrix for the normal vectors
-	 * @vertex_transform - a transformation matrix for the the vertices (each
-	 *						vertex is multiplied by this matrix before being drawn
+	 * @screen_transform - a transformation matrix for the the vertices (each
+	 *						vertex is multiplied by this matrix, into homogeneous
+	 *						screen coordinates, before being clipped and drawn)
+	 * @transform_version - changes whenever @screen_transform does
+	 * @stats - what drawing the object took is added to it
+	 * @bands - see clipLineDraw()
 	*/
-	void draw(int *bitmap, int width, int height, struct State state,
-			  Matrix &vertex_transform);
+	void draw(int *bitmap, int width, int height, const struct State &state,
+			  const Matrix &screen_transform, unsigned int transform_version, FrameStats &stats,
+			  LineBands *bands);
+};
+
+/* What a figure was made from, kept by a loader which can remake the
+ * figure's objects later. It is destroyed with the figure.
+ */
+class IritFigureSource {
+public:
+	virtual ~IritFigureSource() {}
 };
 
 /* This class represents an Irit Figure which is build from many objects, which have many
@@ -189,10 +369,49 @@ public:
  *						Point
 */
 class IritFigure {
-	int m_objects_nr;
-	IritObject **m_objects_arr;
+	// All of the figure's geometry is allocated from here, and freed at once with it
+	Arena m_arena;
+	// A mesh cache whose buffers the objects use, if the figure was loaded from one
+	std::unique_ptr<MappedFile> m_mapped_file;
+	std::unique_ptr<IritFigureSource> m_source;
+	StableArray<IritObject> m_objects;
+
+	/* A figure which is loaded in the background gets objects from the
+	 * loader thread while it is drawn. Only the first
+	 * m_published_objects_nr objects are complete and drawn. The mutex
+	 * guards the object table, that count and the bounding frame.
+	 */
+	std::mutex m_objects_mutex;
+	int m_published_objects_nr;
+	bool m_is_loading;
+
+	// Cached composite transforms, see updateTransform()
+	bool m_is_transform_dirty;
+	unsigned int m_projection_version;
+	unsigned int m_transform_version; // Bumped whenever the cache is recomputed
+	Matrix m_screen_transform; // screen * projection * world * object
+
+	/* Recomputes the cached transforms if the figure's matrices changed
+	 * since the last call, or if the projection did (its version differs
+	 * from the one the cache was built with)
+	 */
+	void updateTransform(const Matrix &projection_mat, unsigned int projection_version,
+						 State &state);
 
-	void drawFrame(int *bitmap, int width, int height, struct State state, Matrix &transform);
+	/* Mouse drag rotation, kept as a quaternion and turned into a matrix
+	 * only when the figure is drawn. m_rotated_mat points to the
+	 * matrix it should be applied to, or is null if nothing is pending.
+	 */
+	Quaternion m_drag_rotation;
+	Matrix *m_rotated_mat;
+
+	/* Sets the rotated matrix to the drag rotation composed with the
+	 * backed up transformation, if a rotation is pending
+	 */
+	void applyDragRotation();
+
+	void drawFrame(int *bitmap, int width, int height, struct State state, FrameStats &stats,
+				   LineBands *bands);
 
 public:
 
@@ -216,28 +435,115 @@ public:
 	 */
 	void backup_transformation(State &state);
 
-	/* Receieves a pointer to an object and adds the object
-	 * the objects' list.
-	 * @p_object - a pointer to the object that needs to be added
-	 * returns false on allocation error and true otherwise
-	*/
-	bool addObjectP(IritObject *p_object);
+	/* Adds @delta to the rotation of the current mouse drag. The object or
+	 * world matrix (depending on the state) is updated on the next draw.
+	 */
+	void rotate(const Quaternion &delta, State &state);
 
 	/* Creates an empty object and returns a pointer to it.
 	 * the object is added to the list of objects in the IritWorld.
-	 * It is added as the last object
-	 * return NULL on memory allocation error
+	 * It is added as the last object. The pointer stays valid as long
+	 * as the figure exists.
+	 * @is_hidden - creates the object hidden, so it isn't drawn even if
+	 *				the figure isn't loading
 	*/
-	IritObject *createObject();
+	IritObject *createObject(bool is_hidden = false);
+
+	/* The number of objects created so far, which while loading includes
+	 * unpublished ones. Only the loader may call it while loading.
+	 */
+	int getObjectsNr() const;
+
+	IritObject &getObject(int i);
+
+	/* While @is_loading is true, new objects are drawn only once
+	 * publishObjects() is called. Setting it to false publishes all of them.
+	 */
+	void setLoading(bool is_loading);
+
+	/* Makes all the objects created so far drawable, and sets the bounding
+	 * frame to hold them. Called by the loader thread.
+	 */
+	void publishObjects(const Vector &min_bound, const Vector &max_bound);
+
+	int getPublishedObjectsNr();
+
+	// Reads the bounding frame, safe while the figure is loaded
+	void getBoundingFrame(Vector &min_bound, Vector &max_bound);
+
+	// The polygons which are drawn: of the published objects, but not hidden ones
+	int getVisiblePolygonsNr();
+
+	/* Shows or hides the @objects_nr objects starting at @first_object.
+	 * Safe while objects are created on another thread.
+	 */
+	void setObjectsHidden(int first_object, int objects_nr, bool is_hidden);
+
+	/* Destroys all the objects, for a load which has to start over, and
+	 * frees the figure's geometry for the next load to reuse.
+	 */
+	void clearObjects();
+
+	/* Destroys the objects created after the first @objects_nr, for a
+	 * tessellation which was stopped half way. Their memory is only freed
+	 * with the figure.
+	 */
+	void removeObjects(int objects_nr);
+
+	// Memory used for the figure's geometry
+	const Arena &getArena() const;
+
+	/* Keeps @mapped_file alive for as long as the figure, for objects
+	 * whose buffers are attached to it */
+	void attachMappedFile(std::unique_ptr<MappedFile> mapped_file);
 
-	void draw(int *bitmap, int width, int height, Matrix transform, State &state);
+	// Keeps what the figure was made from, see IritFigureSource
+	void attachSource(std::unique_ptr<IritFigureSource> source);
+
+	// null if no source was attached
+	IritFigureSource *getSource();
+
+	/* Must be called after world_mat or object_mat are modified, so that
+	 * the cached transforms are recomputed on the next draw
+	 */
+	void invalidateTransform();
+
+	/* Draws all the objects of the figure
+	 * @transform - the world's projection matrix
+	 * @projection_version - changes whenever @transform does
+	 * @stats - what drawing the figure took is added to it
+	 * @bands - see clipLineDraw()
+	 */
+	void draw(int *bitmap, int width, int height, const Matrix &transform,
+			  unsigned int projection_version, State &state, FrameStats &stats, LineBands *bands);
 
 	bool isEmpty();
 };
 
 class IritWorld {
-	int m_figures_nr;
-	IritFigure **m_figures_arr;
+	// Figures are owned one by one, so figures loaded elsewhere can be added
+	std::vector<std::unique_ptr<IritFigure>> m_figures;
+
+	// Cached projection, see updateProjection()
+	bool m_is_projection_dirty;
+	bool m_cached_is_perspective;
+	double m_cached_plane_distance;
+	unsigned int m_projection_version;
+	Matrix m_projection_mat;
+
+	FrameStats m_frame_stats;
+
+	/* Draws the lines of every frame on all cores. Created by the first
+	 * frame, and only if there's more than one core
+	 */
+	std::unique_ptr<LineBands> m_line_bands;
+	bool m_is_line_bands_checked;
+
+	/* Recomputes the projection and screen matrices if the view state
+	 * changed since the last call. Each recomputation bumps the projection
+	 * version, which tells the figures to refresh their own caches.
+	 */
+	void updateProjection();
 
 	/* Returns the perspective matrix */
 	Matrix getPerspectiveMatrix(const double &angleOfView, const double &near_z, const double &far_z);
@@ -273,20 +579,41 @@ public:
 
 	void setOrthoMat(void);
 
+	/* Must be called after modifying one of the state's view, ortho,
+	 * center or ratio matrices directly. Changes to the perspective flag
+	 * and projection plane distance are noticed without it.
+	 */
+	void invalidateProjection();
+
 
 	/* Creates an empty figure and returns a pointer to it.
 	 * the figure is added to the list of figures in the IritWorld.
-	 * It is added as the last object
-	 * return NULL on memory allocation error
+	 * It is added as the last object. The pointer stays valid as long
+	 * as the world exists.
 	*/
 	IritFigure *createFigure();
 
-	/* Receieves a pointer to a figure and adds the figure
-	 * the figures' list.
-	 * @p_figure - a pointer to the figure that needs to be added
-	 * returns false on allocation error and true otherwise
-	*/
-	bool addFigureP(IritFigure *p_figure);
+	int getFiguresNr() const;
+
+	IritFigure &getFigure(int i);
+
+	/* Destroys the last figure, for a load which failed half way */
+	void removeLastFigure();
+
+	/* Adds figures which were created outside of the world (e.g. by loader
+	 * threads) as the last figures, in their order in @figures, and grows
+	 * the world's bounding frame to hold them. @figures is left empty.
+	 */
+	void addFigures(std::vector<std::unique_ptr<IritFigure>> &figures);
+
+	/* Destroys @figure, for a background load which failed or was
+	 * cancelled after its figure was added */
+	void removeFigure(IritFigure *figure);
+
+	/* Sets the world's bounding frame to hold the frames of all the
+	 * figures. Must be called when the frame of a figure grows.
+	 */
+	void updateBoundingFrame();
 
 	/* Returns a reference to the last figure in the figures list */
 	IritFigure &getLastFigure();
@@ -297,7 +624,13 @@ public:
 	 */
 	IritFigure *getFigureInPoint(CPoint &point);
 
+	// The polygons the figures draw, see IritFigure::getVisiblePolygonsNr()
+	int getVisiblePolygonsNr();
+
 	bool isEmpty();
 
 	void draw(int *bitmap, int width, int height);
+
+	// What drawing the last frame took
+	const FrameStats &getFrameStats() const;
 };
\ No newline at end of file
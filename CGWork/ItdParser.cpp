@@ -0,0 +1,573 @@
+/* Implementation of the ItdParser class */
+
+#include "ItdParser.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Floating point std::from_chars needs C++17, and isn't in every library that has C++17
+#if (__cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)) && \
+    defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
+
+#if defined(__cpp_lib_to_chars)
+#define ITD_USE_FROM_CHARS
+#endif
+
+// Compares a word with an (upper case) keyword, ignoring case
+static bool isKeyword(const std::string &word, const char *keyword)
+{
+    size_t i = 0;
+
+    for (; i < word.size() && keyword[i]; i++) {
+        if (toupper((unsigned char)word[i]) != keyword[i])
+            return false;
+    }
+
+    return i == word.size() && !keyword[i];
+}
+
+// Objects which only the irit library can turn into polygons
+static bool isUnsupportedKeyword(const std::string &word)
+{
+    static const char *keywords[] = {"CURVE", "SURFACE", "TRIMSRF", "TRIVAR", "TRISRF",
+                                     "MODEL", "MULTIVAR", "INSTANCE", "VMODEL"};
+
+    for (const char *keyword : keywords) {
+        if (isKeyword(word, keyword))
+            return true;
+    }
+
+    return false;
+}
+
+void ItdObject::Clear()
+{
+    name.clear();
+    type = ITD_POLYGONS;
+    attributes.clear();
+    coordinates.clear();
+    normals.clear();
+    has_normal.clear();
+    polygon_offsets.assign(1, 0);
+    planes.clear();
+    has_plane.clear();
+}
+
+int ItdObject::getVerticesNr() const
+{
+    return (int)has_normal.size();
+}
+
+int ItdObject::getPolygonsNr() const
+{
+    return (int)polygon_offsets.size() - 1;
+}
+
+const int *ItdObject::getPolygonsOffsets() const
+{
+    return polygon_offsets.data();
+}
+
+const char *ItdObject::getAttribute(const char *attribute_name) const
+{
+    for (const std::pair<std::string, std::string> &attribute : attributes) {
+        const std::string &current = attribute.first;
+        size_t i = 0;
+
+        while (i < current.size() && attribute_name[i] &&
+               toupper((unsigned char)current[i]) == toupper((unsigned char)attribute_name[i]))
+            i++;
+
+        if (i == current.size() && !attribute_name[i])
+            return attribute.second.c_str();
+    }
+
+    return nullptr;
+}
+
+ItdParser::ItdParser()
+    : m_file(nullptr), m_current(nullptr), m_end(nullptr), m_token(TOKEN_END),
+      m_is_pushed_back(false), m_line(1), m_depth(0), m_objects_nr(0), m_polygons_nr(0),
+      m_vertices_nr(0), m_bytes_nr(0)
+{
+}
+
+ItdParser::~ItdParser()
+{
+    if (m_file)
+        fclose(m_file);
+}
+
+bool ItdParser::Fill()
+{
+    if (!m_file)
+        return false;
+
+    size_t read = fread(m_buffer.data(), 1, m_buffer.size(), m_file);
+
+    m_bytes_nr += read;
+    m_current = m_buffer.data();
+    m_end = m_current + read;
+
+    return read > 0;
+}
+
+int ItdParser::Peek()
+{
+    if (m_current == m_end && !Fill())
+        return -1;
+
+    return (unsigned char)*m_current;
+}
+
+ItdParser::Token ItdParser::NextToken()
+{
+    if (m_is_pushed_back) {
+        m_is_pushed_back = false;
+        return m_token;
+    }
+
+    for (;;) {
+        int c = Peek();
+
+        if (c == -1)
+            return m_token = TOKEN_END;
+
+        if (c == '\n') {
+            m_line++;
+            m_current++;
+        } else if (isspace(c)) {
+            m_current++;
+        } else if (c == '#') {
+            // Comments run to the end of the line
+            while ((c = Peek()) != -1 && c != '\n')
+                m_current++;
+        } else {
+            break;
+        }
+    }
+
+    char first = *m_current++;
+
+    if (first == '[')
+        return m_token = TOKEN_OPEN;
+    if (first == ']')
+        return m_token = TOKEN_CLOSE;
+
+    m_text.clear();
+
+    if (first == '"') {
+        int c;
+
+        while ((c = Peek()) != -1 && c != '"') {
+            const char *start = m_current;
+
+            while (m_current < m_end && *m_current != '"') {
+                if (*m_current == '\n')
+                    m_line++;
+                m_current++;
+            }
+            m_text.append(start, m_current);
+        }
+
+        if (c == -1) {
+            Fail("Unterminated string");
+            return m_token = TOKEN_END;
+        }
+
+        m_current++;
+        return m_token = TOKEN_STRING;
+    }
+
+    // A word runs until white space, a bracket, a quote or a comment
+    m_text.push_back(first);
+    while (Peek() != -1) {
+        const char *start = m_current;
+
+        while (m_current < m_end && !isspace((unsigned char)*m_current) &&
+               *m_current != '[' && *m_current != ']' && *m_current != '"' && *m_current != '#')
+            m_current++;
+        m_text.append(start, m_current);
+
+        // Stopped before the end of the buffer, so the word has ended
+        if (m_current < m_end)
+            break;
+    }
+
+    return m_token = TOKEN_WORD;
+}
+
+void ItdParser::PushBack()
+{
+    m_is_pushed_back = true;
+}
+
+bool ItdParser::Fail(const char *message)
+{
+    // Keep the first error, the ones after it are usually caused by it
+    if (m_error.empty())
+        m_error = "Line " + std::to_string(m_line) + ": " + message;
+
+    return false;
+}
+
+bool ItdParser::Expect(Token expected)
+{
+    static const char *names[] = {"'['", "']'", "a word", "a string", "end of file"};
+    Token token = NextToken();
+
+    if (token != expected) {
+        std::string message = std::string("Expected ") + names[expected];
+
+        return Fail(message.c_str());
+    }
+
+    return true;
+}
+
+bool ItdParser::ToNumber(double &number)
+{
+    const char *start = m_text.c_str(), *end = start + m_text.size();
+
+    // Neither parser takes a leading plus
+    if (*start == '+')
+        start++;
+
+#ifdef ITD_USE_FROM_CHARS
+    std::from_chars_result result = std::from_chars(start, end, number);
+
+    if (result.ec != std::errc() || result.ptr != end)
+        return Fail("Expected a number");
+#else
+    char *parsed_end;
+
+    number = strtod(start, &parsed_end);
+    if (parsed_end != end || start == end)
+        return Fail("Expected a number");
+#endif
+
+    return true;
+}
+
+bool ItdParser::ReadNumbers(double *numbers, int count)
+{
+    for (int i = 0; i < count; i++) {
+        if (!Expect(TOKEN_WORD) || !ToNumber(numbers[i]))
+            return false;
+    }
+
+    return true;
+}
+
+bool ItdParser::SkipBlock()
+{
+    int depth = 1;
+
+    while (depth > 0) {
+        switch (NextToken()) {
+        case TOKEN_OPEN:
+            depth++;
+            break;
+        case TOKEN_CLOSE:
+            depth--;
+            break;
+        case TOKEN_END:
+            return Fail("Unexpected end of file");
+        default:
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool ItdParser::ReadAttribute(std::string &attribute_name, std::string &value)
+{
+    attribute_name = m_text;
+    value.clear();
+
+    for (;;) {
+        Token token = NextToken();
+
+        if (token == TOKEN_CLOSE)
+            return true;
+
+        if (token == TOKEN_OPEN) {
+            // Nested values (lists of attributes) aren't kept
+            if (!SkipBlock())
+                return false;
+        } else if (token == TOKEN_END) {
+            return Fail("Unexpected end of file");
+        } else {
+            if (!value.empty())
+                value.push_back(' ');
+            value += m_text;
+        }
+    }
+}
+
+ItdParseResult ItdParser::ParsePolygon(ItdObject &object)
+{
+    ItdGeometryType type = isKeyword(m_text, "POLYLINE")    ? ITD_POLYLINES
+                           : isKeyword(m_text, "POINTLIST") ? ITD_POINT_LISTS
+                                                            : ITD_POLYGONS;
+    double plane[4] = {0, 0, 0, 0};
+    bool has_plane = false, has_count = false;
+
+    if (object.getPolygonsNr() == 0)
+        object.type = type;
+    else if (object.type != type) {
+        Fail("Object mixes polygons, polylines and point lists");
+        return ITD_SYNTAX_ERROR;
+    }
+
+    for (;;) {
+        Token token = NextToken();
+
+        if (token == TOKEN_CLOSE)
+            break;
+
+        /* The number of vertices, which follows the polygon's attributes. It
+         * isn't reserved for: reserving every polygon's exact size would stop the
+         * buffers from growing geometrically, and copy them on every polygon */
+        if (token == TOKEN_WORD && !has_count) {
+            double count;
+
+            if (!ToNumber(count))
+                return ITD_SYNTAX_ERROR;
+
+            has_count = true;
+            continue;
+        }
+
+        if (token != TOKEN_OPEN) {
+            Fail("Expected a vertex");
+            return ITD_SYNTAX_ERROR;
+        }
+
+        // The polygon's attributes
+        if (!has_count) {
+            if (!Expect(TOKEN_WORD))
+                return ITD_SYNTAX_ERROR;
+
+            if (isKeyword(m_text, "PLANE")) {
+                if (!ReadNumbers(plane, 4) || !Expect(TOKEN_CLOSE))
+                    return ITD_SYNTAX_ERROR;
+                has_plane = true;
+            } else if (!SkipBlock()) {
+                return ITD_SYNTAX_ERROR;
+            }
+
+            continue;
+        }
+
+        // A vertex - its attributes, then its coordinates
+        double normal[3] = {0, 0, 0}, coordinates[3];
+        bool has_normal = false;
+
+        while ((token = NextToken()) == TOKEN_OPEN) {
+            if (!Expect(TOKEN_WORD))
+                return ITD_SYNTAX_ERROR;
+
+            if (isKeyword(m_text, "NORMAL")) {
+                if (!ReadNumbers(normal, 3) || !Expect(TOKEN_CLOSE))
+                    return ITD_SYNTAX_ERROR;
+                has_normal = true;
+            } else if (!SkipBlock()) {
+                return ITD_SYNTAX_ERROR;
+            }
+        }
+        PushBack();
+
+        if (!ReadNumbers(coordinates, 3) || !Expect(TOKEN_CLOSE))
+            return ITD_SYNTAX_ERROR;
+
+        object.coordinates.insert(object.coordinates.end(), coordinates, coordinates + 3);
+        object.normals.insert(object.normals.end(), normal, normal + 3);
+        object.has_normal.push_back(has_normal);
+        m_vertices_nr++;
+    }
+
+    object.polygon_offsets.push_back(object.getVerticesNr());
+    object.planes.insert(object.planes.end(), plane, plane + 4);
+    object.has_plane.push_back(has_plane);
+    m_polygons_nr++;
+
+    return ITD_OK;
+}
+
+ItdParseResult ItdParser::ParseObject()
+{
+    int depth = m_depth++;
+    bool has_name = false;
+
+    if ((int)m_objects.size() <= depth)
+        m_objects.resize(depth + 1);
+    m_objects[depth].Clear();
+
+    // Nested objects may grow m_objects, so the object is always indexed
+    for (;;) {
+        Token token = NextToken();
+        ItdParseResult result = ITD_OK;
+
+        if (token == TOKEN_CLOSE)
+            break;
+
+        if (token == TOKEN_WORD || token == TOKEN_STRING) {
+            if (has_name) {
+                Fail("Unexpected word in object");
+                return ITD_SYNTAX_ERROR;
+            }
+
+            m_objects[depth].name = m_text;
+            has_name = true;
+            continue;
+        }
+
+        if (token != TOKEN_OPEN || !Expect(TOKEN_WORD)) {
+            Fail("Unterminated object");
+            return ITD_SYNTAX_ERROR;
+        }
+
+        if (isKeyword(m_text, "POLYGON") || isKeyword(m_text, "POLYLINE") ||
+            isKeyword(m_text, "POINTLIST")) {
+            result = ParsePolygon(m_objects[depth]);
+        } else if (isKeyword(m_text, "OBJECT")) {
+            result = ParseObject();
+        } else if (isUnsupportedKeyword(m_text)) {
+            Fail((m_text + " objects need the irit library").c_str());
+            result = ITD_UNSUPPORTED;
+        } else if (!has_name) {
+            // Attributes come before the object's name
+            std::pair<std::string, std::string> attribute;
+
+            if (!ReadAttribute(attribute.first, attribute.second))
+                return ITD_SYNTAX_ERROR;
+            m_objects[depth].attributes.push_back(attribute);
+        } else if (!SkipBlock()) {
+            // Numbers, vectors, matrices, strings...
+            return ITD_SYNTAX_ERROR;
+        }
+
+        if (result != ITD_OK)
+            return result;
+    }
+
+    m_depth--;
+
+    if (m_objects[depth].getPolygonsNr() > 0) {
+        m_objects_nr++;
+
+        if (!m_handler(m_objects[depth])) {
+            Fail("Stopped by the object handler");
+            return ITD_STOPPED;
+        }
+    }
+
+    return ITD_OK;
+}
+
+ItdParseResult ItdParser::Parse(const ObjectHandler &handler)
+{
+    m_handler = handler;
+    m_token = TOKEN_END;
+    m_is_pushed_back = false;
+    m_line = 1;
+    m_error.clear();
+    m_depth = 0;
+    m_objects_nr = 0;
+    m_polygons_nr = 0;
+    m_vertices_nr = 0;
+
+    for (;;) {
+        Token token = NextToken();
+
+        if (token == TOKEN_END)
+            return m_error.empty() ? ITD_OK : ITD_SYNTAX_ERROR;
+
+        if (token != TOKEN_OPEN) {
+            Fail("Expected '['");
+            return ITD_SYNTAX_ERROR;
+        }
+
+        if (!Expect(TOKEN_WORD))
+            return ITD_SYNTAX_ERROR;
+
+        if (isKeyword(m_text, "OBJECT")) {
+            ItdParseResult result = ParseObject();
+
+            if (result != ITD_OK)
+                return result;
+        } else if (isUnsupportedKeyword(m_text)) {
+            Fail((m_text + " objects need the irit library").c_str());
+            return ITD_UNSUPPORTED;
+        } else if (!SkipBlock()) {
+            return ITD_SYNTAX_ERROR;
+        }
+    }
+}
+
+ItdParseResult ItdParser::ParseFile(const char *file_name, const ObjectHandler &handler)
+{
+    ItdParseResult result;
+
+    m_file = fopen(file_name, "rb");
+    if (!m_file) {
+        m_error = std::string("Can't open ") + file_name;
+        return ITD_CANT_OPEN;
+    }
+
+    m_buffer.resize(ITD_BUFFER_SIZE);
+    m_current = m_end = m_buffer.data();
+    m_bytes_nr = 0;
+
+    result = Parse(handler);
+
+    fclose(m_file);
+    m_file = nullptr;
+
+    return result;
+}
+
+ItdParseResult ItdParser::ParseString(const char *text, size_t size, const ObjectHandler &handler)
+{
+    m_current = text;
+    m_end = text + size;
+    m_bytes_nr = (long long)size;
+
+    return Parse(handler);
+}
+
+const std::string &ItdParser::getError() const
+{
+    return m_error;
+}
+
+int ItdParser::getLine() const
+{
+    return m_line;
+}
+
+int ItdParser::getObjectsNr() const
+{
+    return m_objects_nr;
+}
+
+int ItdParser::getPolygonsNr() const
+{
+    return m_polygons_nr;
+}
+
+int ItdParser::getVerticesNr() const
+{
+    return m_vertices_nr;
+}
+
+long long ItdParser::getBytesNr() const
+{
+    return m_bytes_nr;
+}
@@ -0,0 +1,184 @@
+#ifndef __ITD_PARSER_H__
+#define __ITD_PARSER_H__
+
+/* Header file for the IRIT data file parser */
+
+#include <stdio.h>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Bytes read from the file at a time
+#define ITD_BUFFER_SIZE (64 * 1024)
+
+// What the polygons of an object are
+enum ItdGeometryType {
+    ITD_POLYGONS,
+    ITD_POLYLINES,
+    ITD_POINT_LISTS
+};
+
+enum ItdParseResult {
+    ITD_OK,
+    ITD_CANT_OPEN,
+    ITD_SYNTAX_ERROR,
+    ITD_UNSUPPORTED, // Freeform geometry or instances, which only irit can handle
+    ITD_STOPPED      // The object handler asked to stop
+};
+
+/* A polygonal object of an IRIT data file.
+ *
+ * The vertices of all the object's polygons are kept one after the other,
+ * polygon p is vertices [getPolygonsOffsets()[p], [p + 1]). Vertices are
+ * not shared between polygons, just like in the file.
+ */
+struct ItdObject
+{
+    std::string name;
+    ItdGeometryType type;
+
+    // The object's attributes in the order they appear, strings unquoted
+    std::vector<std::pair<std::string, std::string> > attributes;
+
+    std::vector<double> coordinates; // x, y, z of every vertex
+    std::vector<double> normals;     // x, y, z of every vertex, if it has one
+    std::vector<unsigned char> has_normal;
+
+    std::vector<int> polygon_offsets; // First vertex of every polygon, plus the end
+    std::vector<double> planes;       // a, b, c, d of every polygon, if it has one
+    std::vector<unsigned char> has_plane;
+
+    // Empties the object but keeps its memory, for the next object
+    void Clear();
+
+    int getVerticesNr() const;
+
+    int getPolygonsNr() const;
+
+    const int *getPolygonsOffsets() const;
+
+    // The value of an attribute (case insensitive), or null if there is none
+    const char *getAttribute(const char *attribute_name) const;
+};
+
+/* Streaming parser of the IRIT text data format (.itd / .dat).
+ *
+ * The file is read through a fixed size buffer and every polygonal object
+ * is handed over as soon as its closing bracket is read, so the memory
+ * used doesn't depend on the size of the file but on its biggest object.
+ * The same ItdObject is reused for all the objects of a file.
+ *
+ * Polygons, polylines and point lists are parsed, with the PLANE of
+ * polygons, the NORMAL of vertices and the attributes of objects. Other
+ * attributes and non geometric objects (numbers, vectors, matrices,
+ * strings) are skipped. Freeform objects and instances stop the parse
+ * with ITD_UNSUPPORTED, since tessellating them needs the irit library.
+ */
+class ItdParser
+{
+public:
+    /* Called with every polygonal object of the file, in the order their
+     * definition ends (nested objects before the list that holds them).
+     * Returning false stops the parse.
+     */
+    typedef std::function<bool(const ItdObject &)> ObjectHandler;
+
+private:
+    enum Token {
+        TOKEN_OPEN,
+        TOKEN_CLOSE,
+        TOKEN_WORD,
+        TOKEN_STRING,
+        TOKEN_END
+    };
+
+    // Input, either a file read into m_buffer or a string
+    FILE *m_file;
+    std::vector<char> m_buffer;
+    const char *m_current;
+    const char *m_end;
+
+    // The last token read, and one token of look ahead
+    Token m_token;
+    std::string m_text;
+    bool m_is_pushed_back;
+
+    int m_line;
+    std::string m_error;
+
+    // Objects which are being defined, one per nesting level
+    std::vector<ItdObject> m_objects;
+    int m_depth;
+
+    // Statistics of the last parse
+    int m_objects_nr;
+    int m_polygons_nr;
+    int m_vertices_nr;
+    long long m_bytes_nr;
+
+    ObjectHandler m_handler;
+
+    // Returns the next character without consuming it, or -1 at the end
+    int Peek();
+
+    // Refills the buffer, returns false at the end of the input
+    bool Fill();
+
+    Token NextToken();
+
+    void PushBack();
+
+    // Reads the next token and fails unless it's @expected
+    bool Expect(Token expected);
+
+    // Parses a number from the last word token
+    bool ToNumber(double &number);
+
+    bool ReadNumbers(double *numbers, int count);
+
+    bool Fail(const char *message);
+
+    // Skips to the bracket which closes the one that was just opened
+    bool SkipBlock();
+
+    /* Reads an attribute whose name was the last token. Its name and value
+     * are returned in @attribute_name and @value */
+    bool ReadAttribute(std::string &attribute_name, std::string &value);
+
+    ItdParseResult ParseObject();
+
+    // Parses a polygon, polyline or point list, after its keyword
+    ItdParseResult ParsePolygon(ItdObject &object);
+
+    ItdParseResult Parse(const ObjectHandler &handler);
+
+public:
+    ItdParser();
+
+    ~ItdParser();
+
+    ItdParser(const ItdParser &) = delete;
+    ItdParser &operator=(const ItdParser &) = delete;
+
+    ItdParseResult ParseFile(const char *file_name, const ObjectHandler &handler);
+
+    // Parses @size bytes of @text, mainly for tests
+    ItdParseResult ParseString(const char *text, size_t size, const ObjectHandler &handler);
+
+    // Describes why the last parse didn't return ITD_OK
+    const std::string &getError() const;
+
+    // The line the last parse stopped at
+    int getLine() const;
+
+    int getObjectsNr() const;
+
+    int getPolygonsNr() const;
+
+    int getVerticesNr() const;
+
+    long long getBytesNr() const;
+};
+
+#endif // __ITD_PARSER_H__
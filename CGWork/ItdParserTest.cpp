@@ -0,0 +1,233 @@
+/** Testing the IRIT data file parser **/
+
+#include <chrono>
+#include <iostream>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "ItdParser.h"
+
+using namespace std;
+
+#define BIG_FILE_NAME "ItdParserTest.itd"
+#define BIG_OBJECTS_NR 200
+#define BIG_POLYGONS_PER_OBJECT 2000
+
+static const char SAMPLE[] =
+    "# A comment [with brackets]\n"
+    "[OBJECT VIEW_MAT\n"
+    "    [MATRIX\n"
+    "        1 0 0 0\n"
+    "        0 1 0 0\n"
+    "        0 0 1 0\n"
+    "        0 0 0 1\n"
+    "    ]\n"
+    "]\n"
+    "[OBJECT SCENE\n"
+    "    [OBJECT [COLOR 4] [RGB \"255,128,0\"] [flag] SQUARE\n"
+    "        [POLYGON [PLANE 0 0 1 -0.5] [ptexture \"wood\"] 4\n"
+    "            [[NORMAL 0 0 1] 0 0 0.5]\n"
+    "            [[uvvals \"0,1\"] [NORMAL 0 0 1] 1 0 +0.5]\n"
+    "            [1 1 5e-1]\n"
+    "            [0 1 .5] # after a vertex\n"
+    "        ]\n"
+    "        [POLYGON 3\n"
+    "            [0 0 0]\n"
+    "            [-1 0 0]\n"
+    "            [0 -1.25E+1 0]\n"
+    "        ]\n"
+    "    ]\n"
+    "    [OBJECT LINE\n"
+    "        [POLYLINE 2\n"
+    "            [0 0 0]\n"
+    "            [1 2 3]\n"
+    "        ]\n"
+    "    ]\n"
+    "    [OBJECT RADIUS [NUMBER 2.5]]\n"
+    "]\n"
+    "[OBJECT [transp 0.5] POINTS\n"
+    "    [POINTLIST 1\n"
+    "        [7 8 9]\n"
+    "    ]\n"
+    "]\n";
+
+static bool near(double a, double b)
+{
+    return fabs(a - b) < 1e-12;
+}
+
+static bool checkSample()
+{
+    ItdParser parser;
+    vector<string> names;
+    bool passed = true;
+
+    ItdParseResult result =
+        parser.ParseString(SAMPLE, strlen(SAMPLE), [&](const ItdObject &object) {
+            names.push_back(object.name);
+
+            if (object.name == "SQUARE") {
+                const double *c = object.coordinates.data();
+
+                passed &= object.type == ITD_POLYGONS && object.getPolygonsNr() == 2 &&
+                          object.getVerticesNr() == 7;
+                passed &= object.getPolygonsOffsets()[1] == 4 && object.getPolygonsOffsets()[2] == 7;
+                passed &= object.getAttribute("color") && string(object.getAttribute("color")) == "4";
+                passed &= object.getAttribute("RGB") &&
+                          string(object.getAttribute("RGB")) == "255,128,0";
+                passed &= object.getAttribute("flag") && !*object.getAttribute("flag");
+                passed &= !object.getAttribute("transp");
+                passed &= object.has_plane[0] && !object.has_plane[1] && near(object.planes[2], 1) &&
+                          near(object.planes[3], -0.5);
+                passed &= object.has_normal[0] && object.has_normal[1] && !object.has_normal[2] &&
+                          near(object.normals[5], 1);
+                passed &= near(c[3], 1) && near(c[5], 0.5) && near(c[8], 0.5) &&
+                          near(c[11], 0.5) && near(c[19], -12.5);
+            } else if (object.name == "LINE") {
+                passed &= object.type == ITD_POLYLINES && object.getVerticesNr() == 2 &&
+                          near(object.coordinates[5], 3);
+            } else if (object.name == "POINTS") {
+                passed &= object.type == ITD_POINT_LISTS && object.getVerticesNr() == 1 &&
+                          near(object.coordinates[0], 7);
+                passed &= object.getAttribute("TRANSP") &&
+                          string(object.getAttribute("TRANSP")) == "0.5";
+            }
+
+            return true;
+        });
+
+    passed &= result == ITD_OK;
+    passed &= names.size() == 3 && names[0] == "SQUARE" && names[1] == "LINE" &&
+              names[2] == "POINTS";
+    passed &= parser.getPolygonsNr() == 4 && parser.getVerticesNr() == 10;
+
+    if (result != ITD_OK)
+        cout << "  " << parser.getError() << endl;
+
+    return passed;
+}
+
+static bool checkErrors()
+{
+    ItdParser parser;
+    bool passed = true;
+    auto ignore = [](const ItdObject &) { return true; };
+
+    const char freeform[] = "[OBJECT A [POLYGON 1 [0 0 0]]]\n"
+                            "[OBJECT B [SURFACE BEZIER 2 2 E3 [0 0 0] [1 0 0] [0 1 0] [1 1 0]]]\n";
+    passed &= parser.ParseString(freeform, strlen(freeform), ignore) == ITD_UNSUPPORTED;
+    passed &= parser.getObjectsNr() == 1 && parser.getLine() == 2;
+
+    const char bad_number[] = "[OBJECT A\n[POLYGON 1\n[0 0 zero]]]\n";
+    passed &= parser.ParseString(bad_number, strlen(bad_number), ignore) == ITD_SYNTAX_ERROR;
+    passed &= parser.getError().find("Line 3") == 0;
+
+    const char unterminated[] = "[OBJECT A [POLYGON 1 [0 0 0]]";
+    passed &= parser.ParseString(unterminated, strlen(unterminated), ignore) == ITD_SYNTAX_ERROR;
+
+    const char stop[] = "[OBJECT A [POLYGON 1 [0 0 0]]] [OBJECT B [POLYGON 1 [0 0 0]]]";
+    passed &= parser.ParseString(stop, strlen(stop), [](const ItdObject &) { return false; }) ==
+              ITD_STOPPED;
+    passed &= parser.getObjectsNr() == 1;
+
+    passed &= parser.ParseFile("no such file.itd", ignore) == ITD_CANT_OPEN;
+
+    return passed;
+}
+
+// Many objects of quads, with normals, written the way irit writes them
+static string bigFileText()
+{
+    string text;
+    char line[128];
+
+    for (int object = 0; object < BIG_OBJECTS_NR; object++) {
+        snprintf(line, sizeof(line), "[OBJECT [RGB \"%d,0,0\"] OBJ%d\n", object % 256, object);
+        text += line;
+
+        for (int polygon = 0; polygon < BIG_POLYGONS_PER_OBJECT; polygon++) {
+            double x = polygon * 0.001, y = object * 0.01;
+
+            text += "    [POLYGON [PLANE 0 0 1 0] 4\n";
+            for (int i = 0; i < 4; i++) {
+                snprintf(line, sizeof(line), "        [[NORMAL 0 0 1] %.10g %.10g %.10g]\n",
+                         x + (i == 1 || i == 2) * 0.001, y + (i >= 2) * 0.01,
+                         sin(x * 3.7) * cos(y * 1.3));
+                text += line;
+            }
+            text += "    ]\n";
+        }
+
+        text += "]\n";
+    }
+
+    return text;
+}
+
+static double checksum(const ItdObject &object)
+{
+    double sum = 0;
+
+    for (double coordinate : object.coordinates)
+        sum += coordinate;
+
+    return sum;
+}
+
+int main()
+{
+    bool passed = true;
+
+    bool sample = checkSample();
+    cout << "Sample file: " << (sample ? "passed" : "FAILED") << endl;
+    passed &= sample;
+
+    bool errors = checkErrors();
+    cout << "Errors: " << (errors ? "passed" : "FAILED") << endl;
+    passed &= errors;
+
+    // The file is read through a small buffer, so tokens are split between reads
+    string text = bigFileText();
+    FILE *file = fopen(BIG_FILE_NAME, "wb");
+    fwrite(text.data(), 1, text.size(), file);
+    fclose(file);
+
+    ItdParser parser;
+    double file_sum = 0, string_sum = 0;
+    size_t biggest_object = 0;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    ItdParseResult result = parser.ParseFile(BIG_FILE_NAME, [&](const ItdObject &object) {
+        file_sum += checksum(object);
+        biggest_object = max(biggest_object, object.coordinates.capacity() * sizeof(double));
+        return true;
+    });
+    double milliseconds =
+        chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    remove(BIG_FILE_NAME);
+
+    parser.ParseString(text.data(), text.size(), [&](const ItdObject &object) {
+        string_sum += checksum(object);
+        return true;
+    });
+
+    bool streamed = result == ITD_OK && file_sum == string_sum &&
+                    parser.getObjectsNr() == BIG_OBJECTS_NR &&
+                    parser.getVerticesNr() == 4 * BIG_OBJECTS_NR * BIG_POLYGONS_PER_OBJECT;
+
+    cout << endl
+         << parser.getBytesNr() / (1024 * 1024) << " MB, " << parser.getVerticesNr()
+         << " vertices parsed in " << milliseconds << " ms ("
+         << parser.getBytesNr() / (1024.0 * 1024.0) / (milliseconds / 1000) << " MB/s)" << endl;
+    cout << "Biggest object's coordinates: " << biggest_object / 1024 << " KB" << endl;
+    cout << "File same as string: " << (streamed ? "passed" : "FAILED") << endl;
+    passed &= streamed;
+
+    cout << endl
+         << (passed ? "All tests passed" : "Some tests FAILED") << endl;
+
+    return passed ? 0 : 1;
+}
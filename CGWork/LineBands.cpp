@@ -0,0 +1,88 @@
+/* Implementation of the LineBands class */
+
+#include "LineBands.h"
+#include <math.h>
+
+LineBands::LineBands(int workers_nr) : m_pool(workers_nr)
+{
+}
+
+void LineBands::GetBands(const Line &line, int band_rows, int bands_nr, int &first_band, int &last_band)
+{
+    // Line ends are in the guard band, so their rows fit in an int
+    int first_row = (int)floor(min(line.first_y, line.second_y)),
+        last_row = (int)floor(max(line.first_y, line.second_y));
+
+    first_band = min(max(first_row, 0) / band_rows, bands_nr - 1);
+    last_band = min(max(last_row, 0) / band_rows, bands_nr - 1);
+}
+
+void LineBands::Add(RGBQUAD color, const Vector &first, const Vector &second)
+{
+    Line line = {first[0], first[1], second[0], second[1], color};
+
+    m_lines.push_back(line);
+}
+
+void LineBands::Finish(int *bits, int width, int height)
+{
+    int lines_nr = (int)m_lines.size();
+
+    if (m_pool.getWorkersNr() == 1 || lines_nr < LINE_BANDS_MIN_LINES) {
+        for (const Line &line : m_lines)
+            lineDraw(bits, width, height, line.color, Vector(line.first_x, line.first_y, 0, 1),
+                     Vector(line.second_x, line.second_y, 0, 1));
+        m_lines.clear();
+        return;
+    }
+
+    int bands_nr = min(height, m_pool.getWorkersNr() * LINE_BANDS_PER_WORKER);
+    int band_rows = (height + bands_nr - 1) / bands_nr;
+    int first_band, last_band;
+
+    // Rounding the rows up may leave the last bands empty
+    bands_nr = (height + band_rows - 1) / band_rows;
+
+    // Count the lines of every band, into the start of the band after it
+    m_band_starts.assign(bands_nr + 1, 0);
+    for (const Line &line : m_lines) {
+        GetBands(line, band_rows, bands_nr, first_band, last_band);
+        for (int band = first_band; band <= last_band; band++)
+            m_band_starts[band + 1]++;
+    }
+
+    for (int band = 0; band < bands_nr; band++)
+        m_band_starts[band + 1] += m_band_starts[band];
+
+    /* List the lines in order. Each band's start is moved forward past the
+     * lines listed in it, so it ends up at the start of the next band, and
+     * the starts are moved back once all the lines are listed */
+    m_band_lines.resize(m_band_starts[bands_nr]);
+    for (int i = 0; i < lines_nr; i++) {
+        GetBands(m_lines[i], band_rows, bands_nr, first_band, last_band);
+        for (int band = first_band; band <= last_band; band++)
+            m_band_lines[m_band_starts[band]++] = i;
+    }
+
+    for (int band = bands_nr; band > 0; band--)
+        m_band_starts[band] = m_band_starts[band - 1];
+    m_band_starts[0] = 0;
+
+    m_pool.Run(bands_nr, [&](int band, int) {
+        int first_row = band * band_rows, last_row = min(height, first_row + band_rows);
+
+        for (int i = m_band_starts[band]; i < m_band_starts[band + 1]; i++) {
+            const Line &line = m_lines[m_band_lines[i]];
+
+            lineDraw(bits, width, height, line.color, Vector(line.first_x, line.first_y, 0, 1),
+                     Vector(line.second_x, line.second_y, 0, 1), first_row, last_row);
+        }
+    });
+
+    m_lines.clear();
+}
+
+int LineBands::getWorkersNr() const
+{
+    return m_pool.getWorkersNr();
+}
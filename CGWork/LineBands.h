@@ -0,0 +1,66 @@
+#ifndef __LINE_BANDS_H__
+#define __LINE_BANDS_H__
+
+/* Header file for the band parallel line rasterizer */
+
+#include <vector>
+#include "IritObjects.h"
+#include "WorkStealingPool.h"
+
+// Bands per worker, so workers which get the busy parts of the screen are helped by the rest
+#define LINE_BANDS_PER_WORKER 4
+// Frames with fewer lines are drawn on the calling thread, since waking the workers costs more
+#define LINE_BANDS_MIN_LINES 4096
+
+/* Draws the lines of a frame on all cores.
+ *
+ * Lines are added after they're clipped and divided, and only drawn by
+ * Finish(). The bitmap is split into horizontal bands of rows, and every
+ * line is listed in each band its rows cross, in the order it was added.
+ * Each band is then drawn by one of the pool's workers, which draws only
+ * the rows of its band of every line listed in it. Bands don't share rows,
+ * so the workers write to the bitmap without locks, and since the lines of
+ * a band are drawn in order, a pixel which several lines cross ends up the
+ * color of the last one, as if the frame was drawn on a single thread.
+ */
+class LineBands
+{
+    // A line's ends, in screen coordinates
+    struct Line
+    {
+        double first_x;
+        double first_y;
+        double second_x;
+        double second_y;
+        RGBQUAD color;
+    };
+
+    WorkStealingPool m_pool;
+    std::vector<Line> m_lines;
+
+    // The lines of band i are m_band_lines[m_band_starts[i], m_band_starts[i + 1])
+    std::vector<int> m_band_starts;
+    std::vector<int> m_band_lines;
+
+    // The bands line @line crosses, [first_band, last_band]
+    static void GetBands(const Line &line, int band_rows, int bands_nr, int &first_band, int &last_band);
+
+public:
+    /* Creates a rasterizer with a pool of @workers_nr workers, 0 for one
+     * per hardware thread */
+    explicit LineBands(int workers_nr = 0);
+
+    LineBands(const LineBands &) = delete;
+    LineBands &operator=(const LineBands &) = delete;
+
+    // Adds a line between @first and @second, which are in screen coordinates, to the frame
+    void Add(RGBQUAD color, const Vector &first, const Vector &second);
+
+    /* Draws all the lines which were added since the last call to the
+     * bitmap, and removes them */
+    void Finish(int *bits, int width, int height);
+
+    int getWorkersNr() const;
+};
+
+#endif // __LINE_BANDS_H__
@@ -0,0 +1,112 @@
+/** Testing the band parallel line rasterizer **/
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string.h>
+#include <vector>
+#include "LineBands.h"
+
+using namespace std;
+
+#define WORKERS_NR 4
+// A 4K screen
+#define TEST_WIDTH 3840
+#define TEST_HEIGHT 2160
+#define FEW_LINES_NR 100
+#define MANY_LINES_NR 1000000
+// Lines end up to this many pixels off the bitmap, so some of them cross it and some miss it
+#define OFF_SCREEN_MARGIN 200
+// Every this many lines, one crosses much of the bitmap and so many bands
+#define LONG_LINE_EVERY 16
+
+typedef chrono::steady_clock Clock;
+
+static double millisecondsSince(Clock::time_point start)
+{
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+// Random lines of random colors, most of them short, the way the edges of a mesh are
+static void randomLines(int lines_nr, vector<Vector> &ends, vector<RGBQUAD> &colors)
+{
+    mt19937 random(lines_nr);
+    uniform_real_distribution<double> x(-OFF_SCREEN_MARGIN, TEST_WIDTH + OFF_SCREEN_MARGIN),
+        y(-OFF_SCREEN_MARGIN, TEST_HEIGHT + OFF_SCREEN_MARGIN), offset(-20, 20);
+    uniform_int_distribution<int> channel(0, 255);
+
+    ends.clear();
+    colors.clear();
+
+    for (int i = 0; i < lines_nr; i++) {
+        Vector first(x(random), y(random), 0, 1);
+        Vector second = (i % LONG_LINE_EVERY)
+                            ? Vector(first[0] + offset(random), first[1] + offset(random), 0, 1)
+                            : Vector(x(random), y(random), 0, 1);
+        RGBQUAD color = {(BYTE)channel(random), (BYTE)channel(random), (BYTE)channel(random), 0};
+
+        ends.push_back(first);
+        ends.push_back(second);
+        colors.push_back(color);
+    }
+}
+
+/* Draws the lines one after the other and through the bands, and returns
+ * whether both drew the same pixels */
+static bool drawBoth(LineBands &bands, int lines_nr, double &serial_ms, double &bands_ms)
+{
+    vector<int> serial(TEST_WIDTH * TEST_HEIGHT), banded(TEST_WIDTH * TEST_HEIGHT);
+    vector<Vector> ends;
+    vector<RGBQUAD> colors;
+
+    randomLines(lines_nr, ends, colors);
+
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < lines_nr; i++)
+        lineDraw(serial.data(), TEST_WIDTH, TEST_HEIGHT, colors[i], ends[2 * i], ends[2 * i + 1]);
+    serial_ms = millisecondsSince(start);
+
+    start = Clock::now();
+    for (int i = 0; i < lines_nr; i++)
+        bands.Add(colors[i], ends[2 * i], ends[2 * i + 1]);
+    bands.Finish(banded.data(), TEST_WIDTH, TEST_HEIGHT);
+    bands_ms = millisecondsSince(start);
+
+    return serial == banded;
+}
+
+int main()
+{
+    bool passed = true;
+    double serial_ms, bands_ms;
+
+    LineBands bands(WORKERS_NR);
+
+    bool few_same = drawBoth(bands, FEW_LINES_NR, serial_ms, bands_ms);
+    cout << "A few lines are drawn as they are drawn one by one: " << (few_same ? "passed" : "FAILED") << endl;
+    passed &= few_same;
+
+    // Lines which cross each other have to end up the color of the last one in every band
+    bool many_same = drawBoth(bands, MANY_LINES_NR, serial_ms, bands_ms);
+    cout << "Many lines are drawn as they are drawn one by one: " << (many_same ? "passed" : "FAILED") << endl;
+    passed &= many_same;
+
+    // Finish() removes the lines it drew
+    vector<int> bitmap(TEST_WIDTH * TEST_HEIGHT);
+    bands.Finish(bitmap.data(), TEST_WIDTH, TEST_HEIGHT);
+
+    bool is_empty = true;
+    for (int pixel : bitmap)
+        is_empty &= pixel == 0;
+
+    cout << "Lines are drawn only once: " << (is_empty ? "passed" : "FAILED") << endl;
+    passed &= is_empty;
+
+    cout << endl
+         << MANY_LINES_NR << " lines on " << TEST_WIDTH << "x" << TEST_HEIGHT << " took " << serial_ms
+         << " ms one by one and " << bands_ms << " ms on " << WORKERS_NR << " workers" << endl
+         << endl
+         << (passed ? "All tests passed" : "Some tests FAILED") << endl;
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+/* Benchmarking lineDraw on zoomed in wireframes.
+ *
+ * Draws the edges of a wireframe grid which covers the screen at zoom 1,
+ * so the more it's zoomed in, the more of its edges are off the screen.
+ * lineDraw clips every edge before it's rasterized, and is compared with
+ * the same Bresenham lines walked pixel by pixel with a bounds test, the way
+ * the octant routines it replaced did. Both have to draw the same pixels.
+ * Link with IritObjects.cpp, LineBands.cpp, WorkStealingPool.cpp,
+ * MappedFile.cpp, Matrix.cpp, Quaternion.cpp and Arena.cpp.
+ */
+
+#include "IritObjects.h"
+#include <chrono>
+#include <iostream>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+using namespace std;
+
+#define BENCH_WIDTH 1920
+#define BENCH_HEIGHT 1080
+// Cells along every side of the grid, whose cells have their diagonals too
+#define BENCH_GRID_SIZE 300
+#define BENCH_MAX_ZOOM 256
+#define BENCH_ROUNDS 5
+
+typedef chrono::high_resolution_clock Clock;
+
+static double millisecondsSince(Clock::time_point start)
+{
+	return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+// Bresenham between the pixels of first and second, testing every pixel against the bitmap
+static void lineDrawTested(int *bits, int width, int height, RGBQUAD color, Vector first, Vector second)
+{
+	long long x = (long long)floor(first[0]), y = (long long)floor(first[1]),
+			  end_x = (long long)floor(second[0]), end_y = (long long)floor(second[1]);
+	long long delta_x = llabs(end_x - x), delta_y = llabs(end_y - y);
+	int step_x = (end_x >= x) ? 1 : -1, step_y = (end_y >= y) ? 1 : -1;
+	bool is_x_major = delta_x >= delta_y;
+	long long major_delta = is_x_major ? delta_x : delta_y, minor_delta = is_x_major ? delta_y : delta_x;
+	long long error = 2 * minor_delta - major_delta;
+
+	for (long long i = 0; i < major_delta; i++) {
+		if ((x >= 0) && (x < width) && (y >= 0) && (y < height))
+			bits[y * width + x] = *((int*)&color);
+
+		if (error > 0) {
+			if (is_x_major)
+				y += step_y;
+			else
+				x += step_x;
+			error -= 2 * major_delta;
+		}
+		error += 2 * minor_delta;
+
+		if (is_x_major)
+			x += step_x;
+		else
+			y += step_y;
+	}
+}
+
+// The edges of the grid, centered on the screen and scaled by zoom
+static void buildEdges(double zoom, vector<Vector> &ends)
+{
+	double cell_width = zoom * BENCH_WIDTH / BENCH_GRID_SIZE, cell_height = zoom * BENCH_HEIGHT / BENCH_GRID_SIZE;
+	double left = BENCH_WIDTH / 2 - zoom * BENCH_WIDTH / 2, top = BENCH_HEIGHT / 2 - zoom * BENCH_HEIGHT / 2;
+
+	ends.clear();
+	for (int row = 0; row < BENCH_GRID_SIZE; row++) {
+		for (int column = 0; column < BENCH_GRID_SIZE; column++) {
+			Vector corner(left + column * cell_width, top + row * cell_height, 0, 1),
+				   right(corner[0] + cell_width, corner[1], 0, 1),
+				   bottom(corner[0], corner[1] + cell_height, 0, 1);
+
+			ends.push_back(corner);
+			ends.push_back(right);
+			ends.push_back(corner);
+			ends.push_back(bottom);
+			ends.push_back(right);
+			ends.push_back(bottom);
+		}
+	}
+}
+
+typedef void (*LineDrawFunction)(int *bits, int width, int height, RGBQUAD color, Vector first, Vector second);
+
+static double benchDraw(LineDrawFunction draw, const vector<Vector> &ends, int *bits)
+{
+	RGBQUAD color = WIRE_DEFAULT_COLOR;
+	Clock::time_point start = Clock::now();
+
+	for (int round = 0; round < BENCH_ROUNDS; round++) {
+		for (size_t i = 0; i + 1 < ends.size(); i += 2)
+			draw(bits, BENCH_WIDTH, BENCH_HEIGHT, color, ends[i], ends[i + 1]);
+	}
+
+	return millisecondsSince(start) / BENCH_ROUNDS;
+}
+
+int main()
+{
+	vector<int> clipped(BENCH_WIDTH * BENCH_HEIGHT), tested(BENCH_WIDTH * BENCH_HEIGHT);
+	vector<Vector> ends;
+	bool passed = true;
+
+	cout << BENCH_GRID_SIZE * BENCH_GRID_SIZE * 3 << " edges on " << BENCH_WIDTH << "x" << BENCH_HEIGHT
+		 << ", milliseconds per frame" << endl
+		 << endl
+		 << "zoom\tclipped\ttested\tspeedup" << endl;
+
+	for (int zoom = 1; zoom <= BENCH_MAX_ZOOM; zoom *= 4) {
+		buildEdges(zoom, ends);
+		memset(clipped.data(), 0, clipped.size() * sizeof(int));
+		memset(tested.data(), 0, tested.size() * sizeof(int));
+
+		double clipped_ms = benchDraw(lineDraw, ends, clipped.data());
+		double tested_ms = benchDraw(lineDrawTested, ends, tested.data());
+
+		passed &= clipped == tested;
+		cout << zoom << "\t" << clipped_ms << "\t" << tested_ms << "\t" << tested_ms / clipped_ms << endl;
+	}
+
+	cout << endl << "Same pixels: " << (passed ? "passed" : "FAILED") << endl;
+
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,150 @@
+/* Benchmarking building a scene, the way the loader does it.
+ *
+ * Builds synthetic worlds of 10^3 to 10^6 quads through the IritObjects
+ * interface and reports the time per polygon, which should stay about the
+ * same as the scene grows, along with the number of heap allocations and
+ * the peak memory use of the process. Link with IritObjects.cpp,
+ * LineBands.cpp, WorkStealingPool.cpp, Matrix.cpp, Quaternion.cpp and
+ * Arena.cpp.
+ */
+
+#include "IritObjects.h"
+#include <chrono>
+#include <iostream>
+#include <new>
+#include <stdlib.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+
+#define BENCH_MIN_POLYGONS_NR 1000
+#define BENCH_MAX_POLYGONS_NR 1000000
+// Small objects, so that big scenes have many of them as well
+#define BENCH_POLYGONS_PER_OBJECT 10
+#define BENCH_OBJECTS_PER_FIGURE 1000
+#define BENCH_POINTS_PER_POLYGON 4
+
+typedef chrono::high_resolution_clock Clock;
+
+// Every heap allocation of the program goes through here
+static size_t heap_allocations_nr;
+
+void *operator new(size_t size)
+{
+	void *pointer = malloc(size ? size : 1);
+	if (!pointer)
+		throw bad_alloc();
+
+	heap_allocations_nr++;
+	return pointer;
+}
+
+void operator delete(void *pointer) noexcept
+{
+	free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+	free(pointer);
+}
+
+// Peak resident memory of the process so far, in megabytes
+static double peakMemoryMB()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+	return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss / 1024.0; // In kilobytes on Linux
+#endif
+}
+
+static double millisecondsSince(Clock::time_point start)
+{
+	return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+// Adds @polygons_nr quads to @world, returns the number of points added
+static int buildScene(IritWorld &world, int polygons_nr)
+{
+	IritFigure *figure = nullptr;
+	IritObject *object = nullptr;
+	int points_nr = 0;
+
+	for (int i = 0; i < polygons_nr; i++) {
+		if (i % (BENCH_POLYGONS_PER_OBJECT * BENCH_OBJECTS_PER_FIGURE) == 0)
+			figure = world.createFigure();
+		if (i % BENCH_POLYGONS_PER_OBJECT == 0) {
+			// The loader knows how many vertices an object has beforehand too
+			object = figure->createObject();
+			object->reserveVertices(BENCH_POLYGONS_PER_OBJECT * BENCH_POINTS_PER_POLYGON);
+		}
+
+		IritPolygon *polygon = object->createPolygon();
+		double z = i * 0.001;
+
+		for (int j = 0; j < BENCH_POINTS_PER_POLYGON; j++) {
+			double x = (j == 1 || j == 2) ? 1 : 0,
+				y = (j >= 2) ? 1 : 0,
+				normal_x = 0,
+				normal_y = 0,
+				normal_z = 1;
+
+			polygon->addPoint(x, y, z, normal_x, normal_y, normal_z);
+			points_nr++;
+		}
+	}
+
+	return points_nr;
+}
+
+int main()
+{
+	cout << "Building scenes of " << BENCH_POINTS_PER_POLYGON << " point polygons, "
+		 << BENCH_POLYGONS_PER_OBJECT << " polygons per object" << endl
+		 << endl;
+
+	for (int polygons_nr = BENCH_MIN_POLYGONS_NR; polygons_nr <= BENCH_MAX_POLYGONS_NR;
+		 polygons_nr *= 10) {
+		double build_time, destroy_time;
+		int points_nr;
+		size_t allocations_nr, arena_bytes = 0;
+
+		heap_allocations_nr = 0;
+		Clock::time_point start = Clock::now();
+		IritWorld *world = new IritWorld();
+		points_nr = buildScene(*world, polygons_nr);
+		build_time = millisecondsSince(start);
+		allocations_nr = heap_allocations_nr;
+
+		for (int i = 0; i < world->getFiguresNr(); i++)
+			arena_bytes += world->getFigure(i).getArena().getBytesReserved();
+
+		start = Clock::now();
+		delete world;
+		destroy_time = millisecondsSince(start);
+
+		cout << polygons_nr << " polygons (" << points_nr << " points) - " << endl;
+		cout << "Build:   " << build_time << " ms, "
+			 << build_time * 1e6 / polygons_nr << " ns per polygon" << endl;
+		cout << "Destroy: " << destroy_time << " ms" << endl;
+		cout << "Heap allocations: " << allocations_nr << " ("
+			 << (double)allocations_nr / polygons_nr << " per polygon)" << endl;
+		cout << "Arena memory:     " << arena_bytes / (1024.0 * 1024.0) << " MB" << endl;
+		cout << "Peak memory:      " << peakMemoryMB() << " MB" << endl
+			 << endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,150 @@
+/* Implementation of the LoadProfile class */
+
+#include "LoadProfile.h"
+#include <fstream>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+void LoadProfile::AddFigure(const LoadFigureRecord &figure)
+{
+    m_figures.push_back(figure);
+}
+
+const std::vector<LoadFigureRecord> &LoadProfile::getFigures() const
+{
+    return m_figures;
+}
+
+std::string LoadProfile::Quote(const std::string &text, bool is_json)
+{
+    std::string quoted = "\"";
+
+    for (char c : text) {
+        if (!is_json) {
+            // CSV only escapes quotes, by doubling them
+            if (c == '"')
+                quoted += '"';
+            quoted += c;
+        } else if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if ((unsigned char)c < 0x20) {
+            char escape[8];
+
+            snprintf(escape, sizeof(escape), "\\u%04x", (unsigned char)c);
+            quoted += escape;
+        } else {
+            quoted += c;
+        }
+    }
+
+    return quoted + "\"";
+}
+
+void LoadProfile::WriteJson(std::ostream &stream) const
+{
+    stream << "[";
+
+    for (size_t f = 0; f < m_figures.size(); f++) {
+        const LoadFigureRecord &figure = m_figures[f];
+
+        stream << (f ? "," : "") << "\n  {\"file\": " << Quote(figure.file_name, true)
+               << ", \"loaded_by\": " << Quote(figure.loaded_by, true)
+               << ", \"succeeded\": " << (figure.succeeded ? "true" : "false")
+               << ", \"wall_us\": " << figure.wall_us << ", \"bytes_reserved\": " << figure.bytes_reserved
+               << ", \"peak_rss_bytes\": " << figure.peak_rss_bytes << ",\n   \"stages\": [";
+
+        for (size_t s = 0; s < figure.stages.size(); s++) {
+            const LoadStageRecord &stage = figure.stages[s];
+
+            stream << (s ? "," : "") << "\n    {\"name\": " << Quote(stage.name, true)
+                   << ", \"objects\": " << stage.objects_nr << ", \"vertices\": " << stage.vertices_nr
+                   << ", \"wall_us\": " << stage.wall_us << ", \"allocations\": " << stage.allocations_nr
+                   << ", \"bytes_allocated\": " << stage.bytes_allocated << "}";
+        }
+
+        stream << "],\n   \"objects\": [";
+
+        for (size_t o = 0; o < figure.objects.size(); o++) {
+            const LoadObjectRecord &object = figure.objects[o];
+
+            stream << (o ? "," : "") << "\n    {\"object\": " << object.object
+                   << ", \"polygons\": " << object.polygons_nr << ", \"vertices\": " << object.vertices_nr
+                   << ", \"wall_us\": " << object.wall_us << ", \"allocations\": " << object.allocations_nr
+                   << ", \"bytes_allocated\": " << object.bytes_allocated
+                   << ", \"peak_rss_bytes\": " << object.peak_rss_bytes << "}";
+        }
+
+        stream << "]}";
+    }
+
+    stream << "\n]\n";
+}
+
+void LoadProfile::WriteCsv(std::ostream &stream) const
+{
+    // The columns which don't apply to a row's kind are left empty
+    stream << "record,file,loaded_by,succeeded,name,object,objects,polygons,vertices,wall_us,"
+              "allocations,bytes_allocated,bytes_reserved,peak_rss_bytes\n";
+
+    for (const LoadFigureRecord &figure : m_figures) {
+        std::string file = Quote(figure.file_name, false);
+
+        stream << "figure," << file << "," << figure.loaded_by << "," << (figure.succeeded ? 1 : 0)
+               << ",,,,,," << figure.wall_us << ",,," << figure.bytes_reserved << ","
+               << figure.peak_rss_bytes << "\n";
+
+        for (const LoadStageRecord &stage : figure.stages)
+            stream << "stage," << file << ",,," << stage.name << ",," << stage.objects_nr << ",,"
+                   << stage.vertices_nr << "," << stage.wall_us << "," << stage.allocations_nr << ","
+                   << stage.bytes_allocated << ",,\n";
+
+        for (const LoadObjectRecord &object : figure.objects)
+            stream << "object," << file << ",,,," << object.object << ",," << object.polygons_nr << ","
+                   << object.vertices_nr << "," << object.wall_us << "," << object.allocations_nr << ","
+                   << object.bytes_allocated << ",," << object.peak_rss_bytes << "\n";
+    }
+}
+
+bool LoadProfile::Write(const char *path) const
+{
+    size_t length = strlen(path);
+    std::ofstream stream(path);
+
+    if (!stream)
+        return false;
+
+    if (length >= 4 && (strcmp(path + length - 4, ".csv") == 0 || strcmp(path + length - 4, ".CSV") == 0))
+        WriteCsv(stream);
+    else
+        WriteJson(stream);
+
+    return (bool)stream.flush();
+}
+
+size_t LoadProfile::GetPeakRss()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+
+    return (size_t)usage.ru_maxrss * 1024; // In kilobytes on Linux
+#endif
+}
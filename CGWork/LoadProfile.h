@@ -0,0 +1,81 @@
+#ifndef __LOAD_PROFILE_H__
+#define __LOAD_PROFILE_H__
+
+/* Header file for the load profile class */
+
+#include <stddef.h>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// A stage of loading a file, summed over all the objects that went through it
+struct LoadStageRecord
+{
+    std::string name;
+    long long objects_nr;
+    long long vertices_nr;
+    long long wall_us; // Time spent working, not waiting for other stages
+    long long allocations_nr;
+    long long bytes_allocated;
+};
+
+// One object of a figure, from the time it was parsed to the time it was built
+struct LoadObjectRecord
+{
+    int object; // Index in its figure
+    int polygons_nr;
+    int vertices_nr;
+    long long wall_us;
+    long long allocations_nr;
+    long long bytes_allocated;
+    size_t peak_rss_bytes; // Of the process, once the object was built
+};
+
+// Everything that was measured while a file was loaded into a figure
+struct LoadFigureRecord
+{
+    std::string file_name;
+    std::string loaded_by; // "cache", "native" or "irit"
+    bool succeeded;
+    long long wall_us;
+    size_t bytes_reserved; // By the figure's arena, once loaded
+    size_t peak_rss_bytes;
+    std::vector<LoadStageRecord> stages;
+    std::vector<LoadObjectRecord> objects;
+};
+
+/* Load statistics, for capacity planning.
+ *
+ * The loader fills a LoadFigureRecord for every file, and the profile
+ * writes them as JSON (a list of figures, each with its stages and its
+ * objects) or as CSV (one row per figure, stage and object, told apart by
+ * the first column). Allocations are counted where the loader allocates:
+ * arenas, and the welder's and normals' buffers. Memory the irit library
+ * allocates on its own only shows in the peak RSS, which is the process's,
+ * so files loaded at the same time share it.
+ */
+class LoadProfile
+{
+    std::vector<LoadFigureRecord> m_figures;
+
+    // Escapes a string for JSON, and for CSV, and quotes it
+    static std::string Quote(const std::string &text, bool is_json);
+
+public:
+    void AddFigure(const LoadFigureRecord &figure);
+
+    const std::vector<LoadFigureRecord> &getFigures() const;
+
+    void WriteJson(std::ostream &stream) const;
+
+    void WriteCsv(std::ostream &stream) const;
+
+    /* Writes the profile to @path, as CSV if its extension is .csv and as
+     * JSON otherwise. Returns false if the file can't be written */
+    bool Write(const char *path) const;
+
+    // The process's peak resident set size so far, 0 if it can't be measured
+    static size_t GetPeakRss();
+};
+
+#endif // __LOAD_PROFILE_H__
@@ -0,0 +1,113 @@
+/** Testing the load profile **/
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdio.h>
+#include <string>
+#include "LoadProfile.h"
+
+using namespace std;
+
+#define OBJECTS_NR 3
+#define TEST_FILE_NAME "LoadProfileTest.csv"
+
+static int countOf(const string &text, const string &pattern)
+{
+    int count = 0;
+
+    for (size_t i = text.find(pattern); i != string::npos; i = text.find(pattern, i + 1))
+        count++;
+
+    return count;
+}
+
+int main()
+{
+    bool passed = true;
+    LoadProfile profile;
+    LoadFigureRecord figure;
+
+    // A Windows path with a quote, which both formats have to escape
+    figure.file_name = "C:\\scenes\\\"big\".itd";
+    figure.loaded_by = "native";
+    figure.succeeded = true;
+    figure.wall_us = 1500;
+    figure.bytes_reserved = 65536;
+    figure.peak_rss_bytes = 1 << 20;
+
+    LoadStageRecord parse = {"parse", OBJECTS_NR, 12, 1000, 0, 0};
+    LoadStageRecord build = {"build", OBJECTS_NR, 12, 400, 9, 4096};
+    figure.stages.push_back(parse);
+    figure.stages.push_back(build);
+
+    for (int i = 0; i < OBJECTS_NR; i++) {
+        LoadObjectRecord object = {i, 1, 4, 100, 3, 1024, (size_t)1 << 20};
+        figure.objects.push_back(object);
+    }
+
+    profile.AddFigure(figure);
+    figure.file_name = "empty.itd";
+    figure.succeeded = false;
+    figure.stages.clear();
+    figure.objects.clear();
+    profile.AddFigure(figure);
+
+    ostringstream json;
+    profile.WriteJson(json);
+    string text = json.str();
+
+    bool is_json = text[0] == '[' && countOf(text, "\"file\"") == 2 &&
+                   countOf(text, "\"object\": ") == OBJECTS_NR && countOf(text, "\"name\"") == 2 &&
+                   text.find("\"C:\\\\scenes\\\\\\\"big\\\".itd\"") != string::npos &&
+                   text.find("\"succeeded\": false") != string::npos &&
+                   text.find("\"bytes_allocated\": 4096") != string::npos;
+
+    cout << "JSON has every figure, stage and object, escaped: " << (is_json ? "passed" : "FAILED") << endl;
+    passed &= is_json;
+
+    ostringstream csv;
+    profile.WriteCsv(csv);
+    text = csv.str();
+
+    // A header, then a row per figure, stage and object, all with the same columns
+    bool is_csv = countOf(text, "\n") == 1 + 2 + 2 + OBJECTS_NR && countOf(text, "\nfigure,") == 2 &&
+                  countOf(text, "\nstage,") == 2 && countOf(text, "\nobject,") == OBJECTS_NR &&
+                  text.find("\"C:\\scenes\\\"\"big\"\".itd\"") != string::npos;
+
+    istringstream rows(text);
+    string row;
+    int columns_nr = -1;
+
+    while (getline(rows, row)) {
+        // No field has a comma in it, so commas separate the columns
+        int row_columns_nr = countOf(row, ",") + 1;
+
+        is_csv &= columns_nr < 0 || row_columns_nr == columns_nr;
+        columns_nr = row_columns_nr;
+    }
+
+    cout << "CSV has a row per record, every row with all the columns: " << (is_csv ? "passed" : "FAILED")
+         << endl;
+    passed &= is_csv;
+
+    // The format follows the extension
+    bool is_written = profile.Write(TEST_FILE_NAME);
+    ifstream file(TEST_FILE_NAME);
+    getline(file, row);
+    file.close();
+    remove(TEST_FILE_NAME);
+
+    is_written &= row.compare(0, 7, "record,") == 0;
+
+    cout << "Files ending with .csv are written as CSV: " << (is_written ? "passed" : "FAILED") << endl;
+    passed &= is_written;
+
+    bool has_rss = LoadProfile::GetPeakRss() > 0;
+    cout << "Peak RSS is measured: " << (has_rss ? "passed" : "FAILED") << endl;
+    passed &= has_rss;
+
+    cout << endl << (passed ? "All tests passed" : "Some tests FAILED") << endl;
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,115 @@
+/* Implementation of the MappedFile class */
+
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() : m_data(nullptr), m_size(0), m_file(nullptr), m_mapping(nullptr)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::Open(const char *file_name)
+{
+    LARGE_INTEGER size;
+
+    Close();
+
+    // Deleting is shared so that the file can be replaced while it's mapped
+    HANDLE file = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                              NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    m_file = file;
+
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0 ||
+        (unsigned long long)size.QuadPart > (size_t)-1) {
+        Close();
+        return false;
+    }
+
+    m_mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!m_mapping) {
+        Close();
+        return false;
+    }
+
+    m_data = (const char *)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!m_data) {
+        Close();
+        return false;
+    }
+
+    m_size = (size_t)size.QuadPart;
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_data)
+        UnmapViewOfFile(m_data);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    if (m_file)
+        CloseHandle(m_file);
+
+    m_data = nullptr;
+    m_size = 0;
+    m_mapping = nullptr;
+    m_file = nullptr;
+}
+
+#else
+
+bool MappedFile::Open(const char *file_name)
+{
+    struct stat file_stat;
+
+    Close();
+
+    int fd = open(file_name, O_RDONLY);
+    if (fd == -1)
+        return false;
+
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    // The mapping keeps its own reference to the file
+    void *data = mmap(nullptr, (size_t)file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+        return false;
+
+    m_data = (const char *)data;
+    m_size = (size_t)file_stat.st_size;
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_data)
+        munmap((void *)m_data, m_size);
+
+    m_data = nullptr;
+    m_size = 0;
+}
+
+#endif
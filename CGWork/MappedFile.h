@@ -0,0 +1,48 @@
+#ifndef __MAPPED_FILE_H__
+#define __MAPPED_FILE_H__
+
+/* Header file for the mapped file class */
+
+#include <stddef.h>
+
+/* A file mapped read only into memory.
+ *
+ * Its pages are only read from the disk when they are first touched, and
+ * are shared with the system's file cache, so opening a file costs about
+ * the same no matter how big it is.
+ */
+class MappedFile
+{
+    const char *m_data;
+    size_t m_size;
+
+    // Windows keeps a handle to the file and one to its mapping
+    void *m_file;
+    void *m_mapping;
+
+public:
+    MappedFile();
+
+    ~MappedFile();
+
+    // The mapping is owned by the object
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // Maps the whole file. returns false if it can't, or if the file is empty
+    bool Open(const char *file_name);
+
+    void Close();
+
+    const char *getData() const
+    {
+        return m_data;
+    }
+
+    size_t getSize() const
+    {
+        return m_size;
+    }
+};
+
+#endif // __MAPPED_FILE_H__
@@ -3,182 +3,382 @@
 #include "Matrix.h"
 #include <iostream>
 #include <math.h>
-#include "Vector.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define MATRIX_USE_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MATRIX_USE_SSE2
+#endif
 
 using std::cout;
 using std::endl;
 
+// How far from orthonormal a rotation may drift and still be inverted as one
+#define RIGID_EPSILON 1e-9
+
 double SubDeterminant(double array[3][3]);
 
-Matrix::Matrix(double value)
+// Plain version of TransformArray, for when there is no SIMD to use
+template <class T>
+static void TransformArrayScalar(const T (*array)[4], const T *in, T *out, int count,
+								 bool homogenize)
 {
-    for (int i = 0; i < 4; i++)
-    {
-        for (int j = 0; j < 4; j++)
-        {
-            array[i][j] = value;
-        }
-    }
+	T res[4];
+
+	for (int i = 0; i < count; i++, in += 4, out += 4) {
+		for (int j = 0; j < 4; j++) {
+			res[j] = array[j][0] * in[0] + array[j][1] * in[1] +
+					 array[j][2] * in[2] + array[j][3] * in[3];
+		}
+
+		if (homogenize && res[3] != 0) {
+			res[0] /= res[3];
+			res[1] /= res[3];
+			res[2] /= res[3];
+			res[3] = 1;
+		}
+
+		for (int j = 0; j < 4; j++)
+			out[j] = res[j];
+	}
 }
 
-// Copy Ctor
-Matrix::Matrix(const Matrix &matrix)
+template <>
+void Mat<4, double>::TransformArray(const double *in, double *out, int count, bool homogenize) const
 {
-    for (int i = 0; i < 4; i++)
-    {
-        for (int j = 0; j < 4; j++)
-        {
-            this->array[i][j] = matrix.array[i][j];
-        }
-    }
-}
+#if defined(MATRIX_USE_AVX)
+	// Each column of the matrix fills a whole register, so a point is
+	// the sum of the four columns scaled by its coordinates
+	__m256d col0 = _mm256_setr_pd(array[0][0], array[1][0], array[2][0], array[3][0]);
+	__m256d col1 = _mm256_setr_pd(array[0][1], array[1][1], array[2][1], array[3][1]);
+	__m256d col2 = _mm256_setr_pd(array[0][2], array[1][2], array[2][2], array[3][2]);
+	__m256d col3 = _mm256_setr_pd(array[0][3], array[1][3], array[2][3], array[3][3]);
+	__m256d one = _mm256_set1_pd(1.0);
+
+	for (int i = 0; i < count; i++, in += 4, out += 4) {
+		__m256d res = _mm256_add_pd(
+			_mm256_add_pd(_mm256_mul_pd(col0, _mm256_broadcast_sd(in)),
+						  _mm256_mul_pd(col1, _mm256_broadcast_sd(in + 1))),
+			_mm256_add_pd(_mm256_mul_pd(col2, _mm256_broadcast_sd(in + 2)),
+						  _mm256_mul_pd(col3, _mm256_broadcast_sd(in + 3))));
+
+		if (homogenize) {
+			// Spread w over all four lanes
+			__m256d w = _mm256_permute2f128_pd(res, res, 0x11);
+			w = _mm256_permute_pd(w, 0xF);
+			if (_mm_cvtsd_f64(_mm256_castpd256_pd128(w)) != 0)
+				res = _mm256_blend_pd(_mm256_div_pd(res, w), one, 0x8);
+		}
+
+		_mm256_storeu_pd(out, res);
+	}
+#elif defined(MATRIX_USE_SSE2)
+	// Every column is split into its (x, y) and (z, w) halves
+	__m128d col_lo[4], col_hi[4];
+	__m128d one = _mm_set1_pd(1.0);
+
+	for (int j = 0; j < 4; j++) {
+		col_lo[j] = _mm_setr_pd(array[0][j], array[1][j]);
+		col_hi[j] = _mm_setr_pd(array[2][j], array[3][j]);
+	}
 
-// Ctor for values for all indices
-Matrix::Matrix(double matrix[4][4])
-{
-    for (int i = 0; i < 4; i++)
-    {
-        for (int j = 0; j < 4; j++)
-        {
-            this->array[i][j] = matrix[i][j];
-        }
-    }
+	for (int i = 0; i < count; i++, in += 4, out += 4) {
+		__m128d x = _mm_set1_pd(in[0]),
+				y = _mm_set1_pd(in[1]),
+				z = _mm_set1_pd(in[2]),
+				w = _mm_set1_pd(in[3]);
+
+		__m128d lo = _mm_add_pd(_mm_add_pd(_mm_mul_pd(col_lo[0], x), _mm_mul_pd(col_lo[1], y)),
+								_mm_add_pd(_mm_mul_pd(col_lo[2], z), _mm_mul_pd(col_lo[3], w)));
+		__m128d hi = _mm_add_pd(_mm_add_pd(_mm_mul_pd(col_hi[0], x), _mm_mul_pd(col_hi[1], y)),
+								_mm_add_pd(_mm_mul_pd(col_hi[2], z), _mm_mul_pd(col_hi[3], w)));
+
+		if (homogenize) {
+			double res_w = _mm_cvtsd_f64(_mm_unpackhi_pd(hi, hi));
+			if (res_w != 0) {
+				__m128d div = _mm_set1_pd(res_w);
+				lo = _mm_div_pd(lo, div);
+				// Keep z / w and set w to exactly 1
+				hi = _mm_move_sd(one, _mm_div_pd(hi, div));
+			}
+		}
+
+		_mm_storeu_pd(out, lo);
+		_mm_storeu_pd(out + 2, hi);
+	}
+#else
+	TransformArrayScalar(array, in, out, count, homogenize);
+#endif
 }
 
-Matrix::Matrix(Vector &v1, Vector &v2, Vector &v3, Vector &v4)
+// A float point fills a 128 bit register, so SSE transforms one point at a
+// time and AVX two
+template <>
+void Mat<4, float>::TransformArray(const float *in, float *out, int count, bool homogenize) const
 {
-	for (int i = 0; i < 4; i++) {
-		array[0][i] = v1[i];
-		array[1][i] = v2[i];
-		array[2][i] = v3[i];
-		array[3][i] = v4[i];
+#if defined(MATRIX_USE_AVX) || defined(MATRIX_USE_SSE2)
+	__m128 col0 = _mm_setr_ps(array[0][0], array[1][0], array[2][0], array[3][0]);
+	__m128 col1 = _mm_setr_ps(array[0][1], array[1][1], array[2][1], array[3][1]);
+	__m128 col2 = _mm_setr_ps(array[0][2], array[1][2], array[2][2], array[3][2]);
+	__m128 col3 = _mm_setr_ps(array[0][3], array[1][3], array[2][3], array[3][3]);
+	int i = 0;
+
+#if defined(MATRIX_USE_AVX)
+	// Both halves of each register hold the same column
+	__m256 col0_x2 = _mm256_insertf128_ps(_mm256_castps128_ps256(col0), col0, 1);
+	__m256 col1_x2 = _mm256_insertf128_ps(_mm256_castps128_ps256(col1), col1, 1);
+	__m256 col2_x2 = _mm256_insertf128_ps(_mm256_castps128_ps256(col2), col2, 1);
+	__m256 col3_x2 = _mm256_insertf128_ps(_mm256_castps128_ps256(col3), col3, 1);
+	__m256 zero_x2 = _mm256_setzero_ps();
+
+	for (; i + 1 < count; i += 2, in += 8, out += 8) {
+		__m256 points = _mm256_loadu_ps(in);
+
+		// Spread each coordinate over the half of its point
+		__m256 res = _mm256_add_ps(
+			_mm256_add_ps(_mm256_mul_ps(col0_x2, _mm256_permute_ps(points, 0x00)),
+						  _mm256_mul_ps(col1_x2, _mm256_permute_ps(points, 0x55))),
+			_mm256_add_ps(_mm256_mul_ps(col2_x2, _mm256_permute_ps(points, 0xAA)),
+						  _mm256_mul_ps(col3_x2, _mm256_permute_ps(points, 0xFF))));
+
+		if (homogenize) {
+			// w / w is exactly 1, so only points with w == 0 are kept as is
+			__m256 w = _mm256_permute_ps(res, 0xFF);
+			__m256 non_zero = _mm256_cmp_ps(w, zero_x2, _CMP_NEQ_OQ);
+			res = _mm256_blendv_ps(res, _mm256_div_ps(res, w), non_zero);
+		}
+
+		_mm256_storeu_ps(out, res);
 	}
-}
+#endif
 
-Matrix::Matrix(Vector &v1, Vector &v2, Vector &v3) : Matrix(v1, v2, v3, Vector(0, 0, 0, 1))
-{
-}
+	__m128 zero = _mm_setzero_ps();
 
-// Dtor
-Matrix::~Matrix()
-{
-}
+	for (; i < count; i++, in += 4, out += 4) {
+		__m128 point = _mm_loadu_ps(in);
 
-// Multiply each part of the vector with a constant
-Matrix Matrix::operator*(double param) const
-{
-    Matrix matrix;
-    for (int i = 0; i < 4; i++)
-    {
-        for (int j = 0; j < 4; j++)
-        {
-            matrix.array[i][j] = this->array[i][j] * param;
-        }
-    }
+		__m128 res = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(col0, _mm_shuffle_ps(point, point, 0x00)),
+					   _mm_mul_ps(col1, _mm_shuffle_ps(point, point, 0x55))),
+			_mm_add_ps(_mm_mul_ps(col2, _mm_shuffle_ps(point, point, 0xAA)),
+					   _mm_mul_ps(col3, _mm_shuffle_ps(point, point, 0xFF))));
 
-    return matrix;
+		if (homogenize) {
+			__m128 w = _mm_shuffle_ps(res, res, 0xFF);
+			__m128 non_zero = _mm_cmpneq_ps(w, zero);
+			res = _mm_or_ps(_mm_and_ps(non_zero, _mm_div_ps(res, w)),
+							_mm_andnot_ps(non_zero, res));
+		}
+
+		_mm_storeu_ps(out, res);
+	}
+#else
+	TransformArrayScalar(array, in, out, count, homogenize);
+#endif
 }
 
-// Multiply each part of the vector with a constant
-void Matrix::operator*=(double param)
+// Calculate the determinant of the Matrix
+template <>
+double Mat<4, double>::Determinant() const
 {
-    for (int i = 0; i < 4; i++)
-    {
-        for (int j = 0; j < 4; j++)
-        {
-            this->array[i][j] *= param;
-        }
-    }
+	const double (*a)[4] = array;
+
+	// Expand by the 2x2 minors of the upper and lower two rows
+	return (a[0][0] * a[1][1] - a[1][0] * a[0][1]) * (a[2][2] * a[3][3] - a[3][2] * a[2][3])
+		 - (a[0][0] * a[1][2] - a[1][0] * a[0][2]) * (a[2][1] * a[3][3] - a[3][1] * a[2][3])
+		 + (a[0][0] * a[1][3] - a[1][0] * a[0][3]) * (a[2][1] * a[3][2] - a[3][1] * a[2][2])
+		 + (a[0][1] * a[1][2] - a[1][1] * a[0][2]) * (a[2][0] * a[3][3] - a[3][0] * a[2][3])
+		 - (a[0][1] * a[1][3] - a[1][1] * a[0][3]) * (a[2][0] * a[3][2] - a[3][0] * a[2][2])
+		 + (a[0][2] * a[1][3] - a[1][2] * a[0][3]) * (a[2][0] * a[3][1] - a[3][0] * a[2][1]);
 }
 
-// Multiply 2 matrices
-Matrix Matrix::operator*(const Matrix &matrix) const
+template <>
+bool Mat<4, double>::IsAffine() const
 {
-    Matrix new_matrix;
-
-    for (int i = 0; i < 4; i++)
-    {
-        for (int j = 0; j < 4; j++)
-        {
-            for (int k = 0; k < 4; k++)
-            {
-                new_matrix.array[i][j] += this->array[i][k] * 
-										 matrix.array[k][j];
-            }
-        }
-    }
-
-    return new_matrix;
+	return array[3][0] == 0 && array[3][1] == 0 && array[3][2] == 0 && array[3][3] == 1;
 }
 
-// Multiply a Matrix and a vector
-Vector Matrix::operator*(Vector &vector) const
+template <>
+bool Mat<4, double>::IsRigid() const
 {
-	Vector new_vec;
+	if (!IsAffine())
+		return false;
+
+	// The rows of a rotation are orthonormal
+	for (int i = 0; i < 3; i++) {
+		for (int j = i; j < 3; j++) {
+			double dot = array[i][0] * array[j][0] + array[i][1] * array[j][1] +
+						 array[i][2] * array[j][2];
+			if (fabs(dot - ((i == j) ? 1.0 : 0.0)) > RIGID_EPSILON)
+				return false;
+		}
+	}
 
-    for (int i = 0; i < 4; i++)
-    {
-        for (int j = 0; j < 4; j++)
-        {
-			new_vec[i] += vector[j] * array[i][j];
-        }
-    }
-	return new_vec;
+	return true;
 }
 
-// Calculate the determinant of the Matrix
-double Matrix::Determinant() const
+// Inverse of [R | t] is [R^T | -R^T * t]
+static Matrix InverseRigid(const Matrix &mat)
 {
-    double determinant = 0;
-    Matrix adj = this->Adjoint();
+	const double (*a)[4] = mat.array;
+	Matrix inverse;
 
-    determinant = 0;
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++)
+			inverse.array[i][j] = a[j][i];
 
-    for (int i = 0; i < 4; i++)
-    {
-        determinant += adj.array[i][0] * this->array[0][i];
-    }
+		inverse.array[i][3] = -(a[0][i] * a[0][3] + a[1][i] * a[1][3] + a[2][i] * a[2][3]);
+	}
+	inverse.array[3][3] = 1;
 
-    return determinant;
+	return inverse;
 }
 
-// Return the transpose the matrix
-Matrix Matrix::Transpose() const
+// Inverse of [A | t] is [A^-1 | -A^-1 * t]
+static Matrix InverseAffine(const Matrix &mat)
 {
-    Matrix matrix;
+	const double (*a)[4] = mat.array;
+	Matrix inverse;
+	double determinant;
+
+	// Cofactors of the upper 3x3 block, already transposed
+	inverse.array[0][0] = a[1][1] * a[2][2] - a[1][2] * a[2][1];
+	inverse.array[0][1] = a[0][2] * a[2][1] - a[0][1] * a[2][2];
+	inverse.array[0][2] = a[0][1] * a[1][2] - a[0][2] * a[1][1];
+	inverse.array[1][0] = a[1][2] * a[2][0] - a[1][0] * a[2][2];
+	inverse.array[1][1] = a[0][0] * a[2][2] - a[0][2] * a[2][0];
+	inverse.array[1][2] = a[0][2] * a[1][0] - a[0][0] * a[1][2];
+	inverse.array[2][0] = a[1][0] * a[2][1] - a[1][1] * a[2][0];
+	inverse.array[2][1] = a[0][1] * a[2][0] - a[0][0] * a[2][1];
+	inverse.array[2][2] = a[0][0] * a[1][1] - a[0][1] * a[1][0];
+
+	determinant = a[0][0] * inverse.array[0][0] + a[0][1] * inverse.array[1][0] +
+				  a[0][2] * inverse.array[2][0];
+	if (determinant == 0)
+		throw Matrix::MatrixNotReversible();
+
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++)
+			inverse.array[i][j] /= determinant;
+
+		inverse.array[i][3] = -(inverse.array[i][0] * a[0][3] + inverse.array[i][1] * a[1][3] +
+								inverse.array[i][2] * a[2][3]);
+	}
+	inverse.array[3][3] = 1;
 
-    for (int i = 0; i < 4; i++)
-    {
-        for (int j = 0; j < 4; j++)
-        {
-            matrix.array[i][j] = this->array[j][i];
-        }
-    }
+	return inverse;
+}
 
-    return matrix;
+/* General inverse using the 2x2 minors of the upper (s) and lower (c) two
+ * rows. Every pair of entries (b[i][0], b[i][1]) is a combination of the
+ * columns of rows 1 and 0 scaled by the c minors, and every pair
+ * (b[i][2], b[i][3]) a combination of the columns of rows 3 and 2 scaled by
+ * the s minors, which lets each pair be computed in one SSE2 register.
+ */
+static Matrix InverseGeneral(const Matrix &mat)
+{
+	const double (*a)[4] = mat.array;
+	Matrix inverse;
+
+	double s0 = a[0][0] * a[1][1] - a[1][0] * a[0][1],
+		   s1 = a[0][0] * a[1][2] - a[1][0] * a[0][2],
+		   s2 = a[0][0] * a[1][3] - a[1][0] * a[0][3],
+		   s3 = a[0][1] * a[1][2] - a[1][1] * a[0][2],
+		   s4 = a[0][1] * a[1][3] - a[1][1] * a[0][3],
+		   s5 = a[0][2] * a[1][3] - a[1][2] * a[0][3];
+
+	double c0 = a[2][0] * a[3][1] - a[3][0] * a[2][1],
+		   c1 = a[2][0] * a[3][2] - a[3][0] * a[2][2],
+		   c2 = a[2][0] * a[3][3] - a[3][0] * a[2][3],
+		   c3 = a[2][1] * a[3][2] - a[3][1] * a[2][2],
+		   c4 = a[2][1] * a[3][3] - a[3][1] * a[2][3],
+		   c5 = a[2][2] * a[3][3] - a[3][2] * a[2][3];
+
+	double determinant = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+	if (determinant == 0)
+		throw Matrix::MatrixNotReversible();
+
+	double inv_det = 1.0 / determinant;
+
+#if defined(MATRIX_USE_AVX) || defined(MATRIX_USE_SSE2)
+	__m128d p[4], q[4];
+	__m128d even_sign = _mm_setr_pd(inv_det, -inv_det),
+			odd_sign = _mm_setr_pd(-inv_det, inv_det);
+
+	for (int j = 0; j < 4; j++) {
+		p[j] = _mm_setr_pd(a[1][j], a[0][j]);
+		q[j] = _mm_setr_pd(a[3][j], a[2][j]);
+	}
+
+#define INVERSE_PAIR(cols, m0, j0, m1, j1, m2, j2) \
+	_mm_add_pd(_mm_sub_pd(_mm_mul_pd(cols[j0], _mm_set1_pd(m0)), \
+						  _mm_mul_pd(cols[j1], _mm_set1_pd(m1))), \
+			   _mm_mul_pd(cols[j2], _mm_set1_pd(m2)))
+
+	_mm_storeu_pd(&inverse.array[0][0], _mm_mul_pd(even_sign, INVERSE_PAIR(p, c5, 1, c4, 2, c3, 3)));
+	_mm_storeu_pd(&inverse.array[0][2], _mm_mul_pd(even_sign, INVERSE_PAIR(q, s5, 1, s4, 2, s3, 3)));
+	_mm_storeu_pd(&inverse.array[1][0], _mm_mul_pd(odd_sign, INVERSE_PAIR(p, c5, 0, c2, 2, c1, 3)));
+	_mm_storeu_pd(&inverse.array[1][2], _mm_mul_pd(odd_sign, INVERSE_PAIR(q, s5, 0, s2, 2, s1, 3)));
+	_mm_storeu_pd(&inverse.array[2][0], _mm_mul_pd(even_sign, INVERSE_PAIR(p, c4, 0, c2, 1, c0, 3)));
+	_mm_storeu_pd(&inverse.array[2][2], _mm_mul_pd(even_sign, INVERSE_PAIR(q, s4, 0, s2, 1, s0, 3)));
+	_mm_storeu_pd(&inverse.array[3][0], _mm_mul_pd(odd_sign, INVERSE_PAIR(p, c3, 0, c1, 1, c0, 2)));
+	_mm_storeu_pd(&inverse.array[3][2], _mm_mul_pd(odd_sign, INVERSE_PAIR(q, s3, 0, s1, 1, s0, 2)));
+
+#undef INVERSE_PAIR
+#else
+	double (*b)[4] = inverse.array;
+
+	b[0][0] = ( a[1][1] * c5 - a[1][2] * c4 + a[1][3] * c3) * inv_det;
+	b[0][1] = (-a[0][1] * c5 + a[0][2] * c4 - a[0][3] * c3) * inv_det;
+	b[0][2] = ( a[3][1] * s5 - a[3][2] * s4 + a[3][3] * s3) * inv_det;
+	b[0][3] = (-a[2][1] * s5 + a[2][2] * s4 - a[2][3] * s3) * inv_det;
+
+	b[1][0] = (-a[1][0] * c5 + a[1][2] * c2 - a[1][3] * c1) * inv_det;
+	b[1][1] = ( a[0][0] * c5 - a[0][2] * c2 + a[0][3] * c1) * inv_det;
+	b[1][2] = (-a[3][0] * s5 + a[3][2] * s2 - a[3][3] * s1) * inv_det;
+	b[1][3] = ( a[2][0] * s5 - a[2][2] * s2 + a[2][3] * s1) * inv_det;
+
+	b[2][0] = ( a[1][0] * c4 - a[1][1] * c2 + a[1][3] * c0) * inv_det;
+	b[2][1] = (-a[0][0] * c4 + a[0][1] * c2 - a[0][3] * c0) * inv_det;
+	b[2][2] = ( a[3][0] * s4 - a[3][1] * s2 + a[3][3] * s0) * inv_det;
+	b[2][3] = (-a[2][0] * s4 + a[2][1] * s2 - a[2][3] * s0) * inv_det;
+
+	b[3][0] = (-a[1][0] * c3 + a[1][1] * c1 - a[1][2] * c0) * inv_det;
+	b[3][1] = ( a[0][0] * c3 - a[0][1] * c1 + a[0][2] * c0) * inv_det;
+	b[3][2] = (-a[3][0] * s3 + a[3][1] * s1 - a[3][2] * s0) * inv_det;
+	b[3][3] = ( a[2][0] * s3 - a[2][1] * s1 + a[2][2] * s0) * inv_det;
+#endif
+
+	return inverse;
 }
 
 // Return the inverse of the matrix
-Matrix Matrix::Inverse() const
+template <>
+Matrix Mat<4, double>::Inverse(InverseType type) const
 {
-    MatrixNotReversible exception;
-    Matrix matrix;
-    double determinant = this->Determinant();
-
-    if (determinant != 0)
-    {
-        matrix = this->Adjoint();
-        matrix *= (1.0 / determinant);
-    }
-    else
-    {
-        throw exception;
-    }
+	if (type == INVERSE_AUTO) {
+		if (IsRigid())
+			type = INVERSE_RIGID;
+		else if (IsAffine())
+			type = INVERSE_AFFINE;
+		else
+			type = INVERSE_GENERAL;
+	}
 
-    return matrix;
+	switch (type) {
+	case INVERSE_RIGID:
+		return InverseRigid(*this);
+	case INVERSE_AFFINE:
+		return InverseAffine(*this);
+	default:
+		return InverseGeneral(*this);
+	}
 }
 
-Matrix Matrix::Adjoint() const
+template <>
+Matrix Mat<4, double>::Adjoint() const
 {
     Matrix matrix;
     double temp_arr[3][3];
@@ -203,7 +403,7 @@ Matrix Matrix::Adjoint() const
                 }
             }
             // if (i+j) is even, then sign is 1, else -1
-            sign = (int)pow(-1, i + j);
+            sign = ((i + j) % 2 == 0) ? 1 : -1;
             matrix.array[i][j] = sign * SubDeterminant(temp_arr);
         }
     }
@@ -227,30 +427,3 @@ double SubDeterminant(double array[3][3])
 
     return determinant;
 }
-
-// Return an identity matrix
-Matrix Matrix::Identity()
-{
-    Matrix matrix;
-
-    for (int i = 0; i < 4; i++)
-    {
-        matrix.array[i][i] = 1;
-    }
-
-    return matrix;
-}
-
-// Print the vector - for debug purposes
-void Matrix::Print() const
-{
-    for (int i = 0; i < 4; i++)
-    {
-        cout << "<";
-        for (int j = 0; j < 4; j++)
-        {
-            cout << this->array[i][j] << " ";
-        }
-        cout << ">" << endl;
-    }
-}
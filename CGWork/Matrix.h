@@ -8,65 +8,20 @@
 
 using namespace std;
 
-class Matrix
-{
-public:
-    double array[4][4];
+// A 4x4 matrix which transforms homogeneous 3D vectors
+typedef Mat<4, double> Matrix;
 
-    // Ctor with an init value
-    Matrix(double value = 0);
+// Implemented in Matrix.cpp
 
-    // Copy Ctor
-    Matrix(const Matrix &matrix);
+template <> void Mat<4, double>::TransformArray(const double *in, double *out, int count,
+                                                 bool homogenize) const;
+template <> void Mat<4, float>::TransformArray(const float *in, float *out, int count,
+                                                bool homogenize) const;
 
-    // Ctor for values for all indices
-    Matrix(double matrix[4][4]);
+template <> double Mat<4, double>::Determinant() const;
+template <> Mat<4, double> Mat<4, double>::Adjoint() const;
+template <> Mat<4, double> Mat<4, double>::Inverse(InverseType type) const;
+template <> bool Mat<4, double>::IsAffine() const;
+template <> bool Mat<4, double>::IsRigid() const;
 
-	/* Create a matrix out of four vector.
-	 * The fourth vector is (0 0 0 1)
-	 * @vi - the vector in row i
-	 */
-	Matrix(Vector &v1, Vector &v2, Vector &v3, Vector &v4);
-
-	/* Create a matrix out of three vector.
-	 * The fourth vector is (0 0 0 1)
-	 * @vi - the vector in row i
-	 */
-	Matrix(Vector &v1, Vector &v2, Vector &v3);
-
-    // Dtor
-    ~Matrix();
-
-    // Multiply each part of the vector with a constant
-    Matrix operator*(double param) const;
-
-    void operator*=(double param);
-
-    // Multiply 2 matrices
-    Matrix operator*(const Matrix &matrix) const;
-
-    // Multiply a Matrix and a vector
-    Vector operator*(Vector &vector) const;
-
-    // Calculate the determinant of the Matrix
-    double Determinant() const;
-
-    // Return the transpose the matrix
-    Matrix Transpose() const;
-
-    // Return the adjoint of the matrix
-    Matrix Adjoint() const;
-
-    // Return the inverse of the matrix
-    Matrix Inverse() const;
-
-    // Return an identity matrix
-    static Matrix Identity();
-
-    // Print the vector - for debug purposes
-    void Print() const;
-
-    class MatrixNotReversible : public exception{};
-};
-
-#endif // __MATRIX_H__
\ No newline at end of file
+#endif // __MATRIX_H__
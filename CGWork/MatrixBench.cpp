@@ -0,0 +1,255 @@
+/* Benchmarking the Matrix class */
+
+#include "Matrix.h"
+#include <chrono>
+#include <iostream>
+#include <stdlib.h>
+
+using namespace std;
+
+#define BENCH_POINTS_NR 1000000
+#define BENCH_ROUNDS 20
+
+typedef chrono::high_resolution_clock Clock;
+
+static double millisecondsSince(Clock::time_point start)
+{
+	return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+// Transform the points one at a time, the way IritPolygon::draw does
+static double benchPerVector(Matrix &mat, Vector *in, Vector *out, bool homogenize)
+{
+	Clock::time_point start = Clock::now();
+
+	for (int round = 0; round < BENCH_ROUNDS; round++) {
+		for (int i = 0; i < BENCH_POINTS_NR; i++) {
+			out[i] = mat * in[i];
+			if (homogenize)
+				out[i].Homogenize();
+		}
+	}
+
+	return millisecondsSince(start) / BENCH_ROUNDS;
+}
+
+// Transform all the points in one batch
+static double benchBatch(Matrix &mat, Vector *in, Vector *out, bool homogenize)
+{
+	Clock::time_point start = Clock::now();
+
+	for (int round = 0; round < BENCH_ROUNDS; round++)
+		mat.TransformVectors(in, out, BENCH_POINTS_NR, homogenize);
+
+	return millisecondsSince(start) / BENCH_ROUNDS;
+}
+
+// Biggest difference between the coordinates of two arrays
+static double maxError(Vector *first, Vector *second)
+{
+	double error = 0;
+
+	for (int i = 0; i < BENCH_POINTS_NR; i++) {
+		for (int j = 0; j < 4; j++) {
+			double diff = first[i][j] - second[i][j];
+			if (diff < 0)
+				diff = -diff;
+			if (diff > error)
+				error = diff;
+		}
+	}
+
+	return error;
+}
+
+#define BENCH_INVERSE_NR 1000000
+
+// Time the inverse of a matrix with the adjoint and with every fast method
+// that fits it
+static void benchInverseOf(const char *name, Matrix &mat, int methods_nr)
+{
+	Matrix::InverseType types[3] = {Matrix::INVERSE_GENERAL, Matrix::INVERSE_AFFINE,
+									Matrix::INVERSE_RIGID};
+	const char *type_names[3] = {"General", "Affine", "Rigid"};
+	double sum = 0;
+
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < BENCH_INVERSE_NR; i++) {
+		mat.array[0][3] += 1e-9; // Keep the compiler from hoisting the inverse
+		sum += (mat.Adjoint() * (1.0 / mat.Determinant())).Coeff(0, 0);
+	}
+	double adjoint = millisecondsSince(start);
+
+	cout << name << " matrix - " << endl;
+	cout << "Adjoint:    " << adjoint << " ms" << endl;
+
+	for (int t = 0; t < methods_nr; t++) {
+		start = Clock::now();
+		for (int i = 0; i < BENCH_INVERSE_NR; i++) {
+			mat.array[0][3] += 1e-9;
+			sum += mat.Inverse(types[t]).array[0][0];
+		}
+		double fast = millisecondsSince(start);
+
+		cout << type_names[t] << ":    " << fast << " ms (" << adjoint / fast << "x)" << endl;
+	}
+	cout << "Checksum:   " << sum << endl
+		 << endl;
+}
+
+static void benchInverse()
+{
+	double general_array[4][4] = {
+		{1, 2, 3, 4},
+		{1, 4, 2, 1},
+		{0, 2, 1, -2},
+		{1, 1, -2, 0}};
+	double affine_array[4][4] = {
+		{2, 1, 0, 1},
+		{0, 3, 1, 2},
+		{1, 0, 4, 3},
+		{0, 0, 0, 1}};
+	double rigid_array[4][4] = {
+		{0, -1, 0, 5},
+		{1, 0, 0, -3},
+		{0, 0, 1, 2},
+		{0, 0, 0, 1}};
+	Matrix general(general_array), affine(affine_array), rigid(rigid_array);
+
+	cout << "Inverting " << BENCH_INVERSE_NR << " matrices" << endl
+		 << endl;
+
+	benchInverseOf("General", general, 1);
+	benchInverseOf("Affine", affine, 2);
+	benchInverseOf("Rigid", rigid, 3);
+}
+
+#define BENCH_CHAIN_NR 5000000
+
+/* Time the operator chains used while drawing, once evaluated step by step
+ * into temporaries and once as a single expression
+ */
+static void benchChains()
+{
+	Matrix transform = Matrix::Identity() * 2, world_mat = Matrix::Identity(),
+		   object_mat = Matrix::Identity(), result;
+	Vector a(1, 2, 3), b(3, 2, 1), vec_result;
+	double s = 0.5, sum = 0;
+
+	cout << "Evaluating " << BENCH_CHAIN_NR << " operator chains" << endl
+		 << endl;
+
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < BENCH_CHAIN_NR; i++) {
+		world_mat.array[0][3] += 1e-9;
+		Matrix temp = transform * world_mat;
+		result = temp * object_mat;
+		sum += result.array[0][3];
+	}
+	double steps = millisecondsSince(start);
+
+	start = Clock::now();
+	for (int i = 0; i < BENCH_CHAIN_NR; i++) {
+		world_mat.array[0][3] += 1e-9;
+		result = transform * world_mat * object_mat;
+		sum += result.array[0][3];
+	}
+	double fused = millisecondsSince(start);
+
+	cout << "transform * world_mat * object_mat - " << endl;
+	cout << "Step by step: " << steps << " ms" << endl;
+	cout << "Expression:   " << fused << " ms (" << steps / fused << "x)" << endl
+		 << endl;
+
+	start = Clock::now();
+	for (int i = 0; i < BENCH_CHAIN_NR; i++) {
+		b[0] += 1e-9;
+		Vector temp = b * s;
+		vec_result = a + temp;
+		sum += vec_result[0];
+	}
+	steps = millisecondsSince(start);
+
+	start = Clock::now();
+	for (int i = 0; i < BENCH_CHAIN_NR; i++) {
+		b[0] += 1e-9;
+		vec_result = a + b * s;
+		sum += vec_result[0];
+	}
+	fused = millisecondsSince(start);
+
+	cout << "a + b * s - " << endl;
+	cout << "Step by step: " << steps << " ms" << endl;
+	cout << "Expression:   " << fused << " ms (" << steps / fused << "x)" << endl;
+	cout << "Checksum:     " << sum << endl
+		 << endl;
+}
+
+int main()
+{
+	double array[4][4] = {
+		{0.8, -0.2, 0.1, 3},
+		{0.3, 0.9, -0.4, -2},
+		{-0.1, 0.5, 0.7, 1},
+		{0, 0, 0.05, 1}};
+	Matrix mat(array);
+
+	Vector *in = new Vector[BENCH_POINTS_NR];
+	Vector *scalar_out = new Vector[BENCH_POINTS_NR];
+	Vector *batch_out = new Vector[BENCH_POINTS_NR];
+
+	srand(0);
+	for (int i = 0; i < BENCH_POINTS_NR; i++) {
+		in[i] = Vector(rand() % 1000 / 100.0 - 5,
+					   rand() % 1000 / 100.0 - 5,
+					   rand() % 1000 / 100.0 - 5);
+	}
+
+	cout << "Transforming " << BENCH_POINTS_NR << " points" << endl
+		 << endl;
+
+	for (int homogenize = 0; homogenize < 2; homogenize++) {
+		double per_vector = benchPerVector(mat, in, scalar_out, homogenize != 0);
+		double batch = benchBatch(mat, in, batch_out, homogenize != 0);
+
+		cout << (homogenize ? "With" : "Without") << " perspective divide - " << endl;
+		cout << "Per vector: " << per_vector << " ms" << endl;
+		cout << "Batch:      " << batch << " ms" << endl;
+		cout << "Speedup:    " << per_vector / batch << "x" << endl;
+		cout << "Max error:  " << maxError(scalar_out, batch_out) << endl
+			 << endl;
+	}
+
+	// The same points in single precision
+	Mat4f mat_f(mat);
+	Vec4f *in_f = new Vec4f[BENCH_POINTS_NR];
+	Vec4f *out_f = new Vec4f[BENCH_POINTS_NR];
+
+	for (int i = 0; i < BENCH_POINTS_NR; i++)
+		in_f[i] = Vec4f(in[i]);
+
+	Clock::time_point start = Clock::now();
+	for (int round = 0; round < BENCH_ROUNDS; round++)
+		mat_f.TransformVectors(in_f, out_f, BENCH_POINTS_NR, true);
+	double batch_f = millisecondsSince(start) / BENCH_ROUNDS;
+
+	for (int i = 0; i < BENCH_POINTS_NR; i++)
+		scalar_out[i] = Vector(out_f[i]);
+
+	cout << "Float batch with perspective divide - " << endl;
+	cout << "Batch:      " << batch_f << " ms" << endl;
+	cout << "Max error:  " << maxError(scalar_out, batch_out) << endl
+		 << endl;
+
+	delete[] in_f;
+	delete[] out_f;
+
+	benchInverse();
+	benchChains();
+
+	delete[] in;
+	delete[] scalar_out;
+	delete[] batch_out;
+
+	return 0;
+}
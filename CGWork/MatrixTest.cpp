@@ -2,6 +2,7 @@
 
 #include "Matrix.h"
 #include <iostream>
+#include <math.h>
 
 using namespace std;
 
@@ -105,4 +106,63 @@ int main()
     mat3.Print();
 
     cout << endl;
+
+    // Check the fast inverse paths against the adjoint
+    cout << "Checking fast inverse - " << endl
+         << endl;
+
+    double rigid_array[4][4] = {
+        {0, -1, 0, 5},
+        {1, 0, 0, -3},
+        {0, 0, 1, 2},
+        {0, 0, 0, 1}};
+
+    double affine_array[4][4] = {
+        {2, 1, 0, 1},
+        {0, 3, 1, 2},
+        {1, 0, 4, 3},
+        {0, 0, 0, 1}};
+
+    Matrix matrices[3] = {Matrix(array), Matrix(affine_array), Matrix(rigid_array)};
+    Matrix::InverseType types[3] = {Matrix::INVERSE_GENERAL, Matrix::INVERSE_AFFINE,
+                                    Matrix::INVERSE_RIGID};
+
+    for (int m = 0; m < 3; m++)
+    {
+        Matrix reference = matrices[m].Adjoint() * (1.0 / matrices[m].Determinant());
+
+        cout << "Affine: " << matrices[m].IsAffine() << " Rigid: " << matrices[m].IsRigid() << endl;
+
+        // Every method that fits the matrix should agree with the adjoint
+        for (int t = 0; t <= m; t++)
+        {
+            double error = 0;
+            mat2 = matrices[m].Inverse(types[t]);
+
+            for (int i = 0; i < 4; i++)
+            {
+                for (int j = 0; j < 4; j++)
+                {
+                    error = fmax(error, fabs(mat2.array[i][j] - reference.array[i][j]));
+                }
+            }
+            cout << "Method " << types[t] << " max error: " << error << endl;
+        }
+        mat2 = matrices[m].Inverse();
+        mat3 = matrices[m] * mat2;
+        mat3.Print();
+    }
+
+    // A singular matrix is still rejected
+    try
+    {
+        Matrix(1).Inverse();
+        cout << "Singular matrix was inverted!" << endl;
+    }
+    catch (Matrix::MatrixNotReversible &)
+    {
+        cout << "Singular matrix rejected" << endl;
+    }
+
+    cout << endl;
 }
\ No newline at end of file
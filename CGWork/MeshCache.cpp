@@ -0,0 +1,407 @@
+/* Implementation of the mesh cache */
+
+#include "MeshCache.h"
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+#include <vector>
+
+#define MESH_CACHE_MAGIC "CGWMESH"
+#define MESH_CACHE_ALIGNMENT 64
+
+// The buffers are written and mapped as they are laid out in memory
+static_assert(sizeof(Vector) == 4 * sizeof(double), "Vector must be 4 packed doubles");
+static_assert(sizeof(Vec4f) == 4 * sizeof(float), "Vec4f must be 4 packed floats");
+
+struct CacheHeader
+{
+    char magic[8];
+    unsigned int version;
+    unsigned int objects_nr;
+
+    // The key
+    long long source_size;
+    long long source_modification_time;
+    double fineness;
+    unsigned long long path_offset;
+    unsigned long long path_length;
+
+    double min_bound[4];
+    double max_bound[4];
+
+    unsigned long long objects_offset; // Table of CacheObject
+    unsigned long long file_size;
+};
+
+struct CacheObject
+{
+    unsigned char color[4]; // As in RGBQUAD
+    int vertices_nr;
+    int indices_nr;
+    int polygons_nr;
+    int wire_vertices_nr;
+    int edges_nr;
+
+    // Offsets of the buffers, from the start of the file
+    unsigned long long positions_offset;
+    unsigned long long normals_offset;
+    unsigned long long is_irit_normal_offset;
+    unsigned long long indices_offset;
+    unsigned long long polygons_offset; // CachePolygon of every polygon
+    unsigned long long wire_vertices_offset;
+    unsigned long long edges_offset; // Two wire vertices per edge
+};
+
+struct CachePolygon
+{
+    int first_index;
+    int points_nr;
+    int is_irit_normal;
+    int reserved;
+    double normal_start[4];
+    double normal_end[4];
+};
+
+static unsigned long long align(unsigned long long offset)
+{
+    return (offset + MESH_CACHE_ALIGNMENT - 1) & ~(unsigned long long)(MESH_CACHE_ALIGNMENT - 1);
+}
+
+// Whether @count elements of @element_size at @offset are inside a file of @size bytes
+static bool isInFile(unsigned long long offset, unsigned long long count,
+                     unsigned long long element_size, unsigned long long size)
+{
+    return offset % MESH_CACHE_ALIGNMENT == 0 && offset <= size &&
+           count <= (size - offset) / element_size;
+}
+
+static unsigned long getProcessId()
+{
+#if defined(_WIN32)
+    return (unsigned long)GetCurrentProcessId();
+#else
+    return (unsigned long)getpid();
+#endif
+}
+
+bool MeshCacheKey::FromFile(const char *file_path, double file_fineness)
+{
+#if defined(_WIN32)
+    struct _stat64 file_stat;
+
+    if (_stat64(file_path, &file_stat) != 0)
+        return false;
+#else
+    struct stat file_stat;
+
+    if (stat(file_path, &file_stat) != 0)
+        return false;
+#endif
+
+    path = file_path;
+    size = (long long)file_stat.st_size;
+    modification_time = (long long)file_stat.st_mtime;
+    fineness = file_fineness;
+
+    return true;
+}
+
+std::string MeshCache::getCachePath(const MeshCacheKey &key)
+{
+    // FNV-1a of the path names the file, the whole key is checked when it's opened
+    unsigned long long hash = 14695981039346656037ULL;
+    char name[64];
+    std::string directory;
+
+    for (char c : key.path) {
+        hash ^= (unsigned char)c;
+        hash *= 1099511628211ULL;
+    }
+
+#if defined(_WIN32)
+    char temporary_path[MAX_PATH + 1];
+
+    if (GetTempPathA(sizeof(temporary_path), temporary_path))
+        directory = temporary_path;
+#else
+    const char *temporary_path = getenv("TMPDIR");
+
+    directory = (temporary_path && *temporary_path) ? temporary_path : "/tmp";
+    directory += '/';
+#endif
+
+    snprintf(name, sizeof(name), "cgwork-%016llx.mesh", hash);
+
+    return directory + name;
+}
+
+bool MeshCache::Write(const MeshCacheKey &key, IritFigure &figure)
+{
+    int objects_nr = figure.getObjectsNr();
+    CacheHeader header;
+    std::vector<CacheObject> objects(objects_nr);
+    std::vector<CachePolygon> polygons;
+    unsigned long long offset;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+    header.version = MESH_CACHE_VERSION;
+    header.objects_nr = objects_nr;
+    header.source_size = key.size;
+    header.source_modification_time = key.modification_time;
+    header.fineness = key.fineness;
+    header.path_offset = sizeof(header);
+    header.path_length = key.path.size();
+
+    for (int i = 0; i < 4; i++) {
+        header.min_bound[i] = figure.min_bound_coord[i];
+        header.max_bound[i] = figure.max_bound_coord[i];
+    }
+
+    // Lay the file out before writing it
+    offset = align(header.path_offset + header.path_length);
+    header.objects_offset = offset;
+    offset = align(offset + objects_nr * sizeof(CacheObject));
+
+    for (int i = 0; i < objects_nr; i++) {
+        IritObject &object = figure.getObject(i);
+        CacheObject &cache_object = objects[i];
+
+        memset(&cache_object, 0, sizeof(cache_object));
+        cache_object.color[0] = object.object_color.rgbBlue;
+        cache_object.color[1] = object.object_color.rgbGreen;
+        cache_object.color[2] = object.object_color.rgbRed;
+        cache_object.vertices_nr = object.getVerticesNr();
+        cache_object.indices_nr = object.getIndicesNr();
+        cache_object.polygons_nr = object.getPolygonsNr();
+        cache_object.wire_vertices_nr = object.getWireVerticesNr();
+        cache_object.edges_nr = object.getEdgesNr();
+
+        cache_object.positions_offset = offset;
+        offset = align(offset + cache_object.vertices_nr * sizeof(Vector));
+        cache_object.normals_offset = offset;
+        offset = align(offset + cache_object.vertices_nr * sizeof(Vec4f));
+        cache_object.is_irit_normal_offset = offset;
+        offset = align(offset + cache_object.vertices_nr);
+        cache_object.indices_offset = offset;
+        offset = align(offset + cache_object.indices_nr * sizeof(int));
+        cache_object.polygons_offset = offset;
+        offset = align(offset + cache_object.polygons_nr * sizeof(CachePolygon));
+        cache_object.wire_vertices_offset = offset;
+        offset = align(offset + cache_object.wire_vertices_nr * sizeof(int));
+        cache_object.edges_offset = offset;
+        offset = align(offset + cache_object.edges_nr * 2 * sizeof(int));
+    }
+
+    header.file_size = offset;
+
+    // Every writer has a temporary file of its own, even if it writes the same cache as another
+    static std::atomic<unsigned int> temporary_files_nr(0);
+    char suffix[64];
+
+    snprintf(suffix, sizeof(suffix), ".%lu-%u.tmp", getProcessId(), temporary_files_nr++);
+
+    std::string path = getCachePath(key), temporary_path = path + suffix;
+    FILE *file = fopen(temporary_path.c_str(), "wb");
+    unsigned long long written = 0;
+    bool is_ok = true;
+
+    if (!file)
+        return false;
+
+    // Writes @size bytes at @at, padding the file with zeros up to it
+    auto writeAt = [&](unsigned long long at, const void *data, size_t size) {
+        static const char zeros[MESH_CACHE_ALIGNMENT] = {0};
+
+        if (written < at)
+            is_ok &= fwrite(zeros, 1, (size_t)(at - written), file) == at - written;
+        if (size > 0)
+            is_ok &= fwrite(data, 1, size, file) == size;
+        written = at + size;
+    };
+
+    writeAt(0, &header, sizeof(header));
+    writeAt(header.path_offset, key.path.data(), key.path.size());
+    writeAt(header.objects_offset, objects.data(), objects.size() * sizeof(CacheObject));
+
+    for (int i = 0; i < objects_nr && is_ok; i++) {
+        IritObject &object = figure.getObject(i);
+        const CacheObject &cache_object = objects[i];
+
+        writeAt(cache_object.positions_offset, object.getPositions(),
+                cache_object.vertices_nr * sizeof(Vector));
+        writeAt(cache_object.normals_offset, object.getNormals(),
+                cache_object.vertices_nr * sizeof(Vec4f));
+        writeAt(cache_object.is_irit_normal_offset, object.getIsIritNormal(),
+                cache_object.vertices_nr);
+        writeAt(cache_object.indices_offset, object.getIndices(),
+                cache_object.indices_nr * sizeof(int));
+
+        polygons.resize(cache_object.polygons_nr);
+        for (int j = 0; j < cache_object.polygons_nr; j++) {
+            IritPolygon &polygon = object.getPolygon(j);
+            CachePolygon &cache_polygon = polygons[j];
+
+            cache_polygon.first_index = polygon.getFirstIndex();
+            cache_polygon.points_nr = polygon.getPointsNr();
+            cache_polygon.is_irit_normal = polygon.is_irit_normal;
+            cache_polygon.reserved = 0;
+            for (int k = 0; k < 4; k++) {
+                cache_polygon.normal_start[k] = polygon.normal_start[k];
+                cache_polygon.normal_end[k] = polygon.normal_end[k];
+            }
+        }
+        writeAt(cache_object.polygons_offset, polygons.data(),
+                polygons.size() * sizeof(CachePolygon));
+        writeAt(cache_object.wire_vertices_offset, object.getWireVertices(),
+                cache_object.wire_vertices_nr * sizeof(int));
+        writeAt(cache_object.edges_offset, object.getEdges(), cache_object.edges_nr * 2 * sizeof(int));
+    }
+
+    writeAt(header.file_size, nullptr, 0);
+
+    is_ok &= fclose(file) == 0;
+
+    // rename() doesn't replace an existing file on Windows
+    if (is_ok) {
+        remove(path.c_str());
+        is_ok = rename(temporary_path.c_str(), path.c_str()) == 0;
+    }
+
+    if (!is_ok)
+        remove(temporary_path.c_str());
+
+    return is_ok;
+}
+
+bool MeshCache::Validate(const MeshCacheKey &key) const
+{
+    const char *data = m_file->getData();
+    unsigned long long size = m_file->getSize();
+    const CacheHeader *header = (const CacheHeader *)data;
+
+    if (size < sizeof(CacheHeader) || memcmp(header->magic, MESH_CACHE_MAGIC,
+                                             sizeof(MESH_CACHE_MAGIC)) != 0 ||
+        header->version != MESH_CACHE_VERSION || header->file_size != size)
+        return false;
+
+    if (header->source_size != key.size ||
+        header->source_modification_time != key.modification_time ||
+        header->fineness != key.fineness || header->path_length != key.path.size() ||
+        header->path_offset > size || header->path_length > size - header->path_offset ||
+        memcmp(data + header->path_offset, key.path.data(), key.path.size()) != 0)
+        return false;
+
+    if (!isInFile(header->objects_offset, header->objects_nr, sizeof(CacheObject), size))
+        return false;
+
+    const CacheObject *objects = (const CacheObject *)(data + header->objects_offset);
+
+    for (unsigned int i = 0; i < header->objects_nr; i++) {
+        const CacheObject &object = objects[i];
+
+        if (object.vertices_nr < 0 || object.indices_nr < 0 || object.polygons_nr < 0 ||
+            object.wire_vertices_nr < 0 || object.edges_nr < 0 ||
+            !isInFile(object.positions_offset, object.vertices_nr, sizeof(Vector), size) ||
+            !isInFile(object.normals_offset, object.vertices_nr, sizeof(Vec4f), size) ||
+            !isInFile(object.is_irit_normal_offset, object.vertices_nr, 1, size) ||
+            !isInFile(object.indices_offset, object.indices_nr, sizeof(int), size) ||
+            !isInFile(object.polygons_offset, object.polygons_nr, sizeof(CachePolygon), size) ||
+            !isInFile(object.wire_vertices_offset, object.wire_vertices_nr, sizeof(int), size) ||
+            !isInFile(object.edges_offset, object.edges_nr, 2 * sizeof(int), size))
+            return false;
+
+        const CachePolygon *polygons = (const CachePolygon *)(data + object.polygons_offset);
+        const int *indices = (const int *)(data + object.indices_offset);
+
+        // Polygons and their normals are drawn through the indices without checking them
+        for (int j = 0; j < object.indices_nr; j++) {
+            if (indices[j] < 0 || indices[j] >= object.vertices_nr)
+                return false;
+        }
+
+        for (int j = 0; j < object.polygons_nr; j++) {
+            if (polygons[j].first_index < 0 || polygons[j].points_nr < 0 ||
+                polygons[j].first_index > object.indices_nr - polygons[j].points_nr)
+                return false;
+        }
+
+        // The edges are drawn without checking the vertices they point to
+        const int *wire_vertices = (const int *)(data + object.wire_vertices_offset);
+        const int *edges = (const int *)(data + object.edges_offset);
+
+        for (int j = 0; j < object.wire_vertices_nr; j++) {
+            if (wire_vertices[j] < 0 || wire_vertices[j] >= object.vertices_nr)
+                return false;
+        }
+
+        for (int j = 0; j < 2 * object.edges_nr; j++) {
+            if (edges[j] < 0 || edges[j] >= object.wire_vertices_nr)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+bool MeshCache::Open(const MeshCacheKey &key)
+{
+    m_file.reset(new MappedFile());
+
+    if (!m_file->Open(getCachePath(key).c_str()) || !Validate(key)) {
+        m_file.reset();
+        return false;
+    }
+
+    return true;
+}
+
+void MeshCache::Attach(IritFigure &figure)
+{
+    const char *data = m_file->getData();
+    const CacheHeader *header = (const CacheHeader *)data;
+    const CacheObject *objects = (const CacheObject *)(data + header->objects_offset);
+
+    for (unsigned int i = 0; i < header->objects_nr; i++) {
+        const CacheObject &cache_object = objects[i];
+        const CachePolygon *polygons = (const CachePolygon *)(data + cache_object.polygons_offset);
+        IritObject *object = figure.createObject();
+
+        object->object_color = {cache_object.color[0], cache_object.color[1],
+                                cache_object.color[2], 0};
+        object->attachBuffers((const Vector *)(data + cache_object.positions_offset),
+                              (const Vec4f *)(data + cache_object.normals_offset),
+                              (const unsigned char *)(data + cache_object.is_irit_normal_offset),
+                              cache_object.vertices_nr,
+                              (const int *)(data + cache_object.indices_offset),
+                              cache_object.indices_nr);
+        if (cache_object.wire_vertices_nr > 0)
+            object->attachEdges((const int *)(data + cache_object.wire_vertices_offset),
+                                cache_object.wire_vertices_nr,
+                                (const int *)(data + cache_object.edges_offset), cache_object.edges_nr);
+
+        for (int j = 0; j < cache_object.polygons_nr; j++) {
+            const CachePolygon &cache_polygon = polygons[j];
+            IritPolygon *polygon =
+                object->createPolygon(cache_polygon.first_index, cache_polygon.points_nr);
+            const double *start = cache_polygon.normal_start, *end = cache_polygon.normal_end;
+
+            polygon->is_irit_normal = cache_polygon.is_irit_normal != 0;
+            polygon->normal_start = Vector(start[0], start[1], start[2], start[3]);
+            polygon->normal_end = Vector(end[0], end[1], end[2], end[3]);
+        }
+    }
+
+    figure.min_bound_coord = Vector(header->min_bound[0], header->min_bound[1],
+                                    header->min_bound[2], header->min_bound[3]);
+    figure.max_bound_coord = Vector(header->max_bound[0], header->max_bound[1],
+                                    header->max_bound[2], header->max_bound[3]);
+
+    figure.attachMappedFile(std::move(m_file));
+}
@@ -0,0 +1,69 @@
+#ifndef __MESH_CACHE_H__
+#define __MESH_CACHE_H__
+
+/* Header file for the mesh cache */
+
+#include <memory>
+#include <string>
+#include "IritObjects.h"
+#include "MappedFile.h"
+
+// Bumped whenever the layout of the cache files changes
+#define MESH_CACHE_VERSION 2
+
+// What a cache is valid for - it is stale if any of them changes
+struct MeshCacheKey
+{
+    std::string path;
+    long long size;
+    long long modification_time;
+    double fineness;
+
+    /* Fills the key with the size and modification time of @path.
+     * returns false if the file doesn't exist
+     */
+    bool FromFile(const char *file_path, double file_fineness);
+};
+
+/* A binary cache of a loaded figure.
+ *
+ * After a file is loaded, the vertex buffers, polygons, edges, colors and
+ * bounds of its figure are written, with the layout they have in memory, to
+ * a cache file in the temporary directory. The next time the same file is
+ * loaded (and it wasn't modified since), the cache is mapped and the
+ * figure's objects use its buffers directly, so nothing is parsed, welded
+ * or copied, and loading costs about as much as reading the file.
+ *
+ * A cache file starts with a header that holds its key, followed by a
+ * table of objects and the buffers of each object, every buffer aligned
+ * to MESH_CACHE_ALIGNMENT bytes.
+ */
+class MeshCache
+{
+    std::unique_ptr<MappedFile> m_file;
+
+    // Checks that the mapped file is a complete cache of @key
+    bool Validate(const MeshCacheKey &key) const;
+
+public:
+    // Where the cache of @key is kept
+    static std::string getCachePath(const MeshCacheKey &key);
+
+    /* Writes the cache of @figure, which was loaded from the file of @key.
+     * The file is written under a temporary name and renamed, so a cache
+     * is never seen half written. returns false if it couldn't be written
+     */
+    static bool Write(const MeshCacheKey &key, IritFigure &figure);
+
+    /* Maps the cache of @key. returns false if there is none, or if it is
+     * stale or damaged
+     */
+    bool Open(const MeshCacheKey &key);
+
+    /* Creates the cached objects in @figure, which should be empty, and
+     * hands it the mapping. Must be called after a successful Open()
+     */
+    void Attach(IritFigure &figure);
+};
+
+#endif // __MESH_CACHE_H__
@@ -0,0 +1,236 @@
+/* Testing the mesh cache.
+ *
+ * Builds a figure the way the loader does, writes its cache, maps it back
+ * and compares every buffer, then checks that stale and damaged caches
+ * are rejected. Link with MeshCache.cpp, MappedFile.cpp, IritObjects.cpp,
+ * LineBands.cpp, WorkStealingPool.cpp, Matrix.cpp, Quaternion.cpp and
+ * Arena.cpp.
+ */
+
+#include "MeshCache.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+using namespace std;
+
+#define SOURCE_FILE_NAME "MeshCacheTest.itd"
+#define OBJECTS_NR 100
+#define POLYGONS_PER_OBJECT 5000
+#define POINTS_PER_POLYGON 4
+#define FINENESS 20.0
+
+typedef chrono::steady_clock Clock;
+
+static double millisecondsSince(Clock::time_point start)
+{
+	return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+static void buildFigure(IritFigure &figure)
+{
+	// Welded vertices of the points: a strip of quads, each sharing an edge with the next
+	vector<int> point_vertices;
+
+	for (int j = 0; j < POLYGONS_PER_OBJECT; j++) {
+		int strip_vertices[POINTS_PER_POLYGON] = {2 * j, 2 * j + 1, 2 * j + 3, 2 * j + 2};
+
+		point_vertices.insert(point_vertices.end(), strip_vertices, strip_vertices + POINTS_PER_POLYGON);
+	}
+
+	for (int i = 0; i < OBJECTS_NR; i++) {
+		IritObject *object = figure.createObject();
+
+		object->object_color = {(BYTE)i, 0, (BYTE)(255 - i), 0};
+		object->reserveVertices(POLYGONS_PER_OBJECT * POINTS_PER_POLYGON);
+
+		for (int j = 0; j < POLYGONS_PER_OBJECT; j++) {
+			IritPolygon *polygon = object->createPolygon();
+
+			polygon->is_irit_normal = j % 2 == 0;
+			polygon->normal_start = Vector(i, j, 0, 1);
+			polygon->normal_end = Vector(i, j, 0.3, 1);
+
+			for (int k = 0; k < POINTS_PER_POLYGON; k++) {
+				IritPoint point;
+
+				point.vertex = Vector(i + k * 0.25, j * 0.001, k * 0.5, 1);
+				point.normal = Vector(0, k % 2, 1, 1);
+				point.is_irit_normal = k == 0;
+				polygon->addPoint(point);
+			}
+		}
+
+		object->buildEdges(point_vertices.data(), 2 * POLYGONS_PER_OBJECT + 2);
+	}
+
+	figure.min_bound_coord = Vector(0, 0, 0, 1);
+	figure.max_bound_coord = Vector(OBJECTS_NR, POLYGONS_PER_OBJECT * 0.001, 1.5, 1);
+}
+
+static bool sameFigures(IritFigure &a, IritFigure &b)
+{
+	if (a.getObjectsNr() != b.getObjectsNr())
+		return false;
+
+	for (int i = 0; i < a.getObjectsNr(); i++) {
+		IritObject &x = a.getObject(i), &y = b.getObject(i);
+		int vertices_nr = x.getVerticesNr();
+
+		if (vertices_nr != y.getVerticesNr() || x.getIndicesNr() != y.getIndicesNr() ||
+			x.getPolygonsNr() != y.getPolygonsNr() ||
+			memcmp(&x.object_color, &y.object_color, sizeof(RGBQUAD)) != 0 ||
+			memcmp(x.getPositions(), y.getPositions(), vertices_nr * sizeof(Vector)) != 0 ||
+			memcmp(x.getNormals(), y.getNormals(), vertices_nr * sizeof(Vec4f)) != 0 ||
+			memcmp(x.getIsIritNormal(), y.getIsIritNormal(), vertices_nr) != 0 ||
+			memcmp(x.getIndices(), y.getIndices(), x.getIndicesNr() * sizeof(int)) != 0 ||
+			x.getWireVerticesNr() != y.getWireVerticesNr() || x.getEdgesNr() != y.getEdgesNr() ||
+			memcmp(x.getWireVertices(), y.getWireVertices(), x.getWireVerticesNr() * sizeof(int)) != 0 ||
+			memcmp(x.getEdges(), y.getEdges(), x.getEdgesNr() * 2 * sizeof(int)) != 0)
+			return false;
+
+		for (int j = 0; j < x.getPolygonsNr(); j++) {
+			IritPolygon &p = x.getPolygon(j), &q = y.getPolygon(j);
+
+			if (p.getFirstIndex() != q.getFirstIndex() || p.getPointsNr() != q.getPointsNr() ||
+				p.is_irit_normal != q.is_irit_normal)
+				return false;
+
+			for (int k = 0; k < 4; k++) {
+				if (p.normal_start[k] != q.normal_start[k] || p.normal_end[k] != q.normal_end[k])
+					return false;
+			}
+		}
+	}
+
+	for (int k = 0; k < 4; k++) {
+		if (a.min_bound_coord[k] != b.min_bound_coord[k] ||
+			a.max_bound_coord[k] != b.max_bound_coord[k])
+			return false;
+	}
+
+	return true;
+}
+
+static void writeSource(const char *text)
+{
+	FILE *file = fopen(SOURCE_FILE_NAME, "wb");
+
+	fputs(text, file);
+	fclose(file);
+}
+
+int main()
+{
+	bool passed = true;
+	MeshCacheKey key;
+	MeshCache cache;
+	IritWorld world;
+
+	writeSource("[OBJECT A [POLYGON 3 [0 0 0] [1 0 0] [0 1 0]]]\n");
+	key.FromFile(SOURCE_FILE_NAME, FINENESS);
+
+	Clock::time_point start = Clock::now();
+	IritFigure *figure = world.createFigure();
+	buildFigure(*figure);
+	double build_time = millisecondsSince(start);
+
+	// Four edges per quad, less the ones the quads share
+	bool shared_once = true;
+	for (int i = 0; i < OBJECTS_NR; i++)
+		shared_once &= figure->getObject(i).getEdgesNr() == 3 * POLYGONS_PER_OBJECT + 1;
+	cout << "Shared edges listed once: " << (shared_once ? "passed" : "FAILED") << endl;
+	passed &= shared_once;
+
+	start = Clock::now();
+	bool written = MeshCache::Write(key, *figure);
+	double write_time = millisecondsSince(start);
+
+	start = Clock::now();
+	bool opened = cache.Open(key);
+	IritFigure *cached_figure = world.createFigure();
+	if (opened)
+		cache.Attach(*cached_figure);
+	double open_time = millisecondsSince(start);
+
+	bool same = written && opened && sameFigures(*figure, *cached_figure);
+	cout << "Cached figure same as built: " << (same ? "passed" : "FAILED") << endl;
+	passed &= same;
+
+	bool read_only = !cached_figure->getObject(0).addPoint(cached_figure->getObject(0).getPolygon(0),
+															 IritPoint());
+	cout << "Points can't be added to cached objects: " << (read_only ? "passed" : "FAILED") << endl;
+	passed &= read_only;
+
+	cout << endl
+		 << OBJECTS_NR * POLYGONS_PER_OBJECT << " polygons: built in " << build_time
+		 << " ms, cache written in " << write_time << " ms, mapped in " << open_time << " ms"
+		 << endl
+		 << endl;
+
+	// Any change to the key makes the cache stale
+	MeshCacheKey other_key = key;
+	other_key.fineness = FINENESS * 2;
+	bool stale = !cache.Open(other_key);
+
+	other_key = key;
+	other_key.modification_time++;
+	stale &= !cache.Open(other_key);
+
+	writeSource("[OBJECT A [POLYGON 3 [0 0 0] [1 0 0] [0 1 0]]] # Now longer\n");
+	other_key.FromFile(SOURCE_FILE_NAME, FINENESS);
+	stale &= !cache.Open(other_key);
+
+	cout << "Stale caches rejected: " << (stale ? "passed" : "FAILED") << endl;
+	passed &= stale;
+
+	// An index past the vertices. The mapped figure goes first, since Windows can't write a mapped file
+	world.removeLastFigure();
+	string cache_path = MeshCache::getCachePath(key);
+	IritObject &first_object = figure->getObject(0);
+	const char *indices = (const char *)first_object.getIndices();
+	size_t indices_size = first_object.getIndicesNr() * sizeof(int);
+	vector<char> contents;
+
+	MeshCache::Write(key, *figure);
+	FILE *file = fopen(cache_path.c_str(), "rb");
+	fseek(file, 0, SEEK_END);
+	contents.resize(ftell(file));
+	fseek(file, 0, SEEK_SET);
+	contents.resize(fread(contents.data(), 1, contents.size(), file));
+	fclose(file);
+
+	// The object's index buffer is written as it is in memory
+	char *cached_indices = search(contents.data(), contents.data() + contents.size(), indices,
+								  indices + indices_size);
+	bool damaged = cached_indices != contents.data() + contents.size();
+	if (damaged) {
+		int vertices_nr = first_object.getVerticesNr();
+
+		memcpy(cached_indices, &vertices_nr, sizeof(int));
+		file = fopen(cache_path.c_str(), "wb");
+		fwrite(contents.data(), 1, contents.size(), file);
+		fclose(file);
+		damaged = !cache.Open(key);
+	}
+
+	// A truncated cache
+	file = fopen(cache_path.c_str(), "wb");
+	fwrite(contents.data(), 1, 256, file);
+	fclose(file);
+
+	damaged &= !cache.Open(key);
+	cout << "Damaged cache rejected: " << (damaged ? "passed" : "FAILED") << endl;
+	passed &= damaged;
+
+	remove(cache_path.c_str());
+	remove(SOURCE_FILE_NAME);
+
+	cout << endl
+		 << (passed ? "All tests passed" : "Some tests FAILED") << endl;
+
+	return passed ? 0 : 1;
+}
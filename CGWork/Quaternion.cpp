@@ -0,0 +1,64 @@
+/* Implementation of the Quaternion class */
+
+#include "Quaternion.h"
+#include <iostream>
+#include <math.h>
+
+using std::cout;
+using std::endl;
+
+// Up to this half angle, sin and cos are replaced by their Taylor series
+#define QUATERNION_TAYLOR_LIMIT 0.125
+
+Quaternion Quaternion::FromAxisAngle(double ax, double ay, double az, double angle)
+{
+    double half = angle * 0.5;
+    double s, c;
+
+    /* Mouse drags rotate by small steps. For those, a few terms of the
+     * series are accurate to about 1e-10 (and Renormalize() takes care of
+     * the rest), so there's no need for the library's sin and cos.
+     */
+    if (fabs(half) < QUATERNION_TAYLOR_LIMIT) {
+        double half2 = half * half;
+
+        s = half * (1.0 - half2 / 6.0 * (1.0 - half2 / 20.0));
+        c = 1.0 - half2 / 2.0 * (1.0 - half2 / 12.0 * (1.0 - half2 / 30.0));
+    } else {
+        s = sin(half);
+        c = cos(half);
+    }
+
+    s /= sqrt(ax * ax + ay * ay + az * az);
+
+    return Quaternion(c, ax * s, ay * s, az * s);
+}
+
+Matrix Quaternion::ToMatrix() const
+{
+    double x2 = x + x, y2 = y + y, z2 = z + z;
+    double xx = x * x2, yy = y * y2, zz = z * z2;
+    double xy = x * y2, xz = x * z2, yz = y * z2;
+    double wx = w * x2, wy = w * y2, wz = w * z2;
+
+    Matrix result = Matrix::Identity();
+
+    result.array[0][0] = 1.0 - yy - zz;
+    result.array[0][1] = xy - wz;
+    result.array[0][2] = xz + wy;
+
+    result.array[1][0] = xy + wz;
+    result.array[1][1] = 1.0 - xx - zz;
+    result.array[1][2] = yz - wx;
+
+    result.array[2][0] = xz - wy;
+    result.array[2][1] = yz + wx;
+    result.array[2][2] = 1.0 - xx - yy;
+
+    return result;
+}
+
+void Quaternion::Print() const
+{
+    cout << "(" << w << ", " << x << ", " << y << ", " << z << ")" << endl;
+}
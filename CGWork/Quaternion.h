@@ -0,0 +1,75 @@
+#ifndef __QUATERNION_H__
+#define __QUATERNION_H__
+
+/* Header file for the quaternion class */
+
+#include "Matrix.h"
+
+/* A rotation quaternion w + xi + yj + zk.
+ *
+ * Rotations are composed by multiplying quaternions, which is cheaper than
+ * multiplying matrices and only drifts away from unit length (rather than
+ * away from orthonormality), so a single cheap Renormalize() keeps it
+ * a pure rotation. A Matrix is built from it only when it is needed.
+ */
+class Quaternion
+{
+public:
+    double w, x, y, z;
+
+    // The identity rotation
+    Quaternion() : w(1), x(0), y(0), z(0)
+    {
+    }
+
+    Quaternion(double w, double x, double y, double z) : w(w), x(x), y(y), z(z)
+    {
+    }
+
+    /* Returns the rotation by @angle radians about (@ax, @ay, @az).
+     * The axis doesn't have to be normalized, but musn't be zero.
+     */
+    static Quaternion FromAxisAngle(double ax, double ay, double az, double angle);
+
+    /* Composes two rotations - the result rotates by @other first and
+     * then by this
+     */
+    Quaternion operator*(const Quaternion &other) const
+    {
+        return Quaternion(w * other.w - x * other.x - y * other.y - z * other.z,
+                          w * other.x + x * other.w + y * other.z - z * other.y,
+                          w * other.y - x * other.z + y * other.w + z * other.x,
+                          w * other.z + x * other.y - y * other.x + z * other.w);
+    }
+
+    Quaternion &operator*=(const Quaternion &other)
+    {
+        return *this = *this * other;
+    }
+
+    double NormSquared() const
+    {
+        return w * w + x * x + y * y + z * z;
+    }
+
+    /* Pulls the quaternion back to unit length. It uses one Newton step
+     * of 1/sqrt(n) around n = 1, which is exact enough for the tiny drift
+     * left by a single multiplication and needs no square root.
+     */
+    void Renormalize()
+    {
+        double scale = (3.0 - NormSquared()) * 0.5;
+
+        w *= scale;
+        x *= scale;
+        y *= scale;
+        z *= scale;
+    }
+
+    // Returns the (affine) rotation matrix of a unit quaternion
+    Matrix ToMatrix() const;
+
+    void Print() const;
+};
+
+#endif // __QUATERNION_H__
@@ -0,0 +1,105 @@
+/** Testing the quaternion class **/
+
+#include <iostream>
+#include <math.h>
+#include "Quaternion.h"
+
+using std::cout;
+using std::endl;
+
+#define EPSILON 1e-9
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// The rotation matrix built directly with Rodrigues' formula
+Matrix rodrigues(double x, double y, double z, double angle)
+{
+    Vector axis = Vector(x, y, z, 1);
+    axis.Normalize();
+
+    double s = sin(angle), c = cos(angle);
+    Matrix m = Matrix::Identity();
+
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++)
+            m.array[i][j] = axis[i] * axis[j] * (1 - c) + ((i == j) ? c : 0);
+    }
+
+    m.array[0][1] -= axis[2] * s;
+    m.array[0][2] += axis[1] * s;
+    m.array[1][0] += axis[2] * s;
+    m.array[1][2] -= axis[0] * s;
+    m.array[2][0] -= axis[1] * s;
+    m.array[2][1] += axis[0] * s;
+
+    return m;
+}
+
+double maxDifference(const Matrix &a, const Matrix &b)
+{
+    double max_diff = 0;
+
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++)
+            max_diff = fmax(max_diff, fabs(a.array[i][j] - b.array[i][j]));
+    }
+
+    return max_diff;
+}
+
+bool check(const char *name, double difference, double epsilon)
+{
+    bool passed = difference < epsilon;
+
+    cout << name << ": " << (passed ? "passed" : "FAILED") << " (" << difference << ")" << endl;
+
+    return passed;
+}
+
+int main()
+{
+    bool passed = true;
+
+    cout << "Checking single rotations" << endl
+         << endl;
+
+    // Both small angles (series) and large ones (sin/cos)
+    double angles[] = { 0.001, 0.1, -0.24, 0.26, 1.0, 2.5, -M_PI };
+    for (double angle : angles) {
+        Quaternion q = Quaternion::FromAxisAngle(1, 2, 3, angle);
+        passed &= check("  rotation", maxDifference(q.ToMatrix(), rodrigues(1, 2, 3, angle)),
+                        EPSILON);
+    }
+
+    cout << endl
+         << "Checking composition" << endl
+         << endl;
+
+    Quaternion a = Quaternion::FromAxisAngle(1, 0, 0, 0.7);
+    Quaternion b = Quaternion::FromAxisAngle(0, 1, 1, -1.3);
+    passed &= check("  a * b", maxDifference((a * b).ToMatrix(),
+                                             rodrigues(1, 0, 0, 0.7) * rodrigues(0, 1, 1, -1.3)),
+                    EPSILON);
+
+    cout << endl
+         << "Checking a long drag" << endl
+         << endl;
+
+    // A million tiny steps, renormalized after each one like a mouse drag
+    Quaternion drag;
+    Quaternion step = Quaternion::FromAxisAngle(1, 1, 0, 1e-5);
+    for (int i = 0; i < 1000000; i++) {
+        drag = step * drag;
+        drag.Renormalize();
+    }
+
+    passed &= check("  norm", fabs(drag.NormSquared() - 1), EPSILON);
+    passed &= check("  angle", maxDifference(drag.ToMatrix(), rodrigues(1, 1, 0, 10.0)), 1e-6);
+
+    cout << endl
+         << (passed ? "All tests passed" : "Some tests FAILED") << endl;
+
+    return passed ? 0 : 1;
+}
@@ -39,6 +39,8 @@
 #define IDC_SENS						1043
 #define IDC_DISTANCE					1044
 #define IDC_FINENESS					1045
+#define IDC_TESSELLATION_MODE			1046
+#define IDC_TOLERANCE					1047
 #define ID_FILE_LOAD                    32771
 #define ID_VIEW_ORTHOGRAPHIC            32772
 #define ID_VIEW_PERSPECTIVE             32773
@@ -65,6 +67,7 @@
 #define ID_OBJECT_COLOR					32805
 #define ID_BG_COLOR						32806
 #define ID_NORMAL_COLOR					32807
+#define ID_VIEW_FRAME_STATS				32808
 
 // Next default values for new objects
 // 
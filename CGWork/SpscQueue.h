@@ -0,0 +1,108 @@
+#ifndef __SPSC_QUEUE_H__
+#define __SPSC_QUEUE_H__
+
+/* Header file for the single producer single consumer queue template */
+
+#include <atomic>
+#include <stddef.h>
+#include <thread>
+#include <vector>
+
+// Bytes between the consumer's and the producer's counters, so they don't share a cache line
+#define SPSC_QUEUE_CACHE_LINE_SIZE 64
+
+/* A bounded lock-free queue between two threads.
+ *
+ * One thread pushes and one thread pops. The elements are kept in a ring
+ * of a power of 2 slots, and each side only writes its own counter: the
+ * producer publishes an element by advancing the tail (with release
+ * semantics) after writing its slot, and the consumer frees a slot by
+ * advancing the head after reading it. Nothing is ever locked or
+ * allocated after construction.
+ *
+ * Push() and Pop() wait (yielding the processor) while the queue is full
+ * or empty, which is what makes the queue a back pressure between the
+ * stages of a pipeline.
+ */
+template <class T>
+class SpscQueue
+{
+    std::vector<T> m_slots;
+    size_t m_mask;
+
+    // Next slot to pop, written only by the consumer
+    std::atomic<size_t> m_head;
+    /* Keeps the counters on different cache lines. Padding rather than
+     * alignas, so that queues can be members of heap allocated objects
+     * without over-aligned new (C++17) */
+    char m_padding[SPSC_QUEUE_CACHE_LINE_SIZE];
+    // Next slot to push, written only by the producer
+    std::atomic<size_t> m_tail;
+
+public:
+    // @capacity is rounded up to a power of 2
+    explicit SpscQueue(size_t capacity) : m_head(0), m_tail(0)
+    {
+        size_t size = 1;
+
+        while (size < capacity)
+            size *= 2;
+
+        m_slots.resize(size);
+        m_mask = size - 1;
+    }
+
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    // Returns false if the queue is full. Producer only
+    bool TryPush(const T &value)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+
+        if (tail - m_head.load(std::memory_order_acquire) == m_slots.size())
+            return false;
+
+        m_slots[tail & m_mask] = value;
+        m_tail.store(tail + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // Returns false if the queue is empty. Consumer only
+    bool TryPop(T &value)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+
+        if (head == m_tail.load(std::memory_order_acquire))
+            return false;
+
+        value = m_slots[head & m_mask];
+        m_head.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    void Push(const T &value)
+    {
+        while (!TryPush(value))
+            std::this_thread::yield();
+    }
+
+    T Pop()
+    {
+        T value;
+
+        while (!TryPop(value))
+            std::this_thread::yield();
+
+        return value;
+    }
+
+    size_t getCapacity() const
+    {
+        return m_slots.size();
+    }
+};
+
+#endif // __SPSC_QUEUE_H__
@@ -0,0 +1,58 @@
+/** Testing the single producer single consumer queue **/
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include "SpscQueue.h"
+
+using namespace std;
+
+#define QUEUE_CAPACITY 8
+#define ELEMENTS_NR 10000000
+
+int main()
+{
+    bool passed = true;
+
+    // Bounds, from a single thread
+    SpscQueue<int> small_queue(5);
+    bool bounded = small_queue.getCapacity() == QUEUE_CAPACITY;
+    int value = 0;
+
+    for (int i = 0; i < QUEUE_CAPACITY; i++)
+        bounded &= small_queue.TryPush(i);
+    bounded &= !small_queue.TryPush(QUEUE_CAPACITY);
+    for (int i = 0; i < QUEUE_CAPACITY; i++)
+        bounded &= small_queue.TryPop(value) && value == i;
+    bounded &= !small_queue.TryPop(value);
+
+    cout << "Capacity rounded up, full and empty queues: " << (bounded ? "passed" : "FAILED") << endl;
+    passed &= bounded;
+
+    // Every element arrives once and in order, through a queue much smaller than the stream
+    SpscQueue<long long> queue(QUEUE_CAPACITY);
+    bool in_order = true;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    thread producer([&]() {
+        for (long long i = 0; i < ELEMENTS_NR; i++)
+            queue.Push(i);
+    });
+
+    for (long long i = 0; i < ELEMENTS_NR; i++)
+        in_order &= queue.Pop() == i;
+
+    producer.join();
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "Elements arrive in order between threads: " << (in_order ? "passed" : "FAILED") << endl;
+    passed &= in_order;
+
+    cout << endl
+         << ELEMENTS_NR / seconds / 1e6 << " million elements per second" << endl
+         << endl
+         << (passed ? "All tests passed" : "Some tests FAILED") << endl;
+
+    return passed ? 0 : 1;
+}
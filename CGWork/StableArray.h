@@ -0,0 +1,183 @@
+#ifndef __STABLE_ARRAY_H__
+#define __STABLE_ARRAY_H__
+
+/* Header file for the stable array template */
+
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "Arena.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/* A growable array whose elements never move.
+ *
+ * Elements are constructed in place inside chunks, and only the (small)
+ * table of chunks is reallocated when the array grows. The first chunk
+ * holds 2^FIRST_SHIFT elements and every chunk after it is twice as big
+ * as the previous one, so appending is amortized O(1), costs O(log n)
+ * allocations, and no more than half the memory is ever unused - just
+ * like std::vector. Unlike std::vector, pointers and references to
+ * elements stay valid for the lifetime of the array, so they can be used
+ * as handles.
+ *
+ * std::deque gives the same guarantees, but MSVC's implementation
+ * allocates every element larger than 8 bytes on its own.
+ *
+ * The chunks (and their table) can come from an arena, in which case
+ * they are freed with the arena rather than by the array (the elements
+ * are still destroyed by the array).
+ */
+template <class T, int FIRST_SHIFT = 4>
+class StableArray
+{
+    typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Storage;
+
+    std::vector<Storage *, ArenaAllocator<Storage *> > m_chunks;
+    int m_size;
+    Arena *m_arena;
+
+    // Index of the highest set bit of @value, which musn't be 0
+    static int HighestBit(unsigned int value)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanReverse(&index, value);
+        return (int)index;
+#else
+        return 31 - __builtin_clz(value);
+#endif
+    }
+
+    /* Element i is element i + 2^FIRST_SHIFT of a (virtual) array whose
+     * chunk k starts at 2^(FIRST_SHIFT + k)
+     */
+    T *Element(int i) const
+    {
+        unsigned int position = (unsigned int)i + (1u << FIRST_SHIFT);
+        int chunk = HighestBit(position) - FIRST_SHIFT;
+
+        return reinterpret_cast<T *>(&m_chunks[chunk][position - (1u << (FIRST_SHIFT + chunk))]);
+    }
+
+    static int ChunkSize(int chunk)
+    {
+        return 1 << (FIRST_SHIFT + chunk);
+    }
+
+public:
+    StableArray(Arena *arena = nullptr) : m_chunks(arena), m_size(0), m_arena(arena)
+    {
+    }
+
+    ~StableArray()
+    {
+        Clear();
+    }
+
+    // Elements are owned by the array and never move, so it isn't copyable
+    StableArray(const StableArray &) = delete;
+    StableArray &operator=(const StableArray &) = delete;
+
+    /* Constructs a new element at the end of the array with @args and
+     * returns a reference to it
+     */
+    template <class... Args>
+    T &EmplaceBack(Args &&... args)
+    {
+        // All the chunks are full exactly when m_size + 2^FIRST_SHIFT is a power of 2
+        if ((m_size + ChunkSize(0)) == ChunkSize((int)m_chunks.size())) {
+            int chunk_size = ChunkSize((int)m_chunks.size());
+
+            if (m_arena)
+                m_chunks.push_back(static_cast<Storage *>(
+                    m_arena->Allocate(chunk_size * sizeof(Storage), alignof(Storage))));
+            else
+                m_chunks.push_back(new Storage[chunk_size]);
+        }
+
+        T *element = Element(m_size);
+        new (element) T(std::forward<Args>(args)...);
+        m_size++;
+
+        return *element;
+    }
+
+    // Destroys the last element. Its chunk is kept for the next one
+    void PopBack()
+    {
+        m_size--;
+        Element(m_size)->~T();
+    }
+
+    // Destroys all the elements
+    void Clear()
+    {
+        for (int i = m_size - 1; i >= 0; i--)
+            Element(i)->~T();
+
+        if (!m_arena) {
+            for (int i = 0; i < (int)m_chunks.size(); i++)
+                delete[] m_chunks[i];
+        }
+
+        m_chunks.clear();
+        m_size = 0;
+    }
+
+    int Size() const
+    {
+        return m_size;
+    }
+
+    bool IsEmpty() const
+    {
+        return m_size == 0;
+    }
+
+    T &operator[](int i)
+    {
+        return *Element(i);
+    }
+
+    const T &operator[](int i) const
+    {
+        return *Element(i);
+    }
+
+    T &Back()
+    {
+        return *Element(m_size - 1);
+    }
+
+    /* Calls f(element) for every element, in order. This walks each chunk
+     * linearly, which is cheaper than indexing every element.
+     */
+    template <class F>
+    void ForEach(const F &f)
+    {
+        ForEachFirst(m_size, f);
+    }
+
+    // Like ForEach(), for the first @count elements only
+    template <class F>
+    void ForEachFirst(int count, const F &f)
+    {
+        int left = count;
+
+        for (int chunk = 0; left > 0; chunk++) {
+            T *elements = reinterpret_cast<T *>(m_chunks[chunk]);
+            int chunk_count = (left < ChunkSize(chunk)) ? left : ChunkSize(chunk);
+
+            for (int i = 0; i < chunk_count; i++)
+                f(elements[i]);
+
+            left -= chunk_count;
+        }
+    }
+};
+
+#endif // __STABLE_ARRAY_H__
@@ -0,0 +1,661 @@
+#ifndef __VECMAT_H__
+#define __VECMAT_H__
+
+/* Header file for the fixed size vector and matrix templates.
+ *
+ * Vec<N, T> is an N dimensional homogeneous vector - its last coordinate is
+ * the homogeneous one (w), and arithmetics only act on the first N - 1
+ * coordinates. Mat<N, T> is an NxN matrix of the same type.
+ *
+ * Both are trivially copyable, so arrays of them can be copied with memcpy
+ * and handed to the batch transforms as plain arrays of T.
+ *
+ * Vector and Matrix are the double precision 4D instantiations. The float
+ * ones (Vec4f, Mat4f) fit twice as many coordinates in every SIMD register.
+ *
+ * Arithmetic operators don't compute anything - they return a small
+ * expression object which is evaluated, one coordinate at a time, only
+ * when it is assigned to a Vec or a Mat. That way an expression such as
+ * a + b * s is computed in a single loop and without temporary vectors.
+ * Expressions hold references to their operands, so they must be assigned
+ * before the end of the statement that creates them.
+ */
+
+#include <exception>
+#include <iostream>
+#include <math.h>
+#include <type_traits>
+
+template <int N, class T> class Vec;
+template <int N, class T> class Mat;
+
+// Keeps a function parameter out of template argument deduction
+template <class T>
+struct NonDeduced
+{
+    typedef T type;
+};
+
+/* Calls f(I), f(I + 1), ..., f(N - 1), unrolled at compile time so that
+ * every index is a constant once f is inlined.
+ */
+template <int I, int N>
+struct Unroll
+{
+    template <class F>
+    static void Run(const F &f)
+    {
+        f(I);
+        Unroll<I + 1, N>::Run(f);
+    }
+};
+
+template <int N>
+struct Unroll<N, N>
+{
+    template <class F>
+    static void Run(const F &)
+    {
+    }
+};
+
+/* Base of all vector expressions.
+ * @E - the expression type, which implements Coord(i)
+ */
+template <class E, int N, class T>
+class VecExpr
+{
+public:
+    constexpr const E &Self() const
+    {
+        return static_cast<const E &>(*this);
+    }
+
+    // Coordinate i of the expression's result
+    constexpr T Coord(int i) const
+    {
+        return Self().Coord(i);
+    }
+};
+
+/* Base of all matrix expressions.
+ * @E - the expression type, which implements Coeff(i, j)
+ */
+template <class E, int N, class T>
+class MatExpr
+{
+public:
+    constexpr const E &Self() const
+    {
+        return static_cast<const E &>(*this);
+    }
+
+    // Entry (i, j) of the expression's result
+    constexpr T Coeff(int i, int j) const
+    {
+        return Self().Coeff(i, j);
+    }
+};
+
+template <int N, class T>
+class Vec : public VecExpr<Vec<N, T>, N, T>
+{
+public:
+    T coordinates[N];
+
+    // default vector. all zeros
+    constexpr Vec() : coordinates() {}
+
+    // Ctor an init value. W is set to 1
+    constexpr Vec(T value) : coordinates()
+    {
+        for (int i = 0; i < N - 1; i++)
+        {
+            coordinates[i] = value;
+        }
+
+        // Keep vector homogenized
+        coordinates[N - 1] = 1;
+    }
+
+    // Ctor for values for all indices (4D vectors only)
+    constexpr Vec(T x, T y, T z, T w = 1) : coordinates{x, y, z, w} {}
+
+    // Evaluate a vector expression
+    template <class E>
+    Vec(const VecExpr<E, N, T> &expr)
+    {
+        Unroll<0, N>::Run([&](int i) { coordinates[i] = expr.Coord(i); });
+    }
+
+    // Convert a vector of another precision
+    template <class U>
+    constexpr explicit Vec(const Vec<N, U> &vec) : coordinates()
+    {
+        for (int i = 0; i < N; i++)
+        {
+            coordinates[i] = (T)vec.coordinates[i];
+        }
+    }
+
+    // Evaluate a vector expression. Coordinate i of an expression only reads
+    // coordinate i of its operands, so the result can be written in place
+    template <class E>
+    Vec &operator=(const VecExpr<E, N, T> &expr)
+    {
+        Unroll<0, N>::Run([&](int i) { coordinates[i] = expr.Coord(i); });
+        return *this;
+    }
+
+    constexpr T Coord(int i) const
+    {
+        return coordinates[i];
+    }
+
+    // Multiply each part of the vector with a constant
+    constexpr void operator*=(T param)
+    {
+        for (int i = 0; i < N - 1; i++)
+        {
+            coordinates[i] *= param;
+        }
+
+        // W shouldnt be affected by constant multiplication.
+    }
+
+    // Vector addition
+    template <class E>
+    constexpr void operator+=(const VecExpr<E, N, T> &vec)
+    {
+        for (int i = 0; i < N - 1; i++)
+        {
+            coordinates[i] += vec.Coord(i);
+        }
+
+        // W isn't affected;
+    }
+
+    // Vector subtraction
+    template <class E>
+    constexpr void operator-=(const VecExpr<E, N, T> &vec)
+    {
+        for (int i = 0; i < N - 1; i++)
+        {
+            coordinates[i] -= vec.Coord(i);
+        }
+
+        // W isn't affected;
+    }
+
+    // Vector comperator
+    constexpr bool operator==(const Vec &vec) const
+    {
+        for (int i = 0; i < N; i++)
+        {
+            if (coordinates[i] != vec.coordinates[i])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Vector array index
+    constexpr T &operator[](int index)
+    {
+        return coordinates[index];
+    }
+
+    constexpr T operator[](int index) const
+    {
+        return coordinates[index];
+    }
+
+    // Normalize the vector. Doesn't affect W
+    void Normalize()
+    {
+        T norm = 0;
+
+        for (int i = 0; i < N - 1; i++)
+        {
+            norm += coordinates[i] * coordinates[i];
+        }
+        norm = (T)sqrt(norm);
+
+        if (norm != 0)
+        {
+            for (int i = 0; i < N - 1; i++)
+            {
+                coordinates[i] /= norm;
+            }
+        }
+    }
+
+    // Homogenize the vector
+    constexpr void Homogenize()
+    {
+        T w = coordinates[N - 1];
+
+        if (w != 0)
+        {
+            for (int i = 0; i < N - 1; i++)
+            {
+                coordinates[i] /= w;
+            }
+
+            coordinates[N - 1] = 1;
+        }
+    }
+
+    // Print the vector - for debug purposes
+    void Print() const
+    {
+        std::cout << "<";
+        for (int i = 0; i < N; i++)
+        {
+            std::cout << coordinates[i] << ", ";
+        }
+        std::cout << ">" << std::endl;
+    }
+};
+
+template <int N, class T>
+class Mat : public MatExpr<Mat<N, T>, N, T>
+{
+public:
+    T array[N][N];
+
+    // Ctor with an init value
+    constexpr Mat(T value = 0) : array()
+    {
+        for (int i = 0; i < N; i++)
+        {
+            for (int j = 0; j < N; j++)
+            {
+                array[i][j] = value;
+            }
+        }
+    }
+
+    // Ctor for values for all indices
+    constexpr Mat(const T (&matrix)[N][N]) : array()
+    {
+        for (int i = 0; i < N; i++)
+        {
+            for (int j = 0; j < N; j++)
+            {
+                array[i][j] = matrix[i][j];
+            }
+        }
+    }
+
+    /* Create a matrix out of four vector.
+     * @vi - the vector in row i
+     */
+    constexpr Mat(const Vec<N, T> &v1, const Vec<N, T> &v2, const Vec<N, T> &v3,
+                  const Vec<N, T> &v4) : array()
+    {
+        for (int i = 0; i < N; i++)
+        {
+            array[0][i] = v1[i];
+            array[1][i] = v2[i];
+            array[2][i] = v3[i];
+            array[3][i] = v4[i];
+        }
+    }
+
+    /* Create a matrix out of three vector.
+     * The fourth vector is (0 0 0 1)
+     * @vi - the vector in row i
+     */
+    constexpr Mat(const Vec<N, T> &v1, const Vec<N, T> &v2, const Vec<N, T> &v3)
+        : Mat(v1, v2, v3, Vec<N, T>(0, 0, 0, 1))
+    {
+    }
+
+    // Evaluate a matrix expression
+    template <class E>
+    Mat(const MatExpr<E, N, T> &expr)
+    {
+        Unroll<0, N>::Run([&](int i) {
+            Unroll<0, N>::Run([&](int j) { array[i][j] = expr.Coeff(i, j); });
+        });
+    }
+
+    // Convert a matrix of another precision
+    template <class U>
+    constexpr explicit Mat(const Mat<N, U> &matrix) : array()
+    {
+        for (int i = 0; i < N; i++)
+        {
+            for (int j = 0; j < N; j++)
+            {
+                array[i][j] = (T)matrix.array[i][j];
+            }
+        }
+    }
+
+    // Evaluate a matrix expression. The result is gathered aside first,
+    // so the expression may read this matrix (as in m = m * n)
+    template <class E>
+    Mat &operator=(const MatExpr<E, N, T> &expr)
+    {
+        Mat result(expr);
+
+        *this = result;
+        return *this;
+    }
+
+    constexpr T Coeff(int i, int j) const
+    {
+        return array[i][j];
+    }
+
+    constexpr void operator*=(T param)
+    {
+        for (int i = 0; i < N; i++)
+        {
+            for (int j = 0; j < N; j++)
+            {
+                array[i][j] *= param;
+            }
+        }
+    }
+
+    // Return the transpose the matrix
+    constexpr Mat Transpose() const
+    {
+        Mat matrix;
+
+        for (int i = 0; i < N; i++)
+        {
+            for (int j = 0; j < N; j++)
+            {
+                matrix.array[i][j] = array[j][i];
+            }
+        }
+
+        return matrix;
+    }
+
+    // Return an identity matrix
+    static constexpr Mat Identity()
+    {
+        Mat matrix;
+
+        for (int i = 0; i < N; i++)
+        {
+            matrix.array[i][i] = 1;
+        }
+
+        return matrix;
+    }
+
+    /* Multiply every point of a contiguous array by the matrix in one pass.
+     * Points are stored as N coordinates each. Uses AVX or SSE2 when
+     * the compiler targets them, and a scalar loop otherwise.
+     * Implemented for 4x4 double and float matrices (Matrix.cpp).
+     * @in - the points to transform
+     * @out - where to store the result (may be the same array as @in)
+     * @count - number of points in the array
+     * @homogenize - also divide each result by its w coordinate
+     */
+    void TransformArray(const T *in, T *out, int count, bool homogenize = false) const;
+
+    // Same as TransformArray, for an array of vectors
+    void TransformVectors(const Vec<N, T> *in, Vec<N, T> *out, int count,
+                          bool homogenize = false) const
+    {
+        TransformArray(in->coordinates, out->coordinates, count, homogenize);
+    }
+
+    // The following are implemented for 4x4 double matrices (Matrix.cpp)
+
+    // Calculate the determinant of the Matrix
+    T Determinant() const;
+
+    // Return the adjoint of the matrix
+    Mat Adjoint() const;
+
+    // The way Inverse() computes the inverse
+    enum InverseType {
+        INVERSE_AUTO,    // Pick the cheapest method that fits the matrix
+        INVERSE_GENERAL, // Any reversible matrix
+        INVERSE_AFFINE,  // Last row is (0 0 0 1)
+        INVERSE_RIGID    // Rotation and translation only
+    };
+
+    // Return the inverse of the matrix
+    Mat Inverse(InverseType type = INVERSE_AUTO) const;
+
+    // Whether the last row of the matrix is (0 0 0 1)
+    bool IsAffine() const;
+
+    // Whether the matrix is affine and its upper 3x3 block is orthonormal
+    bool IsRigid() const;
+
+    // Print the matrix - for debug purposes
+    void Print() const
+    {
+        for (int i = 0; i < N; i++)
+        {
+            std::cout << "<";
+            for (int j = 0; j < N; j++)
+            {
+                std::cout << array[i][j] << " ";
+            }
+            std::cout << ">" << std::endl;
+        }
+    }
+
+    class MatrixNotReversible : public std::exception{};
+};
+
+/* How an expression keeps its operand. Cheap expressions are kept by
+ * reference and recomputed for every coordinate, while a product is
+ * evaluated once into a matrix - recomputing it for every entry of an
+ * outer product would cost more than the temporary saves.
+ */
+template <class E>
+struct ExprOperand
+{
+    typedef const E &type;
+};
+
+// Vector addition. W of the result is 1
+template <class L, class R, int N, class T>
+class VecSum : public VecExpr<VecSum<L, R, N, T>, N, T>
+{
+    const L &m_left;
+    const R &m_right;
+
+public:
+    constexpr VecSum(const L &left, const R &right) : m_left(left), m_right(right) {}
+
+    constexpr T Coord(int i) const
+    {
+        return (i == N - 1) ? 1 : m_left.Coord(i) + m_right.Coord(i);
+    }
+};
+
+// Vector subtraction. W of the result is 0
+template <class L, class R, int N, class T>
+class VecDiff : public VecExpr<VecDiff<L, R, N, T>, N, T>
+{
+    const L &m_left;
+    const R &m_right;
+
+public:
+    constexpr VecDiff(const L &left, const R &right) : m_left(left), m_right(right) {}
+
+    constexpr T Coord(int i) const
+    {
+        return (i == N - 1) ? 0 : m_left.Coord(i) - m_right.Coord(i);
+    }
+};
+
+// Multiply each part of the vector with a constant. W of the result is 1
+template <class E, int N, class T>
+class VecScale : public VecExpr<VecScale<E, N, T>, N, T>
+{
+    const E &m_vec;
+    T m_param;
+
+public:
+    constexpr VecScale(const E &vec, T param) : m_vec(vec), m_param(param) {}
+
+    constexpr T Coord(int i) const
+    {
+        return (i == N - 1) ? 1 : m_vec.Coord(i) * m_param;
+    }
+};
+
+/* Multiply a matrix and a vector. The vector is evaluated once, since every
+ * coordinate of the result reads all of its coordinates (this also makes
+ * v = m * v safe).
+ */
+template <class M, int N, class T>
+class MatVecProduct : public VecExpr<MatVecProduct<M, N, T>, N, T>
+{
+    typename ExprOperand<M>::type m_matrix;
+    Vec<N, T> m_vec;
+
+public:
+    template <class E>
+    constexpr MatVecProduct(const M &matrix, const VecExpr<E, N, T> &vec)
+        : m_matrix(matrix), m_vec(vec) {}
+
+    T Coord(int i) const
+    {
+        T sum = 0;
+
+        Unroll<0, N>::Run([&](int j) { sum += m_matrix.Coeff(i, j) * m_vec.coordinates[j]; });
+        return sum;
+    }
+};
+
+// Multiply each part of the matrix with a constant
+template <class E, int N, class T>
+class MatScale : public MatExpr<MatScale<E, N, T>, N, T>
+{
+    typename ExprOperand<E>::type m_matrix;
+    T m_param;
+
+public:
+    constexpr MatScale(const E &matrix, T param) : m_matrix(matrix), m_param(param) {}
+
+    constexpr T Coeff(int i, int j) const
+    {
+        return m_matrix.Coeff(i, j) * m_param;
+    }
+};
+
+// Multiply 2 matrices
+template <class L, class R, int N, class T>
+class MatProduct : public MatExpr<MatProduct<L, R, N, T>, N, T>
+{
+    typename ExprOperand<L>::type m_left;
+    typename ExprOperand<R>::type m_right;
+
+public:
+    constexpr MatProduct(const L &left, const R &right) : m_left(left), m_right(right) {}
+
+    T Coeff(int i, int j) const
+    {
+        T sum = 0;
+
+        Unroll<0, N>::Run([&](int k) { sum += m_left.Coeff(i, k) * m_right.Coeff(k, j); });
+        return sum;
+    }
+};
+
+template <class L, class R, int N, class T>
+struct ExprOperand<MatProduct<L, R, N, T> >
+{
+    typedef Mat<N, T> type;
+};
+
+// Vector operators
+
+template <class L, class R, int N, class T>
+constexpr VecSum<L, R, N, T> operator+(const VecExpr<L, N, T> &left, const VecExpr<R, N, T> &right)
+{
+    return VecSum<L, R, N, T>(left.Self(), right.Self());
+}
+
+template <class L, class R, int N, class T>
+constexpr VecDiff<L, R, N, T> operator-(const VecExpr<L, N, T> &left, const VecExpr<R, N, T> &right)
+{
+    return VecDiff<L, R, N, T>(left.Self(), right.Self());
+}
+
+template <class E, int N, class T>
+constexpr VecScale<E, N, T> operator*(const VecExpr<E, N, T> &vec, typename NonDeduced<T>::type param)
+{
+    return VecScale<E, N, T>(vec.Self(), param);
+}
+
+// Dot multiplication of two vectors. W shouldnt affect dot product
+template <class L, class R, int N, class T>
+constexpr T operator*(const VecExpr<L, N, T> &left, const VecExpr<R, N, T> &right)
+{
+    T sum = 0;
+
+    for (int i = 0; i < N - 1; i++)
+    {
+        sum += left.Coord(i) * right.Coord(i);
+    }
+    return sum;
+}
+
+// Cross multiplication of two vectors (of the first three coordinates)
+template <class L, class R, int N, class T>
+constexpr Vec<N, T> operator^(const VecExpr<L, N, T> &left, const VecExpr<R, N, T> &right)
+{
+    Vec<N, T> a(left), b(right);
+    Vec<N, T> cross = Vec<N, T>();
+
+    cross.coordinates[0] = (a.coordinates[1] * b.coordinates[2])
+                         - (a.coordinates[2] * b.coordinates[1]);
+    cross.coordinates[1] = (a.coordinates[2] * b.coordinates[0])
+                         - (a.coordinates[0] * b.coordinates[2]);
+    cross.coordinates[2] = (a.coordinates[0] * b.coordinates[1])
+                         - (a.coordinates[1] * b.coordinates[0]);
+
+    return cross;
+}
+
+// Matrix operators
+
+template <class E, int N, class T>
+constexpr MatScale<E, N, T> operator*(const MatExpr<E, N, T> &matrix, typename NonDeduced<T>::type param)
+{
+    return MatScale<E, N, T>(matrix.Self(), param);
+}
+
+template <class L, class R, int N, class T>
+constexpr MatProduct<L, R, N, T> operator*(const MatExpr<L, N, T> &left, const MatExpr<R, N, T> &right)
+{
+    return MatProduct<L, R, N, T>(left.Self(), right.Self());
+}
+
+template <class M, class E, int N, class T>
+constexpr MatVecProduct<M, N, T> operator*(const MatExpr<M, N, T> &matrix, const VecExpr<E, N, T> &vec)
+{
+    return MatVecProduct<M, N, T>(matrix.Self(), vec);
+}
+
+typedef Vec<4, float> Vec4f;
+typedef Vec<4, double> Vec4d;
+typedef Mat<4, float> Mat4f;
+typedef Mat<4, double> Mat4d;
+
+// The batch transforms treat arrays of these as arrays of coordinates
+static_assert(sizeof(Vec4f) == 4 * sizeof(float), "Vec4f must be packed");
+static_assert(sizeof(Vec4d) == 4 * sizeof(double), "Vec4d must be packed");
+static_assert(std::is_trivially_copyable<Vec4f>::value, "Vec4f must be trivially copyable");
+static_assert(std::is_trivially_copyable<Vec4d>::value, "Vec4d must be trivially copyable");
+static_assert(std::is_trivially_copyable<Mat4f>::value, "Mat4f must be trivially copyable");
+static_assert(std::is_trivially_copyable<Mat4d>::value, "Mat4d must be trivially copyable");
+
+#endif // __VECMAT_H__
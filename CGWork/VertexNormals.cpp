@@ -0,0 +1,190 @@
+/* Implementation of the VertexNormals class */
+
+#include "VertexNormals.h"
+#include <math.h>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NORMALS_USE_SSE2
+#endif
+
+// Below this many vertices per thread, a thread isn't worth starting
+#define NORMALS_MIN_VERTICES_PER_THREAD 16384
+
+// Runs f(begin, end) over [0, count), split into @threads_nr ranges
+template <class F>
+static void parallelFor(int count, int threads_nr, F f)
+{
+    std::vector<std::thread> threads;
+
+    for (int i = 1; i < threads_nr; i++)
+        threads.emplace_back(f, (int)((long long)count * i / threads_nr),
+                             (int)((long long)count * (i + 1) / threads_nr));
+
+    // The calling thread takes the first range
+    f(0, (int)((long long)count / threads_nr));
+
+    for (std::thread &thread : threads)
+        thread.join();
+}
+
+void VertexNormals::ComputePolygonNormals(const VertexWelder &welder, NormalWeighting weighting,
+                                          int begin, int end)
+{
+    const int *polygon_corners = welder.getPolygonsCornersOffsets();
+    const int *corner_vertices = welder.getCornerVertices();
+
+    for (int polygon = begin; polygon < end; polygon++) {
+        int first = polygon_corners[polygon], last = polygon_corners[polygon + 1] - 1;
+        double nx = 0, ny = 0, nz = 0;
+        // Newell's method, the previous corner of the first one is the last
+        const double *previous = welder.getCoordinates(corner_vertices[last]);
+
+        for (int corner = first; corner <= last; corner++) {
+            const double *current = welder.getCoordinates(corner_vertices[corner]);
+
+            nx += (previous[1] - current[1]) * (previous[2] + current[2]);
+            ny += (previous[2] - current[2]) * (previous[0] + current[0]);
+            nz += (previous[0] - current[0]) * (previous[1] + current[1]);
+            previous = current;
+        }
+
+        if (weighting == NORMALS_ANGLE_WEIGHTED) {
+            double length = sqrt(nx * nx + ny * ny + nz * nz);
+
+            if (length > 0) {
+                nx /= length;
+                ny /= length;
+                nz /= length;
+            }
+        }
+
+        double *normal = &m_polygon_normals[4 * polygon];
+        normal[0] = nx;
+        normal[1] = ny;
+        normal[2] = nz;
+        normal[3] = 0;
+    }
+}
+
+/* The angle of @polygon's corner at @vertex. A polygon which touches the
+ * vertex more than once only counts its first corner there */
+static double cornerAngle(const VertexWelder &welder, int polygon, int vertex)
+{
+    const int *polygon_corners = welder.getPolygonsCornersOffsets();
+    const int *corner_vertices = welder.getCornerVertices();
+    int first = polygon_corners[polygon], last = polygon_corners[polygon + 1] - 1;
+    int corner = first;
+
+    while (corner_vertices[corner] != vertex)
+        corner++;
+
+    const double *at = welder.getCoordinates(vertex);
+    const double *previous = welder.getCoordinates(
+        corner_vertices[(corner == first) ? last : corner - 1]);
+    const double *next = welder.getCoordinates(
+        corner_vertices[(corner == last) ? first : corner + 1]);
+    double a[3], b[3];
+
+    for (int i = 0; i < 3; i++) {
+        a[i] = previous[i] - at[i];
+        b[i] = next[i] - at[i];
+    }
+
+    double lengths = sqrt((a[0] * a[0] + a[1] * a[1] + a[2] * a[2]) *
+                          (b[0] * b[0] + b[1] * b[1] + b[2] * b[2]));
+    if (lengths == 0)
+        return 0;
+
+    double cosine = (a[0] * b[0] + a[1] * b[1] + a[2] * b[2]) / lengths;
+
+    return acos((cosine < -1) ? -1 : (cosine > 1) ? 1 : cosine);
+}
+
+void VertexNormals::ComputeVertexNormals(const VertexWelder &welder, NormalWeighting weighting,
+                                         int begin, int end)
+{
+    const int *offsets = welder.getVertexPolygonsOffsets();
+    const int *polygons = welder.getVertexPolygons();
+    const double *polygon_normals = m_polygon_normals.data();
+
+    for (int vertex = begin; vertex < end; vertex++) {
+        double *normal = &m_vertex_normals[4 * vertex];
+        double sum[4];
+
+#ifdef NORMALS_USE_SSE2
+        __m128d xy = _mm_setzero_pd(), z0 = _mm_setzero_pd();
+
+        for (int i = offsets[vertex]; i < offsets[vertex + 1]; i++) {
+            const double *polygon_normal = polygon_normals + 4 * polygons[i];
+            __m128d weight = _mm_set1_pd(
+                (weighting == NORMALS_ANGLE_WEIGHTED) ? cornerAngle(welder, polygons[i], vertex)
+                                                      : 1.0);
+
+            xy = _mm_add_pd(xy, _mm_mul_pd(weight, _mm_loadu_pd(polygon_normal)));
+            z0 = _mm_add_pd(z0, _mm_mul_pd(weight, _mm_loadu_pd(polygon_normal + 2)));
+        }
+
+        _mm_storeu_pd(sum, xy);
+        _mm_storeu_pd(sum + 2, z0);
+#else
+        sum[0] = sum[1] = sum[2] = sum[3] = 0;
+
+        for (int i = offsets[vertex]; i < offsets[vertex + 1]; i++) {
+            const double *polygon_normal = polygon_normals + 4 * polygons[i];
+            double weight = (weighting == NORMALS_ANGLE_WEIGHTED)
+                                ? cornerAngle(welder, polygons[i], vertex)
+                                : 1.0;
+
+            for (int j = 0; j < 3; j++)
+                sum[j] += weight * polygon_normal[j];
+        }
+#endif
+
+        double length = sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+        double inverse_length = (length > 0) ? 1.0 / length : 0;
+
+        normal[0] = sum[0] * inverse_length;
+        normal[1] = sum[1] * inverse_length;
+        normal[2] = sum[2] * inverse_length;
+        normal[3] = 0;
+    }
+}
+
+void VertexNormals::Compute(const VertexWelder &welder, NormalWeighting weighting,
+                            int threads_nr)
+{
+    int vertices_nr = welder.getVerticesNr(),
+        polygons_nr = welder.getPolygonsNr();
+
+    m_polygon_normals.resize(4 * polygons_nr);
+    m_vertex_normals.resize(4 * vertices_nr);
+
+    if (threads_nr <= 0)
+        threads_nr = (int)std::thread::hardware_concurrency();
+
+    int max_threads_nr = vertices_nr / NORMALS_MIN_VERTICES_PER_THREAD;
+    if (threads_nr > max_threads_nr)
+        threads_nr = max_threads_nr;
+    if (threads_nr < 1)
+        threads_nr = 1;
+
+    // Every vertex needs all of its polygons, so the passes can't be fused
+    parallelFor(polygons_nr, threads_nr, [&](int begin, int end) {
+        ComputePolygonNormals(welder, weighting, begin, end);
+    });
+    parallelFor(vertices_nr, threads_nr, [&](int begin, int end) {
+        ComputeVertexNormals(welder, weighting, begin, end);
+    });
+}
+
+int VertexNormals::getAllocationsNr() const
+{
+    return (m_polygon_normals.capacity() > 0) + (m_vertex_normals.capacity() > 0);
+}
+
+size_t VertexNormals::getBytesAllocated() const
+{
+    return (m_polygon_normals.capacity() + m_vertex_normals.capacity()) * sizeof(double);
+}
@@ -0,0 +1,59 @@
+#ifndef __VERTEX_NORMALS_H__
+#define __VERTEX_NORMALS_H__
+
+/* Header file for the vertex normals class */
+
+#include <vector>
+#include "VertexWelder.h"
+
+// How much every polygon around a vertex contributes to its normal
+enum NormalWeighting {
+    NORMALS_AREA_WEIGHTED, // By the polygon's area
+    NORMALS_ANGLE_WEIGHTED // By the polygon's angle at the vertex
+};
+
+/* Computes the normals of the vertices of a welded mesh, as the weighted
+ * average of the normals of the polygons around them.
+ *
+ * It first computes all polygon normals (Newell's method, whose length
+ * is twice the polygon's area), then every vertex sums the normals of its
+ * polygons, taken from the welder's adjacency, and normalizes the sum.
+ * Both passes are linear, and since every vertex only writes its own
+ * normal, they can be split between threads.
+ */
+class VertexNormals
+{
+    // x, y, z, 0 of every polygon, and of every vertex
+    std::vector<double> m_polygon_normals;
+    std::vector<double> m_vertex_normals;
+
+    void ComputePolygonNormals(const VertexWelder &welder, NormalWeighting weighting,
+                               int begin, int end);
+
+    void ComputeVertexNormals(const VertexWelder &welder, NormalWeighting weighting,
+                              int begin, int end);
+
+public:
+    /* Computes the normals of all of @welder's vertices. Its adjacency
+     * must have been built.
+     * @threads_nr - how many threads to split the work between. 0 uses
+     *               all the processors. Small meshes use fewer threads,
+     *               as starting them would cost more than it saves
+     */
+    void Compute(const VertexWelder &welder, NormalWeighting weighting = NORMALS_AREA_WEIGHTED,
+                 int threads_nr = 1);
+
+    /* The unit normal of a vertex, or 0 if all the polygons around it are
+     * degenerate */
+    const double *getNormal(int vertex) const
+    {
+        return &m_vertex_normals[4 * vertex];
+    }
+
+    // The normals' buffers and their bytes, for memory accounting
+    int getAllocationsNr() const;
+
+    size_t getBytesAllocated() const;
+};
+
+#endif // __VERTEX_NORMALS_H__
@@ -0,0 +1,155 @@
+/** Testing the vertex normals class **/
+
+#include <chrono>
+#include <iostream>
+#include <math.h>
+#include <vector>
+#include "VertexNormals.h"
+
+using namespace std;
+
+#define EPSILON 0.005
+#define TOLERANCE 1e-12
+#define GRID_SIZE 1000
+
+// A unit cube with its faces given counter-clockwise from outside
+static void weldCube(VertexWelder &welder)
+{
+    static const double corners[8][3] = {{0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0},
+                                         {0, 0, 1}, {1, 0, 1}, {1, 1, 1}, {0, 1, 1}};
+    static const int faces[6][4] = {{0, 3, 2, 1}, {4, 5, 6, 7}, {0, 1, 5, 4},
+                                    {2, 3, 7, 6}, {1, 2, 6, 5}, {0, 4, 7, 3}};
+
+    for (int face = 0; face < 6; face++) {
+        welder.BeginPolygon();
+        for (int i = 0; i < 4; i++) {
+            const double *corner = corners[faces[face][i]];
+
+            welder.AddCorner(corner[0], corner[1], corner[2]);
+        }
+    }
+
+    welder.BuildAdjacency();
+}
+
+// A bumpy GRID_SIZE x GRID_SIZE height field of quads, so polygons differ in size
+static void weldGrid(VertexWelder &welder)
+{
+    for (int i = 0; i < GRID_SIZE; i++) {
+        for (int j = 0; j < GRID_SIZE; j++) {
+            int square[4][2] = {{i, j}, {i + 1, j}, {i + 1, j + 1}, {i, j + 1}};
+
+            welder.BeginPolygon();
+            for (int k = 0; k < 4; k++) {
+                double x = square[k][0] * 0.01, y = square[k][1] * 0.01;
+
+                welder.AddCorner(x, y, 0.1 * sin(7 * x) * cos(5 * y));
+            }
+        }
+    }
+
+    welder.BuildAdjacency();
+}
+
+// Every corner of the cube is the average of its three faces
+static bool checkCube(NormalWeighting weighting)
+{
+    VertexWelder welder(EPSILON);
+    VertexNormals normals;
+    double expected = 1 / sqrt(3.0);
+
+    weldCube(welder);
+    normals.Compute(welder, weighting);
+
+    if (welder.getVerticesNr() != 8)
+        return false;
+
+    for (int vertex = 0; vertex < 8; vertex++) {
+        const double *coordinates = welder.getCoordinates(vertex);
+        const double *normal = normals.getNormal(vertex);
+
+        for (int i = 0; i < 3; i++) {
+            double sign = (coordinates[i] > 0.5) ? 1 : -1;
+
+            if (fabs(normal[i] - sign * expected) > TOLERANCE)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+static bool checkUnitLength(const VertexWelder &welder, const VertexNormals &normals)
+{
+    for (int vertex = 0; vertex < welder.getVerticesNr(); vertex++) {
+        const double *normal = normals.getNormal(vertex);
+        double length = sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+        // The height field faces up everywhere
+        if (fabs(length - 1) > TOLERANCE || normal[2] <= 0)
+            return false;
+    }
+
+    return true;
+}
+
+static bool checkSame(const VertexWelder &welder, const VertexNormals &a, const VertexNormals &b)
+{
+    for (int vertex = 0; vertex < welder.getVerticesNr(); vertex++) {
+        for (int i = 0; i < 4; i++) {
+            if (a.getNormal(vertex)[i] != b.getNormal(vertex)[i])
+                return false;
+        }
+    }
+
+    return true;
+}
+
+static double timeCompute(VertexNormals &normals, const VertexWelder &welder,
+                          NormalWeighting weighting, int threads_nr)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    normals.Compute(welder, weighting, threads_nr);
+
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+int main()
+{
+    bool passed = true;
+
+    bool cube = checkCube(NORMALS_AREA_WEIGHTED) && checkCube(NORMALS_ANGLE_WEIGHTED);
+    cout << "Cube corners: " << (cube ? "passed" : "FAILED") << endl;
+    passed &= cube;
+
+    VertexWelder welder(EPSILON, 4 * GRID_SIZE * GRID_SIZE);
+    weldGrid(welder);
+
+    cout << endl
+         << welder.getPolygonsNr() << " polygons, " << welder.getVerticesNr() << " vertices"
+         << endl;
+
+    NormalWeighting weightings[] = {NORMALS_AREA_WEIGHTED, NORMALS_ANGLE_WEIGHTED};
+    const char *names[] = {"Area weighted", "Angle weighted"};
+
+    for (int i = 0; i < 2; i++) {
+        VertexNormals serial, parallel;
+        double serial_time = timeCompute(serial, welder, weightings[i], 1);
+        double parallel_time = timeCompute(parallel, welder, weightings[i], 0);
+
+        bool unit = checkUnitLength(welder, serial);
+        bool same = checkSame(welder, serial, parallel);
+
+        cout << names[i] << ": " << serial_time << " ms serial, " << parallel_time
+             << " ms parallel" << endl;
+        cout << "  Unit length: " << (unit ? "passed" : "FAILED") << endl;
+        cout << "  Parallel same as serial: " << (same ? "passed" : "FAILED") << endl;
+        passed &= unit && same;
+    }
+
+    cout << endl
+         << (passed ? "All tests passed" : "Some tests FAILED") << endl;
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,217 @@
+/* Implementation of the VertexWelder class */
+
+#include "VertexWelder.h"
+#include <math.h>
+
+#define WELDER_MIN_BUCKETS_NR 64
+
+VertexWelder::VertexWelder(double epsilon, int corners_nr_hint)
+    : m_epsilon(epsilon), m_inverse_epsilon(1.0 / epsilon)
+{
+    unsigned int buckets_nr = WELDER_MIN_BUCKETS_NR;
+
+    while ((int)buckets_nr < corners_nr_hint)
+        buckets_nr *= 2;
+
+    m_buckets.assign(buckets_nr, -1);
+    m_buckets_mask = buckets_nr - 1;
+
+    if (corners_nr_hint > 0) {
+        m_corner_vertices.reserve(corners_nr_hint);
+        m_coordinates.reserve(3 * corners_nr_hint);
+        m_cell_hashes.reserve(corners_nr_hint);
+        m_next_in_bucket.reserve(corners_nr_hint);
+    }
+}
+
+unsigned int VertexWelder::HashCell(long long x, long long y, long long z)
+{
+    unsigned long long hash = (unsigned long long)x * 73856093ULL ^
+                              (unsigned long long)y * 19349663ULL ^
+                              (unsigned long long)z * 83492791ULL;
+
+    return (unsigned int)(hash ^ (hash >> 32));
+}
+
+int VertexWelder::Find(double x, double y, double z) const
+{
+    long long cell_x = (long long)floor(x * m_inverse_epsilon),
+              cell_y = (long long)floor(y * m_inverse_epsilon),
+              cell_z = (long long)floor(z * m_inverse_epsilon);
+    int found = -1;
+
+    for (int dx = -1; dx <= 1; dx++) {
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dz = -1; dz <= 1; dz++) {
+                unsigned int hash = HashCell(cell_x + dx, cell_y + dy, cell_z + dz);
+                int vertex = m_buckets[hash & m_buckets_mask];
+
+                // Other cells may share the bucket, so every vertex is compared
+                for (; vertex != -1; vertex = m_next_in_bucket[vertex]) {
+                    const double *coordinates = &m_coordinates[3 * vertex];
+
+                    if ((found == -1 || vertex < found) &&
+                        fabs(coordinates[0] - x) < m_epsilon &&
+                        fabs(coordinates[1] - y) < m_epsilon &&
+                        fabs(coordinates[2] - z) < m_epsilon)
+                        found = vertex;
+                }
+            }
+        }
+    }
+
+    return found;
+}
+
+void VertexWelder::Rehash()
+{
+    unsigned int buckets_nr = 2 * (m_buckets_mask + 1);
+
+    m_buckets.assign(buckets_nr, -1);
+    m_buckets_mask = buckets_nr - 1;
+
+    for (int vertex = 0; vertex < (int)m_cell_hashes.size(); vertex++) {
+        unsigned int bucket = m_cell_hashes[vertex] & m_buckets_mask;
+
+        m_next_in_bucket[vertex] = m_buckets[bucket];
+        m_buckets[bucket] = vertex;
+    }
+}
+
+void VertexWelder::BeginPolygon()
+{
+    m_polygon_corners.push_back((int)m_corner_vertices.size());
+}
+
+int VertexWelder::AddCorner(double x, double y, double z)
+{
+    int vertex = Find(x, y, z);
+
+    if (vertex == -1) {
+        unsigned int hash = HashCell((long long)floor(x * m_inverse_epsilon),
+                                     (long long)floor(y * m_inverse_epsilon),
+                                     (long long)floor(z * m_inverse_epsilon));
+
+        vertex = (int)m_cell_hashes.size();
+        m_coordinates.push_back(x);
+        m_coordinates.push_back(y);
+        m_coordinates.push_back(z);
+        m_cell_hashes.push_back(hash);
+        m_next_in_bucket.push_back(m_buckets[hash & m_buckets_mask]);
+        m_buckets[hash & m_buckets_mask] = vertex;
+
+        // Keep about one vertex per bucket
+        if ((unsigned int)vertex > m_buckets_mask)
+            Rehash();
+    }
+
+    m_corner_vertices.push_back(vertex);
+
+    return vertex;
+}
+
+void VertexWelder::BuildAdjacency()
+{
+    int vertices_nr = getVerticesNr(),
+        polygons_nr = getPolygonsNr();
+    // The last polygon each vertex was counted for, a polygon may touch a vertex twice
+    std::vector<int> last_polygon(vertices_nr, -1);
+
+    m_polygon_corners.push_back((int)m_corner_vertices.size());
+
+    // Count the polygons of every vertex
+    m_adjacency_offsets.assign(vertices_nr + 1, 0);
+    for (int polygon = 0; polygon < polygons_nr; polygon++) {
+        for (int corner = m_polygon_corners[polygon]; corner < m_polygon_corners[polygon + 1];
+             corner++) {
+            int vertex = m_corner_vertices[corner];
+
+            if (last_polygon[vertex] != polygon) {
+                last_polygon[vertex] = polygon;
+                m_adjacency_offsets[vertex + 1]++;
+            }
+        }
+    }
+
+    for (int vertex = 0; vertex < vertices_nr; vertex++)
+        m_adjacency_offsets[vertex + 1] += m_adjacency_offsets[vertex];
+
+    // Fill the rows, m_adjacency_offsets[v] is used as the fill position of v
+    m_adjacency.resize(m_adjacency_offsets[vertices_nr]);
+    last_polygon.assign(vertices_nr, -1);
+    for (int polygon = 0; polygon < polygons_nr; polygon++) {
+        for (int corner = m_polygon_corners[polygon]; corner < m_polygon_corners[polygon + 1];
+             corner++) {
+            int vertex = m_corner_vertices[corner];
+
+            if (last_polygon[vertex] != polygon) {
+                last_polygon[vertex] = polygon;
+                m_adjacency[m_adjacency_offsets[vertex]++] = polygon;
+            }
+        }
+    }
+
+    // Every offset was advanced to the next row's start, shift them back
+    for (int vertex = vertices_nr; vertex > 0; vertex--)
+        m_adjacency_offsets[vertex] = m_adjacency_offsets[vertex - 1];
+    m_adjacency_offsets[0] = 0;
+}
+
+int VertexWelder::getVerticesNr() const
+{
+    return (int)m_cell_hashes.size();
+}
+
+int VertexWelder::getPolygonsNr() const
+{
+    // After BuildAdjacency() the list ends with one past the last corner
+    int polygons_nr = (int)m_polygon_corners.size();
+
+    return (m_adjacency_offsets.empty()) ? polygons_nr : polygons_nr - 1;
+}
+
+const double *VertexWelder::getCoordinates(int vertex) const
+{
+    return &m_coordinates[3 * vertex];
+}
+
+int VertexWelder::getCornerVertex(int corner) const
+{
+    return m_corner_vertices[corner];
+}
+
+const int *VertexWelder::getCornerVertices() const
+{
+    return m_corner_vertices.data();
+}
+
+const int *VertexWelder::getPolygonsCornersOffsets() const
+{
+    return m_polygon_corners.data();
+}
+
+const int *VertexWelder::getVertexPolygonsOffsets() const
+{
+    return m_adjacency_offsets.data();
+}
+
+const int *VertexWelder::getVertexPolygons() const
+{
+    return m_adjacency.data();
+}
+
+int VertexWelder::getAllocationsNr() const
+{
+    return (m_coordinates.capacity() > 0) + (m_cell_hashes.capacity() > 0) +
+           (m_next_in_bucket.capacity() > 0) + (m_buckets.capacity() > 0) +
+           (m_corner_vertices.capacity() > 0) + (m_polygon_corners.capacity() > 0) +
+           (m_adjacency_offsets.capacity() > 0) + (m_adjacency.capacity() > 0);
+}
+
+size_t VertexWelder::getBytesAllocated() const
+{
+    return m_coordinates.capacity() * sizeof(double) + m_cell_hashes.capacity() * sizeof(unsigned int) +
+           (m_next_in_bucket.capacity() + m_buckets.capacity() + m_corner_vertices.capacity() +
+            m_polygon_corners.capacity() + m_adjacency_offsets.capacity() + m_adjacency.capacity()) *
+               sizeof(int);
+}
@@ -0,0 +1,97 @@
+#ifndef __VERTEX_WELDER_H__
+#define __VERTEX_WELDER_H__
+
+/* Header file for the vertex welder class */
+
+#include <stddef.h>
+#include <vector>
+
+/* Finds the vertices that polygons share.
+ *
+ * Polygons are fed one corner at a time. Corners whose coordinates are
+ * all less than epsilon apart are welded into one vertex, which keeps the
+ * coordinates of the first corner that created it. When several existing
+ * vertices match a corner, the oldest one is used.
+ *
+ * Vertices are kept in a hash grid with cells of epsilon on a side, so a
+ * vertex can only be matched by vertices in its own cell or in one of the
+ * 26 cells around it, and welding takes expected O(1) per corner.
+ *
+ * Once all polygons were added, BuildAdjacency() lists the polygons around
+ * every vertex in compressed sparse rows: the polygons of vertex v are
+ * getVertexPolygons()[getVertexPolygonsOffsets()[v] ... [v + 1] - 1].
+ */
+class VertexWelder
+{
+    double m_epsilon;
+    double m_inverse_epsilon;
+
+    // Welded vertices
+    std::vector<double> m_coordinates; // x, y, z of every vertex
+    std::vector<unsigned int> m_cell_hashes;
+    std::vector<int> m_next_in_bucket;
+
+    // Hash table of the grid cells, each bucket is a list of vertices
+    std::vector<int> m_buckets;
+    unsigned int m_buckets_mask;
+
+    // Welded vertex of every corner, in the order they were added
+    std::vector<int> m_corner_vertices;
+    // Index of every polygon's first corner, plus one past the last corner
+    std::vector<int> m_polygon_corners;
+
+    std::vector<int> m_adjacency_offsets;
+    std::vector<int> m_adjacency;
+
+    static unsigned int HashCell(long long x, long long y, long long z);
+
+    // Returns the oldest vertex that matches the coordinates, or -1
+    int Find(double x, double y, double z) const;
+
+    // Doubles the number of buckets
+    void Rehash();
+
+public:
+    /* @epsilon - the distance (in each axis) below which corners are welded
+     * @corners_nr_hint - how many corners are going to be added. Only used
+     *                    to size the grid in advance
+     */
+    VertexWelder(double epsilon, int corners_nr_hint = 0);
+
+    // Starts a polygon - the following corners are added to it
+    void BeginPolygon();
+
+    // Adds a corner to the current polygon, returns its welded vertex
+    int AddCorner(double x, double y, double z);
+
+    // Builds the polygons-around-vertex lists, after all corners were added
+    void BuildAdjacency();
+
+    int getVerticesNr() const;
+
+    int getPolygonsNr() const;
+
+    // Coordinates (x, y, z) of a welded vertex
+    const double *getCoordinates(int vertex) const;
+
+    // Welded vertex of the @corner'th corner that was added
+    int getCornerVertex(int corner) const;
+
+    const int *getCornerVertices() const;
+
+    /* The corners of polygon p are [offsets[p], offsets[p + 1]). Only
+     * valid after BuildAdjacency() */
+    const int *getPolygonsCornersOffsets() const;
+
+    const int *getVertexPolygonsOffsets() const;
+
+    const int *getVertexPolygons() const;
+
+    /* The welder's buffers and their bytes, for memory accounting. A buffer
+     * which grew past its hint counts once */
+    int getAllocationsNr() const;
+
+    size_t getBytesAllocated() const;
+};
+
+#endif // __VERTEX_WELDER_H__
@@ -0,0 +1,151 @@
+/** Testing the vertex welder class **/
+
+#include <chrono>
+#include <iostream>
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+#include "VertexWelder.h"
+
+using namespace std;
+
+#define EPSILON 0.005
+#define CORNERS_PER_POLYGON 4
+#define BRUTE_FORCE_CORNERS_NR 20000
+#define BIG_CORNERS_NR 2000000
+
+/* Random corners, about every three of them jittered (by less than
+ * EPSILON) around the same point of a grid
+ */
+static vector<double> randomCorners(int corners_nr)
+{
+    vector<double> coordinates;
+
+    srand(1);
+    for (int i = 0; i < corners_nr; i++) {
+        int point = rand() % (corners_nr / 3 + 1);
+        double base[3] = {(point % 97) * 0.013, (point / 97 % 97) * 0.011, (point / 9409) * 0.017};
+
+        for (int j = 0; j < 3; j++)
+            coordinates.push_back(base[j] + (rand() % 100 - 50) * EPSILON / 60.0);
+    }
+
+    return coordinates;
+}
+
+static void weld(VertexWelder &welder, const vector<double> &coordinates)
+{
+    int corners_nr = (int)coordinates.size() / 3;
+
+    for (int i = 0; i < corners_nr; i++) {
+        if (i % CORNERS_PER_POLYGON == 0)
+            welder.BeginPolygon();
+        welder.AddCorner(coordinates[3 * i], coordinates[3 * i + 1], coordinates[3 * i + 2]);
+    }
+
+    welder.BuildAdjacency();
+}
+
+// Welding the way the loader used to - comparing against every vertex found so far
+static bool checkAgainstBruteForce(const VertexWelder &welder, const vector<double> &coordinates)
+{
+    vector<int> first_corners;
+    int corners_nr = (int)coordinates.size() / 3;
+
+    for (int i = 0; i < corners_nr; i++) {
+        int vertex = -1;
+
+        for (int j = 0; j < (int)first_corners.size() && vertex == -1; j++) {
+            int k = first_corners[j];
+
+            if (fabs(coordinates[3 * k] - coordinates[3 * i]) < EPSILON &&
+                fabs(coordinates[3 * k + 1] - coordinates[3 * i + 1]) < EPSILON &&
+                fabs(coordinates[3 * k + 2] - coordinates[3 * i + 2]) < EPSILON)
+                vertex = j;
+        }
+
+        if (vertex == -1) {
+            vertex = (int)first_corners.size();
+            first_corners.push_back(i);
+        }
+
+        if (welder.getCornerVertex(i) != vertex)
+            return false;
+    }
+
+    return (int)first_corners.size() == welder.getVerticesNr();
+}
+
+// Every polygon of every vertex has to touch it, exactly once
+static bool checkAdjacency(const VertexWelder &welder)
+{
+    const int *offsets = welder.getVertexPolygonsOffsets();
+    const int *polygons = welder.getVertexPolygons();
+    int pairs_nr = 0;
+
+    for (int vertex = 0; vertex < welder.getVerticesNr(); vertex++) {
+        for (int i = offsets[vertex]; i < offsets[vertex + 1]; i++) {
+            int polygon = polygons[i];
+            bool touches = false;
+
+            if (i > offsets[vertex] && polygon <= polygons[i - 1])
+                return false;
+
+            for (int j = 0; j < CORNERS_PER_POLYGON; j++)
+                touches |= welder.getCornerVertex(polygon * CORNERS_PER_POLYGON + j) == vertex;
+            if (!touches)
+                return false;
+        }
+    }
+
+    // Count the distinct vertices of every polygon
+    for (int polygon = 0; polygon < welder.getPolygonsNr(); polygon++) {
+        for (int j = 0; j < CORNERS_PER_POLYGON; j++) {
+            int vertex = welder.getCornerVertex(polygon * CORNERS_PER_POLYGON + j);
+            bool is_first = true;
+
+            for (int k = 0; k < j; k++)
+                is_first &= welder.getCornerVertex(polygon * CORNERS_PER_POLYGON + k) != vertex;
+            pairs_nr += is_first;
+        }
+    }
+
+    return pairs_nr == offsets[welder.getVerticesNr()];
+}
+
+int main()
+{
+    bool passed = true;
+
+    vector<double> coordinates = randomCorners(BRUTE_FORCE_CORNERS_NR);
+    VertexWelder welder(EPSILON);
+    weld(welder, coordinates);
+
+    cout << BRUTE_FORCE_CORNERS_NR << " corners welded into " << welder.getVerticesNr()
+         << " vertices" << endl;
+
+    bool same = checkAgainstBruteForce(welder, coordinates);
+    cout << "Same as brute force: " << (same ? "passed" : "FAILED") << endl;
+    passed &= same;
+
+    bool adjacency = checkAdjacency(welder);
+    cout << "Adjacency: " << (adjacency ? "passed" : "FAILED") << endl;
+    passed &= adjacency;
+
+    // Big enough to take hours with the quadratic search
+    coordinates = randomCorners(BIG_CORNERS_NR);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    VertexWelder big_welder(EPSILON, BIG_CORNERS_NR);
+    weld(big_welder, coordinates);
+
+    cout << endl
+         << BIG_CORNERS_NR << " corners welded into " << big_welder.getVerticesNr()
+         << " vertices in "
+         << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms"
+         << endl;
+
+    cout << endl
+         << (passed ? "All tests passed" : "Some tests FAILED") << endl;
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,168 @@
+/* Implementation of the WorkStealingPool class */
+
+#include "WorkStealingPool.h"
+
+WorkStealingPool::WorkStealingPool(int workers_nr)
+    : m_task(nullptr), m_batch(0), m_busy_threads_nr(0), m_is_stopping(false)
+{
+    if (workers_nr <= 0)
+        workers_nr = (int)std::thread::hardware_concurrency();
+    if (workers_nr <= 0)
+        workers_nr = 1;
+
+    for (int i = 0; i < workers_nr; i++) {
+        m_ranges.emplace_back(new Range());
+        m_ranges.back()->begin = 0;
+        m_ranges.back()->end = 0;
+    }
+
+    // Worker 0 is the thread which calls Run()
+    for (int i = 1; i < workers_nr; i++)
+        m_threads.emplace_back(&WorkStealingPool::ThreadMain, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_is_stopping = true;
+    }
+    m_batch_started.notify_all();
+
+    for (int i = 0; i < (int)m_threads.size(); i++)
+        m_threads[i].join();
+}
+
+void WorkStealingPool::ThreadMain(int worker)
+{
+    unsigned int batch = 0;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            m_batch_started.wait(lock, [&]() { return m_is_stopping || m_batch != batch; });
+            if (m_is_stopping)
+                return;
+
+            batch = m_batch;
+        }
+
+        Work(worker);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_busy_threads_nr--;
+        }
+        m_batch_done.notify_one();
+    }
+}
+
+void WorkStealingPool::Work(int worker)
+{
+    int task;
+
+    for (;;) {
+        if (PopFront(worker, task))
+            (*m_task)(task, worker);
+        else if (!Steal(worker))
+            return;
+    }
+}
+
+bool WorkStealingPool::PopFront(int worker, int &task)
+{
+    Range &range = *m_ranges[worker];
+    std::lock_guard<std::mutex> lock(range.mutex);
+
+    if (range.begin == range.end)
+        return false;
+
+    task = range.begin++;
+    return true;
+}
+
+bool WorkStealingPool::Steal(int worker)
+{
+    int workers_nr = (int)m_ranges.size();
+
+    // Tasks are never added during a batch, so once no range has any left, none will
+    for (;;) {
+        int victim = -1, victim_size = 0;
+
+        for (int i = 1; i < workers_nr; i++) {
+            Range &range = *m_ranges[(worker + i) % workers_nr];
+            std::lock_guard<std::mutex> lock(range.mutex);
+
+            if (range.end - range.begin > victim_size) {
+                victim = (worker + i) % workers_nr;
+                victim_size = range.end - range.begin;
+            }
+        }
+
+        if (victim < 0)
+            return false;
+
+        int begin, end;
+        {
+            Range &range = *m_ranges[victim];
+            std::lock_guard<std::mutex> lock(range.mutex);
+
+            // The victim may have run some of them since it was measured
+            if (range.begin == range.end)
+                continue;
+
+            end = range.end;
+            begin = range.end - (range.end - range.begin + 1) / 2;
+            range.end = begin;
+        }
+
+        Range &own_range = *m_ranges[worker];
+        std::lock_guard<std::mutex> lock(own_range.mutex);
+        own_range.begin = begin;
+        own_range.end = end;
+
+        return true;
+    }
+}
+
+void WorkStealingPool::Run(int tasks_nr, const Task &task)
+{
+    int workers_nr = (int)m_ranges.size();
+
+    if (tasks_nr <= 0)
+        return;
+
+    // Equal ranges, the first ones a task longer if they don't divide evenly
+    for (int i = 0, begin = 0; i < workers_nr; i++) {
+        int size = tasks_nr / workers_nr + (i < tasks_nr % workers_nr ? 1 : 0);
+        Range &range = *m_ranges[i];
+        std::lock_guard<std::mutex> lock(range.mutex);
+
+        range.begin = begin;
+        range.end = begin + size;
+        begin += size;
+    }
+
+    m_task = &task;
+
+    if (!m_threads.empty()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_busy_threads_nr = (int)m_threads.size();
+            m_batch++;
+        }
+        m_batch_started.notify_all();
+    }
+
+    Work(0);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_batch_done.wait(lock, [&]() { return m_busy_threads_nr == 0; });
+    m_task = nullptr;
+}
+
+int WorkStealingPool::getWorkersNr() const
+{
+    return (int)m_ranges.size();
+}
@@ -0,0 +1,82 @@
+#ifndef __WORK_STEALING_POOL_H__
+#define __WORK_STEALING_POOL_H__
+
+/* Header file for the work stealing thread pool */
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* A pool of threads which runs batches of independent tasks.
+ *
+ * The tasks of a batch are numbered 0 to tasks_nr - 1. Every worker (the
+ * pool's threads and the thread which calls Run()) starts with an equal
+ * range of them and takes tasks from the front of its own range. A worker
+ * which runs out steals the back half of the biggest range left, so tasks
+ * whose cost varies a lot (like tessellating freeforms of different
+ * sizes) still keep all the workers busy until the end.
+ *
+ * The threads live as long as the pool and sleep between batches. The
+ * order tasks run in isn't defined, so tasks which produce output should
+ * write it to a slot of their own and let the caller go over the slots in
+ * order.
+ */
+class WorkStealingPool
+{
+public:
+    // Runs task @task on worker @worker, which is in [0, getWorkersNr())
+    typedef std::function<void(int task, int worker)> Task;
+
+private:
+    // The tasks a worker has left, [begin, end)
+    struct Range
+    {
+        std::mutex mutex;
+        int begin;
+        int end;
+    };
+
+    std::vector<std::unique_ptr<Range> > m_ranges; // One per worker
+    std::vector<std::thread> m_threads;
+
+    // The batch which is being run, guarded by m_mutex
+    std::mutex m_mutex;
+    std::condition_variable m_batch_started;
+    std::condition_variable m_batch_done;
+    const Task *m_task;
+    unsigned int m_batch;
+    int m_busy_threads_nr;
+    bool m_is_stopping;
+
+    void ThreadMain(int worker);
+
+    // Runs tasks until there are none left to run or steal
+    void Work(int worker);
+
+    bool PopFront(int worker, int &task);
+
+    // Moves the back half of the biggest other range to @worker's range
+    bool Steal(int worker);
+
+public:
+    /* Creates a pool of @workers_nr workers, including the thread which
+     * calls Run(). 0 means one per hardware thread, 1 runs every task on
+     * the calling thread, in order.
+     */
+    explicit WorkStealingPool(int workers_nr = 0);
+
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    // Runs tasks [0, @tasks_nr) and returns once all of them are done
+    void Run(int tasks_nr, const Task &task);
+
+    int getWorkersNr() const;
+};
+
+#endif // __WORK_STEALING_POOL_H__
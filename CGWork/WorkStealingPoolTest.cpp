@@ -0,0 +1,92 @@
+/** Testing the work stealing thread pool **/
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "WorkStealingPool.h"
+
+using namespace std;
+
+#define WORKERS_NR 4
+#define TASKS_NR 10000
+#define BATCHES_NR 100
+// The first tasks are much slower than the rest, so the workers which get the others have to steal
+#define SLOW_TASKS_NR 8
+#define SLOW_TASK_MICROSECONDS 20000
+
+// Every task of every batch ran exactly once
+static bool runBatches(WorkStealingPool &pool)
+{
+    bool passed = true;
+
+    for (int batch = 0; batch < BATCHES_NR; batch++) {
+        vector<atomic<int> > runs(TASKS_NR);
+
+        for (int i = 0; i < TASKS_NR; i++)
+            runs[i] = 0;
+
+        pool.Run(TASKS_NR, [&](int task, int) {
+            runs[task]++;
+        });
+
+        for (int i = 0; i < TASKS_NR; i++)
+            passed &= runs[i] == 1;
+    }
+
+    return passed;
+}
+
+int main()
+{
+    bool passed = true;
+
+    WorkStealingPool serial_pool(1);
+    vector<int> order;
+
+    serial_pool.Run(100, [&](int task, int) {
+        order.push_back(task);
+    });
+
+    bool in_order = order.size() == 100;
+    for (int i = 0; i < (int)order.size(); i++)
+        in_order &= order[i] == i;
+
+    cout << "One worker runs the tasks in order: " << (in_order ? "passed" : "FAILED") << endl;
+    passed &= in_order;
+
+    WorkStealingPool pool(WORKERS_NR);
+
+    bool once = runBatches(pool) && pool.getWorkersNr() == WORKERS_NR;
+    cout << "Every task runs once, batch after batch: " << (once ? "passed" : "FAILED") << endl;
+    passed &= once;
+
+    // Worker 0 starts with all the slow tasks, the others finish theirs at once and steal them
+    vector<int> slow_task_workers(SLOW_TASKS_NR);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    pool.Run(SLOW_TASKS_NR * WORKERS_NR, [&](int task, int worker) {
+        if (task < SLOW_TASKS_NR) {
+            slow_task_workers[task] = worker;
+            this_thread::sleep_for(chrono::microseconds(SLOW_TASK_MICROSECONDS));
+        }
+    });
+
+    double milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    bool stolen = false;
+
+    for (int i = 0; i < SLOW_TASKS_NR; i++)
+        stolen |= slow_task_workers[i] != 0;
+
+    cout << "Idle workers steal tasks: " << (stolen ? "passed" : "FAILED") << endl;
+    passed &= stolen;
+
+    cout << endl
+         << SLOW_TASKS_NR << " tasks of " << SLOW_TASK_MICROSECONDS / 1000 << " ms took " << milliseconds
+         << " ms on " << WORKERS_NR << " workers" << endl
+         << endl
+         << (passed ? "All tests passed" : "Some tests FAILED") << endl;
+
+    return passed ? 0 : 1;
+}
@@ -1,6 +1,18 @@
 #include "stdafx.h"
 #include "iritSkel.h"
 #include "IritObjects.h"
+#include "ItdParser.h"
+#include "LoadProfile.h"
+#include "MeshCache.h"
+#include "VertexNormals.h"
+#include "VertexWelder.h"
+#include "SpscQueue.h"
+#include "WorkStealingPool.h"
+#include <atomic>
+#include <chrono>
+#include <math.h>
+#include <mutex>
+#include <thread>
 
 /*****************************************************************************
 * Skeleton for an interface to a parser to read IRIT data files.			 *
@@ -16,123 +28,1316 @@
 
 #define EPSILON 0.005
 
-bool areVerticesEqual(IPVertexStruct *first, IPVertexStruct *second);
+// Objects in flight in a load pipeline, which bounds its queues
+#define CGSKEL_PIPELINE_OBJECTS_NR 8
+/* Files smaller than this are stored on the parser's thread, since the
+   pipeline's threads would cost more than they save */
+#define CGSKEL_PIPELINE_MIN_FILE_SIZE (1024 * 1024)
+
+typedef std::chrono::steady_clock CGSkelClock;
+
+// Names a file the load profile is written to after every load, as CSV if it ends with .csv
+#define CGSKEL_LOAD_PROFILE_VARIABLE "CGWORK_LOAD_PROFILE"
+
+/* Without IRIT_COMPILE_PARALLEL, irit keeps the state of IPConvertFreeForm
+   in globals, so freeforms are only converted on all cores when it's set */
+#ifdef IRIT_COMPILE_PARALLEL
+#define CGSKEL_FREEFORM_WORKERS_NR 0
+#else
+#define CGSKEL_FREEFORM_WORKERS_NR 1
+#endif
+
+void updateBoundingFrameLimits(CGSkelLoadJob &Job, const double *coord);
+
+/* The irit library isn't thread safe, so only one thread reads files or
+   tessellates freeforms with it at a time */
+static std::mutex CGSkelIritMutex;
+// How often a thread which waits for irit checks if it was cancelled
+#define CGSKEL_IRIT_LOCK_POLL_MS 10
+
+/* Pieces of a surface smaller than this part of the whole surface are
+   accepted by the normal deviation error, so degenerate normals (like at a
+   pole) don't subdivide forever */
+#define CGSKEL_MIN_PIECE_PART 1e-3
+/* The smallest piece of the surface being converted adaptively on this
+   thread, which the error function has no other way to get */
+static thread_local double CGSkelMinPieceSize = 0;
+
+// Length of the diagonal of the bounding box of a surface's control mesh
+static double CGSkelSurfaceSize(const CagdSrfStruct *Srf)
+{
+	CagdBBoxStruct bbox;
+	double size = 0;
+
+	CagdSrfBBox(Srf, &bbox);
+	for (int i = 0; i < 3; i++)
+		size += (bbox.Max[i] - bbox.Min[i]) * (bbox.Max[i] - bbox.Min[i]);
+
+	return sqrt(size);
+}
+
+IPFreeformConvStateStruct CGSkelFFCState = {
+	FALSE,          /* Talkative */
+	FALSE,          /* DumpObjsAsPolylines */
+	TRUE,           /* DrawFFGeom */
+	FALSE,          /* DrawFFMesh */
+	{ 10, 10, 10 }, /* 10 isocurves peru/v/w direction. */
+	100,            /* 100 point samples along a curve. */
+	SYMB_CRV_APPROX_UNIFORM,  /* CrvApproxMethod */
+	FALSE,   /* ShowIntrnal */
+	FALSE,   /* CubicCrvsAprox */
+	20,      /* Polygonal FineNess */
+	FALSE,   /* ComputeUV */
+	TRUE,    /* ComputeNrml */
+	FALSE,   /* FourPerFlat */
+	0,       /* OptimalPolygons */
+	FALSE,   /* BBoxGrid */
+	TRUE,    /* LinearOnePolyFlag */
+	FALSE
+};
+
+//CGSkelProcessIritDataFiles(argv + 1, argc - 1);
+
+extern IritWorld world;
+
+bool CGSkelTessellationParams::operator<(const CGSkelTessellationParams &Other) const
+{
+	double own_tolerance = (mode == TESSELLATION_UNIFORM) ? 0 : tolerance,
+		   other_tolerance = (Other.mode == TESSELLATION_UNIFORM) ? 0 : Other.tolerance;
+
+	if (mode != Other.mode)
+		return mode < Other.mode;
+	if (fineness != Other.fineness)
+		return fineness < Other.fineness;
+	return own_tolerance < other_tolerance;
+}
+
+bool CGSkelTessellationParams::operator==(const CGSkelTessellationParams &Other) const
+{
+	return !(*this < Other) && !(Other < *this);
+}
+
+CGSkelTessellationParams CGSkelGetTessellationParams(const State &State)
+{
+	CGSkelTessellationParams params = {State.tessellation_mode, State.fineness,
+									   State.tessellation_tolerance};
+
+	return params;
+}
+
+static void CGSkelSetFFCState(IPFreeformConvStateStruct &State, double FineNess)
+{
+	State = CGSkelFFCState;
+
+	/* Here some useful parameters to play with in tesselating freeforms: */
+	State.FineNess = FineNess;   /* Res. of tesselation, larger is finer. */
+	State.ComputeUV = TRUE;   /* Wants UV coordinates for textures. */
+	State.FourPerFlat = TRUE;/* 4 poly per ~flat patch, 2 otherwise.*/
+	State.LinearOnePolyFlag = TRUE;    /* Linear srf gen. one poly. */
+}
+
+CGSkelLoadJob::CGSkelLoadJob(const CString &FileName, const CGSkelTessellationParams &Tessellation) :
+	file_name(FileName), needs_irit(false), succeeded(false),
+	own_figure(new IritFigure()), is_figure_in_world(false), hide_new_objects(false),
+	is_first_vertex(true), all_polygons(nullptr), tessellation_params(Tessellation),
+	normals_threads_nr(0), bytes_done_nr(0), loaded_by(""), wall_us(0), peak_rss_bytes(0),
+	is_cancelled(nullptr)
+{
+	// Only polygonal files are cached, which the tessellation doesn't change
+	has_cache_key = cache_key.FromFile(file_name, Tessellation.fineness);
+
+	// Objects are drawn only once they are complete
+	figure = own_figure.get();
+	figure->setLoading(true);
+
+	CGSkelSetFFCState(ffc_state, Tessellation.fineness);
+}
+
+CGSkelLoadJob::CGSkelLoadJob(IritFigure *Figure, const CGSkelTessellationParams &Tessellation) :
+	has_cache_key(false), needs_irit(false), succeeded(false), figure(Figure),
+	is_figure_in_world(true), hide_new_objects(false), is_first_vertex(true),
+	all_polygons(nullptr), tessellation_params(Tessellation), normals_threads_nr(0), bytes_done_nr(0),
+	loaded_by(""), wall_us(0), peak_rss_bytes(0), is_cancelled(nullptr)
+{
+	CGSkelSetFFCState(ffc_state, Tessellation.fineness);
+}
+
+bool CGSkelLoadJob::isCancelled() const
+{
+	return is_cancelled != nullptr && *is_cancelled;
+}
+
+/* Waits for the irit library, unless the work it's needed for is cancelled
+   first (so a cancelled load doesn't wait for a tessellation, or back) */
+static bool CGSkelLockIrit(std::unique_lock<std::mutex> &Lock, const std::atomic<bool> *IsCancelled)
+{
+	while (!Lock.try_lock()) {
+		if (IsCancelled != nullptr && *IsCancelled)
+			return false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(CGSKEL_IRIT_LOCK_POLL_MS));
+	}
+
+	return true;
+}
+
+static const char *CGSkelStageNames[CGSKEL_STAGES_NR] = {"cache", "parse", "read", "resolve", "convert",
+														  "weld", "normals", "build"};
+
+static long long CGSkelMicrosecondsSince(CGSkelClock::time_point Start)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(CGSkelClock::now() - Start).count();
+}
+
+static void CGSkelCountStage(CGSkelLoadJob &Job, CGSkelLoadStage Stage, long long ObjectsNr,
+							 long long VerticesNr, long long BusyUs, long long AllocationsNr = 0,
+							 long long BytesAllocated = 0)
+{
+	Job.stages[Stage].objects_nr += ObjectsNr;
+	Job.stages[Stage].vertices_nr += VerticesNr;
+	Job.stages[Stage].busy_us += BusyUs;
+	Job.stages[Stage].allocations_nr += AllocationsNr;
+	Job.stages[Stage].bytes_allocated += BytesAllocated;
+}
+
+// What storing the object which was just built took, from its parse on
+static void CGSkelRecordObject(CGSkelLoadJob &Job, int PolygonsNr, int VerticesNr, long long WallUs,
+							   long long AllocationsNr, long long BytesAllocated)
+{
+	LoadObjectRecord record = {Job.figure->getObjectsNr() - 1, PolygonsNr, VerticesNr, WallUs,
+							   AllocationsNr, BytesAllocated, LoadProfile::GetPeakRss()};
+
+	Job.object_records.push_back(record);
+}
+
+// Counts what an arena allocated since its counters were taken
+struct CGSkelArenaUsage {
+	const Arena &arena;
+	size_t allocations_nr, bytes_allocated;
+
+	CGSkelArenaUsage(const Arena &Counted) :
+		arena(Counted), allocations_nr(Counted.getAllocationsNr()), bytes_allocated(Counted.getBytesAllocated()) {}
+
+	long long getAllocationsNr() const { return (long long)(arena.getAllocationsNr() - allocations_nr); }
+	long long getBytesAllocated() const { return (long long)(arena.getBytesAllocated() - bytes_allocated); }
+};
+
+/* Stores the objects of a natively parsed file in stages, each on a thread
+ * of its own. The parser's thread copies every object into one of a fixed
+ * set of slots and queues it to be welded, then its vertex normals are
+ * computed, then it is built into the job's figure and published. So while
+ * one object is built, the next has its normals computed and the one after
+ * it is welded.
+ *
+ * The stages pass the slots on through lock-free queues, and a slot goes
+ * back to the parser once its object is built. At most
+ * CGSKEL_PIPELINE_OBJECTS_NR objects are in flight, so the stages before a
+ * slow one wait for it instead of piling objects up. Objects are built in
+ * the order they were parsed, and a null slot marks the end of the file.
+ */
+class CGSkelItdPipeline {
+	struct Slot {
+		ItdObject object;
+		std::unique_ptr<VertexWelder> welder;
+		VertexNormals normals;
+		long long busy_us;	// By the stages the object went through so far
+	};
+
+	CGSkelLoadJob &m_job;
+	Slot m_slots[CGSKEL_PIPELINE_OBJECTS_NR];
+	SpscQueue<Slot *> m_free_slots, m_to_weld, m_to_compute_normals, m_to_build;
+	// Once an object fails, the ones after it pass through without being stored
+	std::atomic<bool> m_has_failed;
+	std::thread m_weld_thread, m_normals_thread, m_build_thread;
+
+	void weld()
+	{
+		for (;;) {
+			Slot *slot = m_to_weld.Pop();
+
+			if (slot && !m_has_failed) {
+				CGSkelClock::time_point start = CGSkelClock::now();
+
+				slot->welder.reset(new VertexWelder(EPSILON, slot->object.getVerticesNr()));
+				if (CGSkelWeldItdObject(m_job, slot->object, *slot->welder)) {
+					slot->busy_us = CGSkelMicrosecondsSince(start);
+					CGSkelCountStage(m_job, CGSKEL_STAGE_WELD, 1, slot->object.getVerticesNr(), slot->busy_us,
+									 slot->welder->getAllocationsNr(), slot->welder->getBytesAllocated());
+				} else {
+					m_has_failed = true;
+				}
+			}
+
+			m_to_compute_normals.Push(slot);
+			if (!slot)
+				return;
+		}
+	}
+
+	void computeNormals()
+	{
+		for (;;) {
+			Slot *slot = m_to_compute_normals.Pop();
+
+			if (slot && !m_has_failed) {
+				CGSkelClock::time_point start = CGSkelClock::now();
+
+				slot->normals.Compute(*slot->welder, NORMALS_AREA_WEIGHTED, m_job.normals_threads_nr);
+				long long busy_us = CGSkelMicrosecondsSince(start);
+
+				// The slot's buffers are reused, so they are counted like new ones for every object
+				slot->busy_us += busy_us;
+				CGSkelCountStage(m_job, CGSKEL_STAGE_NORMALS, 1, slot->object.getVerticesNr(), busy_us,
+								 slot->normals.getAllocationsNr(), slot->normals.getBytesAllocated());
+			}
+
+			m_to_build.Push(slot);
+			if (!slot)
+				return;
+		}
+	}
+
+	void build()
+	{
+		for (;;) {
+			Slot *slot = m_to_build.Pop();
+
+			if (!slot)
+				return;
+
+			if (!m_has_failed) {
+				CGSkelClock::time_point start = CGSkelClock::now();
+				CGSkelArenaUsage usage(m_job.figure->getArena());
+				const ItdObject &object = slot->object;
+
+				CGSkelBuildItdObject(m_job, object, *slot->welder, slot->normals);
+				long long busy_us = CGSkelMicrosecondsSince(start);
+
+				CGSkelCountStage(m_job, CGSKEL_STAGE_BUILD, 1, object.getVerticesNr(), busy_us,
+								 usage.getAllocationsNr(), usage.getBytesAllocated());
+				CGSkelRecordObject(m_job, object.getPolygonsNr(), object.getVerticesNr(), slot->busy_us + busy_us,
+								   slot->welder->getAllocationsNr() + slot->normals.getAllocationsNr() +
+									   usage.getAllocationsNr(),
+								   slot->welder->getBytesAllocated() + slot->normals.getBytesAllocated() +
+									   usage.getBytesAllocated());
+				CGSkelPublishObjects(m_job);
+			}
+
+			m_free_slots.Push(slot);
+		}
+	}
+
+public:
+	CGSkelItdPipeline(CGSkelLoadJob &Job) :
+		m_job(Job), m_free_slots(CGSKEL_PIPELINE_OBJECTS_NR), m_to_weld(CGSKEL_PIPELINE_OBJECTS_NR + 1),
+		m_to_compute_normals(CGSKEL_PIPELINE_OBJECTS_NR + 1), m_to_build(CGSKEL_PIPELINE_OBJECTS_NR + 1),
+		m_has_failed(false)
+	{
+		for (int i = 0; i < CGSKEL_PIPELINE_OBJECTS_NR; i++)
+			m_free_slots.Push(&m_slots[i]);
+
+		m_weld_thread = std::thread([this]() { weld(); });
+		m_normals_thread = std::thread([this]() { computeNormals(); });
+		m_build_thread = std::thread([this]() { build(); });
+	}
+
+	~CGSkelItdPipeline()
+	{
+		finish();
+	}
+
+	// Queues a copy of @Object, waiting for a free slot. returns false if an object failed
+	bool push(const ItdObject &Object)
+	{
+		if (m_has_failed)
+			return false;
+
+		Slot *slot = m_free_slots.Pop();
+
+		// Assigning reuses the memory of the slot's previous object
+		slot->object = Object;
+		m_to_weld.Push(slot);
+
+		return true;
+	}
+
+	// Waits for all the queued objects to be stored. returns false if one failed
+	bool finish()
+	{
+		if (m_weld_thread.joinable()) {
+			m_to_weld.Push(nullptr);
+			m_weld_thread.join();
+			m_normals_thread.join();
+			m_build_thread.join();
+		}
+
+		return !m_has_failed;
+	}
+};
+
+/*****************************************************************************
+* DESCRIPTION:                                                               *
+* Main module of skeleton - Read command line and do what is needed...	     *
+*   Loads the files with CGSkelLoadFiles, and adds their figures to the      *
+* world together once all of them were loaded, in the order of FileNames.    *
+* CGSkelAsyncLoad loads them without blocking the caller.                    *
+*                                                                            *
+* PARAMETERS:                                                                *
+*   FileNames:  Files to open and read, as a vector of strings.              *
+*   NumFiles:   Length of the FileNames vector.								 *
+*                                                                            *
+* RETURN VALUE:                                                              *
+*   bool:		false - a file failed to load, true - success.               *
+*****************************************************************************/
+bool CGSkelProcessIritDataFiles(const CString *FileNames, int NumFiles)
+{
+	std::vector<std::unique_ptr<CGSkelLoadJob>> jobs;
+	std::vector<std::unique_ptr<IritFigure>> figures;
+	bool succeeded = true;
+
+	for (int i = 0; i < NumFiles; i++)
+		jobs.emplace_back(new CGSkelLoadJob(FileNames[i], CGSkelGetTessellationParams(world.state)));
+
+	CGSkelLoadFiles(jobs);
+	CGSkelWriteLoadProfile(jobs);
+
+	for (std::unique_ptr<CGSkelLoadJob> &job : jobs) {
+		if (!job->error.IsEmpty())
+			AfxMessageBox(job->error);
+
+		if (!job->succeeded) {
+			succeeded = false;
+			continue;
+		}
+
+		// We don't add a figure if it has no objects
+		if (job->figure->getObjectsNr() > 0) {
+			CGSkelAttachFreeformSource(*job);
+			job->figure->setLoading(false);
+			figures.push_back(std::move(job->own_figure));
+		}
+	}
+
+	world.addFigures(figures);
+	world.setOrthoMat();
+
+	return succeeded;
+}
+
+/*****************************************************************************
+* DESCRIPTION:                                                               *
+*   Loads files at the same time with a pool of threads, each into the       *
+* figure of its job. Doesn't touch the world, so it can run on any thread.   *
+*                                                                            *
+* PARAMETERS:                                                                *
+*   Jobs:       The files to load.                                           *
+*                                                                            *
+* RETURN VALUE:                                                              *
+*   void									                                 *
+*****************************************************************************/
+void CGSkelLoadFiles(std::vector<std::unique_ptr<CGSkelLoadJob>> &Jobs)
+{
+	std::vector<std::thread> threads;
+	std::atomic<int> next_job(0);
+	int jobs_nr = (int)Jobs.size(),
+		processors_nr = (int)std::thread::hardware_concurrency(),
+		threads_nr = processors_nr;
+
+	// Every thread takes the next file nobody took yet, until none are left
+	auto load_files = [&]() {
+		for (int i = next_job++; i < jobs_nr; i = next_job++)
+			CGSkelLoadFile(*Jobs[i]);
+	};
+
+	if (threads_nr > jobs_nr)
+		threads_nr = jobs_nr;
+	if (threads_nr < 1)
+		threads_nr = 1;
+
+	// The loader threads split the processors between them, instead of each starting its own
+	for (std::unique_ptr<CGSkelLoadJob> &job : Jobs)
+		job->normals_threads_nr = max(1, processors_nr / threads_nr);
+
+	for (int i = 1; i < threads_nr; i++)
+		threads.emplace_back(load_files);
+	load_files();
+
+	for (std::thread &thread : threads)
+		thread.join();
+
+	/* The irit library isn't thread safe, so the files only it can read
+	   are read here, one after the other, once the others are loaded. */
+	for (std::unique_ptr<CGSkelLoadJob> &job : Jobs) {
+		if (job->needs_irit && !job->isCancelled())
+			CGSkelParseIritDataFile(*job);
+	}
+}
+
+/*****************************************************************************
+* DESCRIPTION:                                                               *
+*   Loads one file into the figure of its job, from the mesh cache if the    *
+* file didn't change since it was cached, and with the native parser         *
+* otherwise. Files the native parser can't read are marked for the irit      *
+* library. Can be called from any thread.                                    *
+*                                                                            *
+* PARAMETERS:                                                                *
+*   Job:        The file to load, and where it is loaded to.                 *
+*                                                                            *
+* RETURN VALUE:                                                              *
+*   void									                                 *
+*****************************************************************************/
+void CGSkelLoadFile(CGSkelLoadJob &Job)
+{
+	CGSkelClock::time_point start = CGSkelClock::now();
+
+	if (Job.isCancelled())
+		return;
+
+	/* A file which didn't change since it was last loaded is mapped from its cache */
+	if (Job.has_cache_key && CGSkelLoadMeshCache(Job)) {
+		Job.succeeded = true;
+		Job.bytes_done_nr = Job.cache_key.size;
+		Job.loaded_by = "cache";
+		Job.wall_us = CGSkelMicrosecondsSince(start);
+		Job.peak_rss_bytes = LoadProfile::GetPeakRss();
+		return;
+	}
+
+	/* Polygonal files are read natively, irit is only needed for freeforms.
+	   The time the native parser spent on a file it gave up on is counted
+	   in the file's load, which irit goes on with */
+	Job.loaded_by = "native";
+	switch (CGSkelLoadItdFile(Job)) {
+	case ITD_OK:
+		Job.succeeded = true;
+		break;
+	case ITD_STOPPED:
+		break;
+	default:
+		Job.needs_irit = true;
+		Job.wall_us = CGSkelMicrosecondsSince(start);
+		return;
+	}
+
+	// Cache the new figure for the next time the file is loaded
+	if (Job.succeeded && Job.has_cache_key && Job.figure->getObjectsNr() > 0)
+		MeshCache::Write(Job.cache_key, *Job.figure);
+
+	Job.bytes_done_nr = Job.cache_key.size;
+	Job.wall_us = CGSkelMicrosecondsSince(start);
+	Job.peak_rss_bytes = LoadProfile::GetPeakRss();
+}
+
+/*****************************************************************************
+* DESCRIPTION:                                                               *
+*   Reads a data file into the figure of its job with the irit library.      *
+* The library isn't thread safe, so it's locked while the file is read. The *
+* freeforms of the file are kept in the job's freeform source.               *
+*                                                                            *
+* PARAMETERS:                                                                *
+*   Job:        The file to read, and where it is loaded to.                 *
+*                                                                            *
+* RETURN VALUE:                                                              *
+*   bool:		false - fail, true - success.                                *
+*****************************************************************************/
+bool CGSkelParseIritDataFile(CGSkelLoadJob &Job)
+{
+	IPObjectStruct *PObjects;
+	IrtHmgnMatType CrntViewMat;
+	const char *FileName = Job.file_name;
+	std::unique_lock<std::mutex> irit_lock(CGSkelIritMutex, std::defer_lock);
+	std::vector<bool> is_freeform;
+	CGSkelTessellation tessellation;
+	CGSkelClock::time_point load_start = CGSkelClock::now(), start;
+	long long read_us, resolve_us;
+
+	Job.loaded_by = "irit";
+	if (!CGSkelLockIrit(irit_lock, Job.is_cancelled))
+		return false;
+
+	/* Get the data files: */
+	IPSetFlattenObjects(FALSE);
+	start = CGSkelClock::now();
+	PObjects = IPGetDataFiles((const char* const *)&FileName, 1/*NumFiles*/, TRUE, FALSE);
+	read_us = CGSkelMicrosecondsSince(start);
+	if (PObjects == NULL)
+		return false;
+
+	start = CGSkelClock::now();
+	PObjects = IPResolveInstances(PObjects);
+	resolve_us = CGSkelMicrosecondsSince(start);
+
+	if (IPWasPrspMat)
+		MatMultTwo4by4(CrntViewMat, IPViewMat, IPPrspMat);
+	else
+		IRIT_GEN_COPY(CrntViewMat, IPViewMat, sizeof(IrtHmgnMatType));
+
+	Job.succeeded = true;
+
+	/* Traverse ALL the parsed data, recursively. */
+	IPTraverseObjListHierarchy2(PObjects, CrntViewMat,
+        CGSkelDumpOneTraversedObject, &Job);
+
+	// Irit allocates on its own, so reading and resolving only count objects and time
+	CGSkelCountStage(Job, CGSKEL_STAGE_READ, (long long)Job.traversed_objects.size(), 0, read_us);
+	CGSkelCountStage(Job, CGSKEL_STAGE_RESOLVE, (long long)Job.traversed_objects.size(), 0, resolve_us);
+
+	// The freeforms are kept, to be tessellated again when the parameters change
+	for (IPObjectStruct *PObj : Job.traversed_objects) {
+		is_freeform.push_back(IP_IS_FFGEOM_OBJ(PObj) != 0);
+		if (!is_freeform.back())
+			continue;
+
+		if (!Job.freeform_source) {
+			Job.freeform_source.reset(new CGSkelFreeformSource());
+			Job.freeform_source->shown = Job.tessellation_params;
+		}
+		Job.freeform_source->freeforms.push_back(PObj);
+	}
+
+	CGSkelConvertFreeForms(Job);
+
+	if (!CGSkelStoreConvertedObjects(Job, is_freeform, &tessellation))
+		Job.succeeded = false;
+
+	if (Job.isCancelled())
+		Job.succeeded = false;
+
+	if (Job.freeform_source)
+		Job.freeform_source->tessellations[Job.tessellation_params] = tessellation;
+
+	/* A figure with freeforms needs them to be tessellated again, so only
+	   polygonal files are cached (the cache has only the polygons) */
+	if (Job.succeeded && Job.has_cache_key && !Job.freeform_source && Job.figure->getObjectsNr() > 0)
+		MeshCache::Write(Job.cache_key, *Job.figure);
+
+	Job.bytes_done_nr = Job.cache_key.size;
+	Job.wall_us += CGSkelMicrosecondsSince(load_start);
+	Job.peak_rss_bytes = LoadProfile::GetPeakRss();
+
+	if (Job.succeeded)
+		CGSkelTraceStageCounters(Job);
+
+	return Job.succeeded;
+}
+
+/*****************************************************************************
+* DESCRIPTION:                                                               *
+*   Loads the figure of a job from the mesh cache of its file, if it has an  *
+* up to date one. The figure's buffers stay in the mapped cache.             *
+*                                                                            *
+* PARAMETERS:                                                                *
+*   Job:        The file, and where it is loaded to.                         *
+*                                                                            *
+* RETURN VALUE:                                                              *
+*   bool:		false - no cache, true - the figure was loaded.              *
+*****************************************************************************/
+bool CGSkelLoadMeshCache(CGSkelLoadJob &Job)
+{
+	MeshCache cache;
+	CGSkelClock::time_point start = CGSkelClock::now();
+	CGSkelArenaUsage usage(Job.figure->getArena());
+
+	if (!cache.Open(Job.cache_key))
+		return false;
+
+	cache.Attach(*Job.figure);
+
+	// The buffers stay in the mapping, only the objects are allocated
+	CGSkelCountStage(Job, CGSKEL_STAGE_CACHE, Job.figure->getObjectsNr(), 0, CGSkelMicrosecondsSince(start),
+					 usage.getAllocationsNr(), usage.getBytesAllocated());
+
+	// The cache holds the figure's bounding frame
+	Job.min_bound_coord = Job.figure->min_bound_coord;
+	Job.max_bound_coord = Job.figure->max_bound_coord;
+	Job.is_first_vertex = false;
+
+	CGSkelPublishObjects(Job);
+
+	return true;
+}
+
+/*****************************************************************************
+* DESCRIPTION:                                                               *
+*   Reads a data file with the native parser, without the irit library.      *
+* If the file can't be read this way (it has freeform objects, or syntax     *
+* irit might still accept), the objects stored so far are destroyed.         *
+*                                                                            *
+* PARAMETERS:                                                                *
+*   Job:        The file to read, and where it is loaded to.                 *
+*                                                                            *
+* RETURN VALUE:                                                              *
+*   ItdParseResult:	ITD_OK - the file was loaded, ITD_STOPPED - an object  *
+*					failed to be stored or the load was cancelled, otherwise *
+*					the file was not loaded.                                 *
+*****************************************************************************/
+ItdParseResult CGSkelLoadItdFile(CGSkelLoadJob &Job)
+{
+	ItdParser parser;
+	std::unique_ptr<CGSkelItdPipeline> pipeline;
+	CGSkelClock::time_point start = CGSkelClock::now();
+	long long storing_us = 0;
+
+	// Big files are stored in a pipeline, small ones on this thread
+	if (Job.cache_key.size >= CGSKEL_PIPELINE_MIN_FILE_SIZE && std::thread::hardware_concurrency() > 1)
+		pipeline.reset(new CGSkelItdPipeline(Job));
+
+	ItdParseResult result = parser.ParseFile(Job.file_name, [&](const ItdObject &Object) {
+		CGSkelClock::time_point storing_start = CGSkelClock::now();
+		bool is_stored;
+
+		if (Job.isCancelled())
+			return false;
+
+		if (pipeline) {
+			is_stored = pipeline->push(Object);
+		} else {
+			is_stored = CGSkelStoreItdObject(Job, Object);
+			if (is_stored)
+				CGSkelPublishObjects(Job);
+		}
+
+		Job.bytes_done_nr = parser.getBytesNr();
+		storing_us += CGSkelMicrosecondsSince(storing_start);
+
+		return is_stored;
+	});
+
+	// The parser's own time, without the time it waited for objects to be stored
+	CGSkelCountStage(Job, CGSKEL_STAGE_PARSE, parser.getObjectsNr(), parser.getVerticesNr(),
+					 CGSkelMicrosecondsSince(start) - storing_us);
+
+	// An object which failed after the last one was parsed
+	if (pipeline && !pipeline->finish() && result == ITD_OK)
+		result = ITD_STOPPED;
+
+	if (result != ITD_OK && result != ITD_STOPPED) {
+		/* Irit loads the file over, so the stages only count its load. The
+		   time the parser spent still shows in the file's wall time */
+		for (CGSkelStageCounters &stage : Job.stages) {
+			stage.objects_nr = 0;
+			stage.vertices_nr = 0;
+			stage.busy_us = 0;
+			stage.allocations_nr = 0;
+			stage.bytes_allocated = 0;
+		}
+
+		if (Job.figure->getObjectsNr() > 0) {
+			Job.figure->clearObjects();
+			Job.object_records.clear();
+			Job.is_first_vertex = true;
+			Job.min_bound_coord = Vector(0, 0, 0, 1);
+			Job.max_bound_coord = Vector(0, 0, 0, 1);
+			CGSkelPublishObjects(Job);
+		}
+	}
+
+	if (result == ITD_OK)
+		CGSkelTraceStageCounters(Job);
+
+	return result;
+}
+
+/*****************************************************************************
+* DESCRIPTION:                                                               *
+*   Makes the objects a job stored so far drawable, and tells whoever waits  *
+* for the load about them.                                                   *
+*                                                                            *
+* PARAMETERS:                                                                *
+*   Job:        The file the objects are from.                               *
+*                                                                            *
+* RETURN VALUE:                                                              *
+*   void									                                 *
+*****************************************************************************/
+void CGSkelPublishObjects(CGSkelLoadJob &Job)
+{
+	Job.figure->publishObjects(Job.min_bound_coord, Job.max_bound_coord);
+
+	if (Job.on_publish)
+		Job.on_publish();
+}
+
+/*****************************************************************************
+* DESCRIPTION:                                                               *
+*   Writes the throughput of every stage of a job's load to the debugger's   *
+* output.                                                                    *
+*                                                                            *
+* PARAMETERS:                                                                *
+*   Job:        A job whose load is over.                                    *
+*                                                                            *
+* RETURN VALUE:                                                              *
+*   void									                                 *
+*****************************************************************************/
+void CGSkelTraceStageCounters(const CGSkelLoadJob &Job)
+{
+	for (int i = 0; i < CGSKEL_STAGES_NR; i++) {
+		const CGSkelStageCounters &stage = Job.stages[i];
+		double seconds = stage.busy_us / 1e6;
+
+		if (stage.objects_nr == 0)
+			continue;
+
+		TRACE("%s: %-7s %lld objects, %lld vertices in %.3f s (%.0f vertices/s), %lld allocations of %lld bytes\n",
+			  (const char *)Job.file_name, CGSkelStageNames[i], (long long)stage.objects_nr,
+			  (long long)stage.vertices_nr, seconds, (seconds > 0) ? stage.vertices_nr / seconds : 0.0,
+			  (long long)stage.allocations_nr, (long long)stage.bytes_allocated);
+	}
+}
+
+/*****************************************************************************
+* DESCRIPTION:                                                               *
+*   Collects what a job's load took into a record of the load profile.       *
+*                                                                            *
+* PARAMETERS:                                                                *
+*   Job:        A job whose load is over.                                    *
+*                                                                            *
+* RETURN VALUE:                                                              *
+*   LoadFigureRecord:  The file's stages and objects.                        *
+*****************************************************************************/
+LoadFigureRecord CGSkelGetLoadRecord(const CGSkelLoadJob &Job)
+{
+	LoadFigureRecord record;
+
+	record.file_name = (const char *)Job.file_name;
+	record.loaded_by = Job.loaded_by;
+	record.succeeded = Job.succeeded;
+	record.wall_us = Job.wall_us;
+	record.bytes_reserved = Job.figure->getArena().getBytesReserved();
+	record.peak_rss_bytes = Job.peak_rss_bytes;
+	record.objects = Job.object_records;
+
+	for (int i = 0; i < CGSKEL_STAGES_NR; i++) {
+		const CGSkelStageCounters &counters = Job.stages[i];
+		LoadStageRecord stage = {CGSkelStageNames[i], counters.objects_nr, counters.vertices_nr,
+								 counters.busy_us, counters.allocations_nr, counters.bytes_allocated};
+
+		// Only the stages the file went through
+		if (stage.objects_nr > 0 || stage.wall_us > 0)
+			record.stages.push_back(stage);
+	}
+
+	return record;
+}
+
+/*****************************************************************************
+* DESCRIPTION:                                                               *
+*   Writes the load profile of the jobs of a load to the file named by the   *
+* CGWORK_LOAD_PROFILE environment variable, if it's set. The file is         *
+* replaced by every load.                                                    *
+*                                                                            *
+* PARAMETERS:                                                                *
+*   Jobs:       The files of a load which is over, whose figures still exist.*
+*                                                                            *
+* RETURN VALUE:                                                              *
+*   void									                                 *
+*****************************************************************************/
+void CGSkelWriteLoadProfile(const std::vector<std::unique_ptr<CGSkelLoadJob>> &Jobs)
+{
+	const char *path = getenv(CGSKEL_LOAD_PROFILE_VARIABLE);
+	LoadProfile profile;
+
+	if (path == NULL || *path == '\0')
+		return;
+
+	for (const std::unique_ptr<CGSkelLoadJob> &job : Jobs)
+		profile.AddFigure(CGSkelGetLoadRecord(*job));
+
+	if (!profile.Write(path))
+		TRACE("Failed to write the load profile to %s\n", path);
+}
+
+/*****************************************************************************
+* DESCRIPTION:                                                               *
+*   Call back function of IPTraverseObjListHierarchy2. Called on every non   *
+* list object found in hierarchy. The objects are only collected here, and   *
+* are converted and stored once the traversal is over.                       *
+*                                                                            *
+* PARAMETERS:                                                                *
+*   PObj:       Non list object to handle.                                   *
+*   Mat:        Transformation matrix to apply to this object.               *
+*   Data:       The CGSkelLoadJob of the file.                               *
+*                                                                            *
+* RETURN VALUE:                                                              *
+*   void									                                 *
+*****************************************************************************/
+void CGSkelDumpOneTraversedObject(IPObjectStruct *PObj,
+                                  IrtHmgnMatType Mat,
+                                  void *Data)
+{
+	CGSkelLoadJob *Job = (CGSkelLoadJob *)Data;
+
+	Job->traversed_objects.push_back(PObj);
+}
+
+/*****************************************************************************
+* DESCRIPTION:                                                               *
+*   Converts the freeform objects a job traversed to polygons, each with a   *
+* conversion state of its own, on a work stealing pool. Every object is      *
+* replaced by its polygons in place, so the output keeps the order of the    *
+* traversal and doesn't depend on which thread converted what.               *
+*                                                                            *
+* PARAMETERS:                                                                *
+*   Job:        The file whose objects are converted.                        *
+*                                                                            *
+* RETURN VALUE:                                                              *
+*   void									                                 *
+*****************************************************************************/
+void CGSkelConvertFreeForms(CGSkelLoadJob &Job)
+{
+	std::vector<IPObjectStruct *> &objects = Job.traversed_objects;
+	const CGSkelTessellationParams &params = Job.tessellation_params;
+	WorkStealingPool pool(CGSKEL_FREEFORM_WORKERS_NR);
+	CGSkelClock::time_point start = CGSkelClock::now();
+	std::atomic<long long> freeforms_nr(0);
+
+	// Like the rest of irit's state, the error of adaptive tessellation is global
+	if (params.mode == TESSELLATION_NORMAL)
+		CagdSrf2PolyAdapSetErrFunc(CGSkelNormalDeviationError, NULL);
+	else
+		CagdSrf2PolyAdapSetErrFunc(CagdSrfAdap2PolyDefErrFunc, NULL);
+
+	pool.Run((int)objects.size(), [&](int Task, int) {
+		IPFreeformConvStateStruct state = Job.ffc_state;
+
+		if (Job.isCancelled() || !IP_IS_FFGEOM_OBJ(objects[Task]))
+			return;
+
+		if (IP_IS_SRF_OBJ(objects[Task]) && params.mode != TESSELLATION_UNIFORM)
+			objects[Task] = CGSkelConvertSurfaceAdaptively(objects[Task], params.tolerance, state);
+		else
+			objects[Task] = IPConvertFreeForm(objects[Task], &state);
+		freeforms_nr++;
+	});
+
+	// The polygons are allocated by irit, so only the time is counted
+	CGSkelCountStage(Job, CGSKEL_STAGE_CONVERT, freeforms_nr, 0, CGSkelMicrosecondsSince(start));
+}
+
+/*****************************************************************************
+* DESCRIPTION:                                                               *
+*   Converts a surface object to polygons by subdividing it until every      *
+* piece is within a tolerance of being flat, by the error function set with  *
+* CagdSrf2PolyAdapSetErrFunc. Flat regions end up with big polygons, and     *
+* only curved ones are subdivided finely.                                    *
+*                                                                            *
+* PARAMETERS:                                                                *
+*   PObj:       Surface object to convert.                                   *
+*   Tolerance:  The error allowed in a polygon.                              *
+*   State:      Whether to compute normals and UVs, and polygons per patch.  *
+*                                                                            *
+* RETURN VALUE:                                                              *
+*   IPObjectStruct *:  A polygonal object, with the surface's attributes.    *
+*****************************************************************************/
+IPObjectStruct *CGSkelConvertSurfaceAdaptively(IPObjectStruct *PObj, double Tolerance,
+											   const IPFreeformConvStateStruct &State)
+{
+	IPPolygonStruct *polygons = NULL;
+	IPObjectStruct *PolyObj;
+
+	for (CagdSrfStruct *Srf = PObj->U.Srfs; Srf != NULL; Srf = Srf->Pnext) {
+		CagdPolygonStruct *CagdPolygons;
+
+		CGSkelMinPieceSize = CGSkelSurfaceSize(Srf) * CGSKEL_MIN_PIECE_PART;
+		CagdPolygons = CagdSrfAdap2Polygons(Srf, Tolerance, State.ComputeNrml, State.FourPerFlat,
+											State.ComputeUV, NULL);
+		// Frees the cagd polygons
+		IPPolygonStruct *srf_polygons = IPCagdPlgns2IritPlgns(CagdPolygons, State.ComputeUV);
+
+		polygons = (polygons == NULL) ? srf_polygons : IPAppendPolyLists(polygons, srf_polygons);
+	}
+
+	PolyObj = IPGenPOLYObject(polygons);
+	IP_ATTR_COPY_ATTRS2(PolyObj->Attr, PObj->Attr);
+
+	return PolyObj;
+}
+
+/*****************************************************************************
+* DESCRIPTION:                                                               *
+*   Error function of adaptive tessellation by normal deviation. A piece of  *
+* surface is flat enough once the cone which bounds its normals is narrower  *
+* than the tolerance. Irit can't bound the normals of the most curved pieces *
+* (their cone would be 90 degrees or wider), so those are subdivided too,    *
+* unless they're too small to matter.                                        *
+*                                                                            *
+* PARAMETERS:                                                                *
+*   Srf:        The piece of surface to measure.                             *
+*   Tolerance:  The largest angle allowed between normals, in degrees.       *
+*   AuxData:    Not used.                                                    *
+*                                                                            *
+* RETURN VALUE:                                                              *
+*   CagdRType:  Negative if Srf is flat enough, otherwise positive.          *
+*****************************************************************************/
+CagdRType CGSkelNormalDeviationError(const CagdSrfStruct *Srf, CagdRType Tolerance, void *AuxData)
+{
+	SymbNormalConeStruct cone;
+
+	// Degenerate pieces (like at a pole) never get flat, however small they get
+	if (CGSkelSurfaceSize(Srf) < CGSkelMinPieceSize)
+		return -1;
+
+	if (SymbNormalConeForSrfToData(Srf, &cone) == NULL)
+		return 1;
+
+	// The cone's angle is between its axis and its side
+	return IRIT_RAD2DEG(cone.ConeAngle) * 2 - Tolerance;
+}
+
+/*****************************************************************************
+* DESCRIPTION:                                                               *
+*   Stores the objects a job traversed and converted, in the order they were *
+* traversed, whatever order they were converted in. Unless the new objects   *
+* are hidden, they are published after every traversed object. The          *
+* polygons converted from freeforms are freed once they are stored.          *
+*                                                                            *
+* PARAMETERS:                                                                *
+*   Job:          The job whose traversed objects are stored.                *
+*   IsFreeForm:   For every traversed object, whether it was a freeform.     *
+*   Tessellation: Gets the objects each freeform was stored to, or null.     *
+*                                                                            *
+* RETURN VALUE:                                                              *
+*   bool:		false - fail or cancelled, true - success.                   *
+*****************************************************************************/
+bool CGSkelStoreConvertedObjects(CGSkelLoadJob &Job, const std::vector<bool> &IsFreeForm,
+								 CGSkelTessellation *Tessellation)
+{
+	bool succeeded = true;
+
+	for (size_t i = 0; i < Job.traversed_objects.size() && succeeded; i++) {
+		CGSkelObjectRange range = {Job.figure->getObjectsNr(), 0};
+
+		if (Job.isCancelled()) {
+			succeeded = false;
+			break;
+		}
+
+		for (IPObjectStruct *PObj = Job.traversed_objects[i]; PObj != NULL; PObj = PObj -> Pnext)
+			if (!CGSkelStoreData(Job, PObj)) {
+				succeeded = false;
+				break;
+			}
+
+		if (IsFreeForm[i]) {
+			range.nr = Job.figure->getObjectsNr() - range.first;
+			if (Tessellation)
+				Tessellation->push_back(range);
+			IPFreeObjectList(Job.traversed_objects[i]);
+		}
+
+		// Hidden objects are shown by whoever hid them, and keep the figure's frame
+		if (succeeded && !Job.hide_new_objects)
+			CGSkelPublishObjects(Job);
+	}
+
+	// Nothing points into the loader's list anymore
+	Job.all_polygons = nullptr;
+	Job.arena.Release();
+
+	return succeeded;
+}
+
+/*****************************************************************************
+* DESCRIPTION:                                                               *
+*   Shows the tessellation of a figure's freeforms with some parameters, if  *
+* the figure has one, and hides the tessellation which was shown. Called on  *
+* the thread which owns the world.                                           *
+*                                                                            *
+* PARAMETERS:                                                                *
+*   Figure:       The figure whose freeforms are shown.                      *
+*   Tessellation: The parameters of the tesselation to show.                 *
+*                                                                            *
+* RETURN VALUE:                                                              *
+*   bool:		false - the figure wasn't tessellated with them yet,         *
+*               true - it's shown (or the figure has no freeforms).          *
+*****************************************************************************/
+bool CGSkelShowTessellation(IritFigure &Figure, const CGSkelTessellationParams &Tessellation)
+{
+	CGSkelFreeformSource *source = dynamic_cast<CGSkelFreeformSource *>(Figure.getSource());
+
+	if (source == nullptr || source->shown == Tessellation)
+		return true;
+
+	auto tessellation = source->tessellations.find(Tessellation);
+	if (tessellation == source->tessellations.end())
+		return false;
+
+	for (const CGSkelObjectRange &range : source->tessellations[source->shown])
+		Figure.setObjectsHidden(range.first, range.nr, true);
+	for (const CGSkelObjectRange &range : tessellation->second)
+		Figure.setObjectsHidden(range.first, range.nr, false);
+
+	source->shown = Tessellation;
+
+	return true;
+}
+
+/*****************************************************************************
+* DESCRIPTION:                                                               *
+*   Moves the freeform source of a job which succeeded to its figure.        *
+*                                                                            *
+* PARAMETERS:                                                                *
+*   Job:        A job whose load is over.                                    *
+*                                                                            *
+* RETURN VALUE:                                                              *
+*   void									                                 *
+*****************************************************************************/
+void CGSkelAttachFreeformSource(CGSkelLoadJob &Job)
+{
+	if (Job.freeform_source)
+		Job.figure->attachSource(std::move(Job.freeform_source));
+}
+
+/*****************************************************************************
+* DESCRIPTION:                                                               *
+*   Starts loading files on a background thread. Their figures are added to  *
+* the world by publish(), called on the thread which owns the world.         *
+*                                                                            *
+* PARAMETERS:                                                                *
+*   FileNames:  Files to open and read, as a vector of strings.              *
+*   NumFiles:   Length of the FileNames vector.                              *
+*   Tessellation: How freeforms are tessellated.                             *
+*   Notify:     Called from the loader threads when publish() has something  *
+*               to do. Not called again until publish() is.                  *
+*****************************************************************************/
+CGSkelAsyncLoad::CGSkelAsyncLoad(const CString *FileNames, int NumFiles,
+								 const CGSkelTessellationParams &Tessellation,
+								 std::function<void()> Notify) :
+	m_is_cancelled(false), m_is_done(false), m_is_notify_pending(false),
+	m_notify(Notify), m_bytes_nr(0)
+{
+	for (int i = 0; i < NumFiles; i++) {
+		CGSkelLoadJob *job = new CGSkelLoadJob(FileNames[i], Tessellation);
 
-void updateBoundingFrameLimits(IPVertexStruct *vertex);
+		job->is_cancelled = &m_is_cancelled;
+		job->on_publish = [this]() { notify(); };
+		m_bytes_nr += job->cache_key.size;
+		m_jobs.emplace_back(job);
+	}
 
-IPFreeformConvStateStruct CGSkelFFCState = {
-	FALSE,          /* Talkative */
-	FALSE,          /* DumpObjsAsPolylines */
-	TRUE,           /* DrawFFGeom */
-	FALSE,          /* DrawFFMesh */
-	{ 10, 10, 10 }, /* 10 isocurves peru/v/w direction. */
-	100,            /* 100 point samples along a curve. */
-	SYMB_CRV_APPROX_UNIFORM,  /* CrvApproxMethod */
-	FALSE,   /* ShowIntrnal */
-	FALSE,   /* CubicCrvsAprox */
-	20,      /* Polygonal FineNess */
-	FALSE,   /* ComputeUV */
-	TRUE,    /* ComputeNrml */
-	FALSE,   /* FourPerFlat */
-	0,       /* OptimalPolygons */
-	FALSE,   /* BBoxGrid */
-	TRUE,    /* LinearOnePolyFlag */
-	FALSE
-};
+	m_thread = std::thread([this]() {
+		CGSkelLoadFiles(m_jobs);
+		m_is_done = true;
+		notify();
+	});
+}
 
-//CGSkelProcessIritDataFiles(argv + 1, argc - 1);
+CGSkelAsyncLoad::~CGSkelAsyncLoad()
+{
+	cancel();
+	if (m_thread.joinable())
+		m_thread.join();
+}
 
-extern IritWorld world;
+void CGSkelAsyncLoad::notify()
+{
+	if (!m_is_notify_pending.exchange(true) && m_notify)
+		m_notify();
+}
+
+void CGSkelAsyncLoad::cancel()
+{
+	m_is_cancelled = true;
+}
+
+bool CGSkelAsyncLoad::isDone() const
+{
+	return m_is_done;
+}
+
+int CGSkelAsyncLoad::getProgress() const
+{
+	long long bytes_done_nr = 0;
 
-bool is_first_polygon;
-bool is_first_figure;
+	if (m_bytes_nr == 0)
+		return m_is_done ? 100 : 0;
 
-VertexList *connectivity;
+	for (const std::unique_ptr<CGSkelLoadJob> &job : m_jobs)
+		bytes_done_nr += job->bytes_done_nr;
 
-PolygonList *all_polygons;
+	return (int)(100 * bytes_done_nr / m_bytes_nr);
+}
 
 /*****************************************************************************
 * DESCRIPTION:                                                               *
-* Main module of skeleton - Read command line and do what is needed...	     *
+*   Adds the figures which got their first objects to the world, and grows   *
+* the world's bounding frame to hold all the objects published so far.       *
 *                                                                            *
 * PARAMETERS:                                                                *
-*   FileNames:  Files to open and read, as a vector of strings.              *
-*   NumFiles:   Length of the FileNames vector.								 *
+*   World:      The world the figures are loaded to.                         *
 *                                                                            *
 * RETURN VALUE:                                                              *
-*   bool:		false - fail, true - success.                                *
+*   void									                                 *
 *****************************************************************************/
-bool CGSkelProcessIritDataFiles(CString &FileNames, int NumFiles)
+void CGSkelAsyncLoad::publish(IritWorld &World)
 {
-	IPObjectStruct *PObjects;
-	IrtHmgnMatType CrntViewMat;
+	std::vector<std::unique_ptr<IritFigure>> figures;
 
-	/* Get the data files: */
-	IPSetFlattenObjects(FALSE);
-	CStringA CStr(FileNames);
-	if ((PObjects = IPGetDataFiles((const char* const *)&CStr, 1/*NumFiles*/, TRUE, FALSE)) == NULL)
-		return false;
-	PObjects = IPResolveInstances(PObjects);
+	m_is_notify_pending = false;
 
-	if (IPWasPrspMat)
-		MatMultTwo4by4(CrntViewMat, IPViewMat, IPPrspMat);
-	else
-		IRIT_GEN_COPY(CrntViewMat, IPViewMat, sizeof(IrtHmgnMatType));
+	for (std::unique_ptr<CGSkelLoadJob> &job : m_jobs) {
+		if (!job->is_figure_in_world && job->figure->getPublishedObjectsNr() > 0) {
+			job->is_figure_in_world = true;
+			figures.push_back(std::move(job->own_figure));
+		}
+	}
 
-	/* Here some useful parameters to play with in tesselating freeforms: */
-	CGSkelFFCState.FineNess = world.state.fineness;   /* Res. of tesselation, larger is finer. */
-	CGSkelFFCState.ComputeUV = TRUE;   /* Wants UV coordinates for textures. */
-	CGSkelFFCState.FourPerFlat = TRUE;/* 4 poly per ~flat patch, 2 otherwise.*/
-	CGSkelFFCState.LinearOnePolyFlag = TRUE;    /* Linear srf gen. one poly. */
+	World.addFigures(figures);
+}
+
+/*****************************************************************************
+* DESCRIPTION:                                                               *
+*   Waits for the load to end and publishes what's left. The figures of      *
+* files which failed or were cancelled are removed from the world, and the   *
+* errors of the others are shown.                                            *
+*                                                                            *
+* PARAMETERS:                                                                *
+*   World:      The world the figures are loaded to.                         *
+*                                                                            *
+* RETURN VALUE:                                                              *
+*   bool:		false - a file failed or was cancelled, true - success.      *
+*****************************************************************************/
+bool CGSkelAsyncLoad::finish(IritWorld &World)
+{
+	bool succeeded = true;
 
-	// Need to be initialized before any object is proccesed;
-	if (world.isEmpty())
-		is_first_polygon = true;
+	if (m_thread.joinable())
+		m_thread.join();
 
-	is_first_figure = true;
+	publish(World);
 
-	/* Traverse ALL the parsed data, recursively. */
-	IPTraverseObjListHierarchy(PObjects, CrntViewMat,
-        CGSkelDumpOneTraversedObject);
+	// Before the figures of the files which failed are removed
+	CGSkelWriteLoadProfile(m_jobs);
 
-	world.setOrthoMat();
+	for (std::unique_ptr<CGSkelLoadJob> &job : m_jobs) {
+		if (!job->error.IsEmpty() && !m_is_cancelled)
+			AfxMessageBox(job->error);
 
-	return true;
+		if (!job->succeeded) {
+			succeeded = false;
+			if (job->is_figure_in_world)
+				World.removeFigure(job->figure);
+			continue;
+		}
+
+		CGSkelAttachFreeformSource(*job);
+		job->figure->setLoading(false);
+	}
+
+	World.updateBoundingFrame();
+
+	return succeeded;
 }
 
 /*****************************************************************************
 * DESCRIPTION:                                                               *
-*   Call back function of IPTraverseObjListHierarchy. Called on every non    *
-* list object found in hierarchy.                                            *
+*   Shows the tessellations of the world's figures with parameters they      *
+* already have, and starts tessellating the freeforms of the others on a     *
+* background thread, into hidden objects of their figures.                   *
 *                                                                            *
 * PARAMETERS:                                                                *
-*   PObj:       Non list object to handle.                                   *
-*   Mat:        Transformation matrix to apply to this object.               *
-*   Data:       Additional data.                                             *
+*   World:        The world whose figures are tessellated.                   *
+*   Tessellation: How freeforms are tessellated.                             *
+*   Notify:     Called from the tessellation thread once it's done.          *
+*****************************************************************************/
+CGSkelAsyncTessellation::CGSkelAsyncTessellation(IritWorld &World,
+												 const CGSkelTessellationParams &Tessellation,
+												 std::function<void()> Notify) :
+	m_params(Tessellation), m_is_cancelled(false), m_is_done(false), m_has_changed(false)
+{
+	for (int i = 0; i < World.getFiguresNr(); i++) {
+		IritFigure &figure = World.getFigure(i);
+		CGSkelFreeformSource *source = dynamic_cast<CGSkelFreeformSource *>(figure.getSource());
+		bool is_shown = source == nullptr || source->shown == Tessellation;
+
+		if (!CGSkelShowTessellation(figure, Tessellation)) {
+			Task task = {&figure, source, CGSkelTessellation(), false};
+			m_tasks.push_back(task);
+		} else if (!is_shown) {
+			m_has_changed = true;
+		}
+	}
+
+	if (m_tasks.empty()) {
+		m_is_done = true;
+		return;
+	}
+
+	m_thread = std::thread([this, Notify]() {
+		std::unique_lock<std::mutex> irit_lock(CGSkelIritMutex, std::defer_lock);
+
+		for (Task &task : m_tasks) {
+			CGSkelLoadJob job(task.figure, m_params);
+			int objects_nr = task.figure->getObjectsNr();
+
+			if (!irit_lock.owns_lock() && !CGSkelLockIrit(irit_lock, &m_is_cancelled))
+				break;
+
+			job.hide_new_objects = true;
+			job.is_cancelled = &m_is_cancelled;
+			job.traversed_objects = task.source->freeforms;
+
+			// Figures tessellated before a cancel are kept, the one it stopped isn't
+			CGSkelConvertFreeForms(job);
+			task.succeeded = CGSkelStoreConvertedObjects(
+				job, std::vector<bool>(job.traversed_objects.size(), true), &task.tessellation);
+			if (!task.succeeded)
+				task.figure->removeObjects(objects_nr);
+		}
+
+		m_is_done = true;
+		if (Notify)
+			Notify();
+	});
+}
+
+CGSkelAsyncTessellation::~CGSkelAsyncTessellation()
+{
+	cancel();
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+void CGSkelAsyncTessellation::cancel()
+{
+	m_is_cancelled = true;
+}
+
+bool CGSkelAsyncTessellation::isDone() const
+{
+	return m_is_done;
+}
+
+/*****************************************************************************
+* DESCRIPTION:                                                               *
+*   Waits for the tessellation thread and keeps the tessellations it         *
+* finished, even if it was cancelled, so they're there the next time their   *
+* parameters are chosen. They are shown only if it wasn't cancelled.         *
+*                                                                            *
+* PARAMETERS:                                                                *
+*   None                                                                     *
 *                                                                            *
 * RETURN VALUE:                                                              *
 *   void									                                 *
 *****************************************************************************/
-void CGSkelDumpOneTraversedObject(IPObjectStruct *PObj,
-                                  IrtHmgnMatType Mat,
-                                  void *Data)
+void CGSkelAsyncTessellation::finish()
 {
-	IPObjectStruct *PObjs;
+	if (m_thread.joinable())
+		m_thread.join();
 
-	if (IP_IS_FFGEOM_OBJ(PObj))
-		PObjs = IPConvertFreeForm(PObj, &CGSkelFFCState);
-	else
-		PObjs = PObj;
+	for (Task &task : m_tasks) {
+		if (!task.succeeded)
+			continue;
 
-	if (is_first_figure) {
-		// We don't create a new figure if it has no objects
-		world.createFigure();
-		is_first_figure = false;
+		task.source->tessellations[m_params] = task.tessellation;
+		if (!m_is_cancelled) {
+			CGSkelShowTessellation(*task.figure, m_params);
+			m_has_changed = true;
+		}
 	}
+}
 
-	for (PObj = PObjs; PObj != NULL; PObj = PObj -> Pnext)
-		if (!CGSkelStoreData(PObj)) 
-			exit(1);
+bool CGSkelAsyncTessellation::hasChanged() const
+{
+	return m_has_changed;
 }
 
 /*****************************************************************************
@@ -140,41 +1345,46 @@ void CGSkelDumpOneTraversedObject(IPObjectStruct *PObj,
 *   Prints the data from given geometry object.								 *
 *                                                                            *
 * PARAMETERS:                                                                *
+*   Job:        The file the object is from.                                 *
 *   PObj:       Object to print.                                             *
-*   Indent:     Column of indentation.                                       *
 *                                                                            *
 * RETURN VALUE:                                                              *
 *   bool:		false - fail, true - success.                                *
 *****************************************************************************/
-bool CGSkelStoreData(IPObjectStruct *PObj)
+bool CGSkelStoreData(CGSkelLoadJob &Job, IPObjectStruct *PObj)
 {
-	int num_of_vertices;
+	int num_of_vertices, object_vertices_nr = 0, corner;
 	const char *Str;
 	double RGB[3], Transp,
 		center_mass_x = 0, center_mass_y = 0, center_mass_z = 0;
 	IPPolygonStruct *PPolygon;
 	IPVertexStruct *PVertex;
+	int polygons_nr = 0;
+	CGSkelClock::time_point start = CGSkelClock::now();
+	long long weld_us, normals_us, build_us;
+	CGSkelArenaUsage job_usage(Job.arena), figure_usage(Job.figure->getArena());
 
-	connectivity = new VertexList();
-	all_polygons = new PolygonList();
+	Job.arena.Reset();
+	Job.all_polygons = Job.arena.New<PolygonList>();
 
 	PolygonList *current_polygon;
-	VertexList *current_vertex;
+	PolygonList *last_polygon = Job.all_polygons;
 
 	const IPAttributeStruct *Attrs =
         AttrTraceAttributes(PObj -> Attr, PObj -> Attr);
-	IritFigure &figure = world.getLastFigure();
-	IritObject *irit_object = figure.createObject();
+	IritObject *irit_object;
 
 	Vector first, second, third, vertex;
 
-	assert(irit_object);
-
 	if (PObj->ObjType != IP_OBJ_POLY) {
-		AfxMessageBox(_T("Non polygonal object detected and ignored"));
+		Job.error = _T("Non polygonal object detected and ignored");
 		return true;
 	}
 
+	// Only after the check, so ignored objects don't leave empty ones behind
+	irit_object = Job.figure->createObject(Job.hide_new_objects);
+	assert(irit_object);
+
 	/* You can use IP_IS_POLYGON_OBJ(PObj) and IP_IS_POINTLIST_OBJ(PObj)
 	   to identify the type of the object*/
 
@@ -203,70 +1413,67 @@ bool CGSkelStoreData(IPObjectStruct *PObj)
 		}
 	}
 
-	//  First pass - build linked lists
+	// Count the vertices, to size the buffers in advance
+	for (PPolygon = PObj->U.Pl; PPolygon != NULL; PPolygon = PPolygon->Pnext) {
+		PVertex = PPolygon->PVertex;
+		while (PVertex != nullptr) {
+			object_vertices_nr++;
+			PVertex = PVertex->Pnext;
+			if (PVertex == PPolygon->PVertex)
+				break;
+		}
+	}
+
+	// Vertices which are closer than EPSILON are considered the same vertex
+	VertexWelder welder(EPSILON, object_vertices_nr);
+
+	//  First pass - build the polygons list and find shared vertices
 	for (PPolygon = PObj->U.Pl; PPolygon != NULL; PPolygon = PPolygon->Pnext) {
 
-		IritPolygon *new_polygon = new IritPolygon();
+		IritPolygon *new_polygon = irit_object->createPolygon();
+		polygons_nr++;
 
 		// List of all polygons
-		current_polygon = all_polygons;
-		if (current_polygon->polygon == nullptr) { // Populate the first node
-			current_polygon->skel_polygon = PPolygon;
-			current_polygon->polygon = new_polygon;
+		if (last_polygon->polygon == nullptr) { // Populate the first node
+			last_polygon->skel_polygon = PPolygon;
+			last_polygon->polygon = new_polygon;
 		} else {
-			while (current_polygon->next != nullptr) {
-				current_polygon = current_polygon->next;
-			}
-			PolygonList *new_node = new PolygonList();
-			current_polygon->next = new_node;
-			current_polygon->next->polygon = new_polygon;
-			current_polygon->next->skel_polygon = PPolygon;
+			PolygonList *new_node = Job.arena.New<PolygonList>();
+			last_polygon->next = new_node;
+			last_polygon = new_node;
+			last_polygon->polygon = new_polygon;
+			last_polygon->skel_polygon = PPolygon;
 		}
 
-		// List of all vertices, with connectiviy information
 		if (PPolygon->PVertex == NULL) {
-			AfxMessageBox(_T("Dump: Attemp to dump empty polygon"));
-			return false; // might cause memory leakage
+			Job.error = _T("Dump: Attemp to dump empty polygon");
+			return false;
 		}
 
+		welder.BeginPolygon();
 		PVertex = PPolygon->PVertex;
 		do {
-			current_vertex = connectivity;
-			if (current_vertex->vertex == nullptr) { // Populate the first node
-				current_vertex->vertex = PVertex;
-				current_vertex->polygon_list = new PolygonList();
-				current_vertex->polygon_list->skel_polygon = PPolygon;
-				current_vertex->polygon_list->polygon = new_polygon;
-			} else {
-				while (!areVerticesEqual(current_vertex->vertex, PVertex) && current_vertex->next != nullptr) {
-					current_vertex = current_vertex->next;
-				}
-				if (areVerticesEqual(current_vertex->vertex, PVertex)) { // We found the vertex
-					current_polygon = current_vertex->polygon_list;
-					while (current_polygon->skel_polygon != PPolygon && current_polygon->next != nullptr) {
-						current_polygon = current_polygon->next;
-					}
-					if (current_polygon->next == nullptr) {
-						current_polygon->next = new PolygonList();
-						current_polygon->next->skel_polygon = PPolygon;
-						current_polygon->next->polygon = new_polygon;
-						// If we found the polygon, it means the vertex was the one 
-						// who closes the loop for the polygon, so no need for the else clause
-					}
-				} else { // Vertex is not on the list
-					current_vertex->next = new VertexList();
-					current_vertex->next->vertex = PVertex;
-					current_vertex->next->polygon_list = new PolygonList();
-					current_vertex->next->polygon_list->skel_polygon = PPolygon;
-					current_vertex->next->polygon_list->polygon = new_polygon;
-				}
-			}
+			welder.AddCorner(PVertex->Coord[0], PVertex->Coord[1], PVertex->Coord[2]);
 			PVertex = PVertex->Pnext;
 		} while (PVertex != nullptr && PVertex != PPolygon->PVertex);
 	}
 
+	// The polygons around every vertex
+	welder.BuildAdjacency();
+	weld_us = CGSkelMicrosecondsSince(start);
+
+	// Area weighted normals of the vertices which irit has no normal for
+	start = CGSkelClock::now();
+	VertexNormals normals;
+	normals.Compute(welder, NORMALS_AREA_WEIGHTED, 0);
+	normals_us = CGSkelMicrosecondsSince(start);
+	start = CGSkelClock::now();
+
+	// All the vertices are added in the third pass, in one allocation
+	irit_object->reserveVertices(object_vertices_nr);
+
 	// Second pass - calculate polygon normals
-	current_polygon = all_polygons;
+	current_polygon = Job.all_polygons;
 	while (current_polygon != nullptr) {
 		center_mass_x = 0;
 		center_mass_y = 0;
@@ -317,15 +1524,12 @@ bool CGSkelStoreData(IPObjectStruct *PObj)
 	}
 
 	// Third pass - populate the world
-	current_polygon = all_polygons;
+	current_polygon = Job.all_polygons;
+	corner = 0;
 	do {
-		int polygon_count = 0;
 		bool is_irit_normal;
-		PolygonList *iterator;
 		Vector vertex_normal;
 
-		irit_object->addPolygonP(current_polygon->polygon);
-
 		PVertex = current_polygon->skel_polygon->PVertex;
 		do { // Assume at least one vertex in the polygon
 			vertex_normal = Vector(0, 0, 0, 1);
@@ -333,70 +1537,231 @@ bool CGSkelStoreData(IPObjectStruct *PObj)
 			if (IP_HAS_NORMAL_VRTX(PVertex)) {
 				is_irit_normal = true;
 			} else {
-				// Find vertex in vertices list
-				current_vertex = connectivity;
-				while (current_vertex->vertex != PVertex) { // It should find it
-					current_vertex = current_vertex->next;
-				}
-				iterator = current_vertex->polygon_list;
-				while (iterator != nullptr) {
-					vertex_normal += current_polygon->polygon->normal_end - current_polygon->polygon->normal_start;
-					polygon_count++;
-					iterator = iterator->next;
-				}
-				vertex_normal = vertex_normal * (1.0 / polygon_count);
-				vertex_normal.Normalize();
+				// Corners are visited in the same order they were welded
+				const double *normal = normals.getNormal(welder.getCornerVertex(corner));
+
+				vertex_normal = Vector(normal[0], normal[1], normal[2], 1);
 			}
 			current_polygon->polygon->addPoint(PVertex, is_irit_normal, vertex_normal);
 
-			if (is_first_polygon) {
-				is_first_polygon = false;
-				world.max_bound_coord[0] = PVertex->Coord[0];
-				world.min_bound_coord[0] = PVertex->Coord[0];
-				world.max_bound_coord[1] = PVertex->Coord[1];
-				world.min_bound_coord[1] = PVertex->Coord[1];
-				world.max_bound_coord[2] = PVertex->Coord[2];
-				world.min_bound_coord[2] = PVertex->Coord[2];
-			} else {
-				updateBoundingFrameLimits(PVertex);
-			}
+			updateBoundingFrameLimits(Job, PVertex->Coord);
 
+			corner++;
 			PVertex = PVertex->Pnext;
 		} while (PVertex != current_polygon->skel_polygon->PVertex && PVertex != NULL);		
 
 		current_polygon = current_polygon->next;
 	} while (current_polygon != nullptr);
 
+	// The points were added in the order they were welded in
+	irit_object->buildEdges(welder.getCornerVertices(), welder.getVerticesNr());
+
+	/* The object and its polygon list were allocated while it was welded,
+	   but they're part of building it */
+	build_us = CGSkelMicrosecondsSince(start);
+	long long allocations_nr = job_usage.getAllocationsNr() + figure_usage.getAllocationsNr(),
+			  bytes_allocated = job_usage.getBytesAllocated() + figure_usage.getBytesAllocated();
+
+	CGSkelCountStage(Job, CGSKEL_STAGE_WELD, 1, object_vertices_nr, weld_us, welder.getAllocationsNr(),
+					 welder.getBytesAllocated());
+	CGSkelCountStage(Job, CGSKEL_STAGE_NORMALS, 1, object_vertices_nr, normals_us, normals.getAllocationsNr(),
+					 normals.getBytesAllocated());
+	CGSkelCountStage(Job, CGSKEL_STAGE_BUILD, 1, object_vertices_nr, build_us, allocations_nr, bytes_allocated);
+	CGSkelRecordObject(Job, polygons_nr, object_vertices_nr, weld_us + normals_us + build_us,
+					   welder.getAllocationsNr() + normals.getAllocationsNr() + allocations_nr,
+					   welder.getBytesAllocated() + normals.getBytesAllocated() + bytes_allocated);
+
 	/* Close the object. */
 	return true;
 }
 
-void updateBoundingFrameLimits(IPVertexStruct *vertex)
+/*****************************************************************************
+* DESCRIPTION:                                                               *
+*   Stores an object read by the native parser, like CGSkelStoreData: welds *
+* it, computes its vertex normals and builds it, on the calling thread.      *
+*                                                                            *
+* PARAMETERS:                                                                *
+*   Job:        The file the object is from.                                 *
+*   Object:     Object to store.                                             *
+*                                                                            *
+* RETURN VALUE:                                                              *
+*   bool:		false - fail, true - success.                                *
+*****************************************************************************/
+bool CGSkelStoreItdObject(CGSkelLoadJob &Job, const ItdObject &Object)
 {
-	IritFigure &figure = world.getLastFigure();
+	int vertices_nr = Object.getVerticesNr();
+	CGSkelClock::time_point start = CGSkelClock::now();
+	long long weld_us, normals_us, build_us;
 
-	world.min_bound_coord[0] = MIN(world.min_bound_coord[0], vertex->Coord[0]);
-	world.max_bound_coord[0] = MAX(world.max_bound_coord[0], vertex->Coord[0]);
-	world.min_bound_coord[1] = MIN(world.min_bound_coord[1], vertex->Coord[1]);
-	world.max_bound_coord[1] = MAX(world.max_bound_coord[1], vertex->Coord[1]);
-	world.min_bound_coord[2] = MIN(world.min_bound_coord[2], vertex->Coord[2]);
-	world.max_bound_coord[2] = MAX(world.max_bound_coord[2], vertex->Coord[2]);
+	// Vertices which are closer than EPSILON are considered the same vertex
+	VertexWelder welder(EPSILON, vertices_nr);
+	VertexNormals normals;
+
+	if (!CGSkelWeldItdObject(Job, Object, welder))
+		return false;
+	weld_us = CGSkelMicrosecondsSince(start);
+	CGSkelCountStage(Job, CGSKEL_STAGE_WELD, 1, vertices_nr, weld_us, welder.getAllocationsNr(),
+					 welder.getBytesAllocated());
+
+	start = CGSkelClock::now();
+	normals.Compute(welder, NORMALS_AREA_WEIGHTED, Job.normals_threads_nr);
+	normals_us = CGSkelMicrosecondsSince(start);
+	CGSkelCountStage(Job, CGSKEL_STAGE_NORMALS, 1, vertices_nr, normals_us, normals.getAllocationsNr(),
+					 normals.getBytesAllocated());
+
+	start = CGSkelClock::now();
+	CGSkelArenaUsage usage(Job.figure->getArena());
+	CGSkelBuildItdObject(Job, Object, welder, normals);
+	build_us = CGSkelMicrosecondsSince(start);
+	CGSkelCountStage(Job, CGSKEL_STAGE_BUILD, 1, vertices_nr, build_us, usage.getAllocationsNr(),
+					 usage.getBytesAllocated());
+
+	CGSkelRecordObject(Job, Object.getPolygonsNr(), vertices_nr, weld_us + normals_us + build_us,
+					   welder.getAllocationsNr() + normals.getAllocationsNr() + usage.getAllocationsNr(),
+					   welder.getBytesAllocated() + normals.getBytesAllocated() + usage.getBytesAllocated());
 
-	figure.min_bound_coord[0] = MIN(figure.min_bound_coord[0], vertex->Coord[0]);
-	figure.max_bound_coord[0] = MAX(figure.max_bound_coord[0], vertex->Coord[0]);
-	figure.min_bound_coord[1] = MIN(figure.min_bound_coord[1], vertex->Coord[1]);
-	figure.max_bound_coord[1] = MAX(figure.max_bound_coord[1], vertex->Coord[1]);
-	figure.min_bound_coord[2] = MIN(figure.min_bound_coord[2], vertex->Coord[2]);
-	figure.max_bound_coord[2] = MAX(figure.max_bound_coord[2], vertex->Coord[2]);
+	return true;
 }
 
-bool areVerticesEqual(IPVertexStruct *first, IPVertexStruct *second) {
-	if ((abs(first->Coord[0] - second->Coord[0]) < EPSILON) &&
-		(abs(first->Coord[1] - second->Coord[1]) < EPSILON) &&
-		(abs(first->Coord[2] - second->Coord[2]) < EPSILON)) {
-		return true;
+/*****************************************************************************
+* DESCRIPTION:                                                               *
+*   Finds the vertices an object's polygons share, and the polygons around   *
+* every vertex.                                                              *
+*                                                                            *
+* PARAMETERS:                                                                *
+*   Job:        The file the object is from.                                 *
+*   Object:     Object to weld.                                              *
+*   Welder:     An empty welder, which the object is welded into.            *
+*                                                                            *
+* RETURN VALUE:                                                              *
+*   bool:		false - the object has an empty polygon, true - success.      *
+*****************************************************************************/
+bool CGSkelWeldItdObject(CGSkelLoadJob &Job, const ItdObject &Object, VertexWelder &Welder)
+{
+	const int *polygon_offsets = Object.getPolygonsOffsets();
+	const double *coordinates = Object.coordinates.data();
+	int polygons_nr = Object.getPolygonsNr();
+
+	for (int p = 0; p < polygons_nr; p++) {
+		if (polygon_offsets[p] == polygon_offsets[p + 1]) {
+			Job.error = _T("Dump: Attemp to dump empty polygon");
+			return false;
+		}
+
+		Welder.BeginPolygon();
+		for (int v = polygon_offsets[p]; v < polygon_offsets[p + 1]; v++)
+			Welder.AddCorner(coordinates[3 * v], coordinates[3 * v + 1], coordinates[3 * v + 2]);
+	}
+
+	Welder.BuildAdjacency();
+
+	return true;
+}
+
+/*****************************************************************************
+* DESCRIPTION:                                                               *
+*   Creates the IritObject of a welded object in the job's figure, with the  *
+* object's color, polygon normals, points and edges.                         *
+*                                                                            *
+* PARAMETERS:                                                                *
+*   Job:        The file the object is from.                                 *
+*   Object:     Object to build.                                             *
+*   Welder:     The object, welded.                                          *
+*   Normals:    The normals of the welded vertices.                          *
+*                                                                            *
+* RETURN VALUE:                                                              *
+*   void									                                 *
+*****************************************************************************/
+void CGSkelBuildItdObject(CGSkelLoadJob &Job, const ItdObject &Object, const VertexWelder &Welder,
+						  const VertexNormals &Normals)
+{
+	const int *polygon_offsets = Object.getPolygonsOffsets();
+	const double *coordinates = Object.coordinates.data();
+	int polygons_nr = Object.getPolygonsNr(),
+		vertices_nr = Object.getVerticesNr();
+	double RGB[3];
+	IritObject *irit_object = Job.figure->createObject();
+
+	assert(irit_object);
+
+	if (CGSkelGetItdObjectColor(Object, RGB))
+	{
+		irit_object->object_color = {(BYTE)(RGB[2] * 255.0), (BYTE)(RGB[1] * 255.0), (BYTE)(RGB[0] * 255.0), 0};
+	}
+
+	irit_object->reserveVertices(vertices_nr);
+
+	for (int p = 0; p < polygons_nr; p++) {
+		IritPolygon *irit_polygon = irit_object->createPolygon();
+		int first = polygon_offsets[p], points_nr = polygon_offsets[p + 1] - first;
+		Vector center_mass(0, 0, 0, 1);
+
+		// Polygon normal, from the plane if the file has one
+		irit_polygon->normal_end = Vector(0, 0, 0, 1);
+		if (Object.has_plane[p]) {
+			irit_polygon->is_irit_normal = true;
+			for (int j = 0; j < 3; j++)
+				irit_polygon->normal_end[j] = Object.planes[4 * p + j];
+		} else if (points_nr >= 3) {
+			const double *c = coordinates + 3 * first;
+			Vector first_point(c[0], c[1], c[2], 1),
+				   second_point(c[3], c[4], c[5], 1),
+				   third_point(c[6], c[7], c[8], 1);
+
+			irit_polygon->normal_end = (second_point - first_point) ^ (third_point - second_point);
+			irit_polygon->normal_end.Normalize();
+		}
+
+		// FOR SMALLER POLYGON NORMALS
+		irit_polygon->normal_end = irit_polygon->normal_end * 0.3;
+
+		for (int v = first; v < first + points_nr; v++) {
+			for (int j = 0; j < 3; j++)
+				center_mass[j] += coordinates[3 * v + j] / points_nr;
+		}
+
+		irit_polygon->normal_start = center_mass;
+		irit_polygon->normal_end = irit_polygon->normal_end + irit_polygon->normal_start;
+		irit_polygon->normal_end[3] = 1;
+
+		// The points, in the same order they were welded
+		for (int v = first; v < first + points_nr; v++) {
+			const double *coord = coordinates + 3 * v;
+			const double *normal = (Object.has_normal[v]) ? &Object.normals[3 * v]
+														  : Normals.getNormal(Welder.getCornerVertex(v));
+			IritPoint point;
+
+			point.vertex = Vector(coord[0], coord[1], coord[2], 1);
+			point.normal = Vector(normal[0], normal[1], normal[2], 1);
+			point.is_irit_normal = Object.has_normal[v] != 0;
+			irit_polygon->addPoint(point);
+
+			updateBoundingFrameLimits(Job, coord);
+		}
+	}
+
+	irit_object->buildEdges(Welder.getCornerVertices(), Welder.getVerticesNr());
+}
+
+/* Grows the bounding frame of the objects the job stored to hold @coord.
+ * The figure's frame is set when they are published */
+void updateBoundingFrameLimits(CGSkelLoadJob &Job, const double *coord)
+{
+	if (Job.is_first_vertex) {
+		Job.is_first_vertex = false;
+		for (int i = 0; i < 3; i++) {
+			Job.min_bound_coord[i] = coord[i];
+			Job.max_bound_coord[i] = coord[i];
+		}
+		return;
 	}
-	return false;
+
+	Job.min_bound_coord[0] = MIN(Job.min_bound_coord[0], coord[0]);
+	Job.max_bound_coord[0] = MAX(Job.max_bound_coord[0], coord[0]);
+	Job.min_bound_coord[1] = MIN(Job.min_bound_coord[1], coord[1]);
+	Job.max_bound_coord[1] = MAX(Job.max_bound_coord[1], coord[1]);
+	Job.min_bound_coord[2] = MIN(Job.min_bound_coord[2], coord[2]);
+	Job.max_bound_coord[2] = MAX(Job.max_bound_coord[2], coord[2]);
 }
 
 /*****************************************************************************
@@ -411,6 +1776,35 @@ bool areVerticesEqual(IPVertexStruct *first, IPVertexStruct *second) {
 *   int:    TRUE if object has color, FALSE otherwise.                       *
 *****************************************************************************/
 int CGSkelGetObjectColor(IPObjectStruct *PObj, double RGB[3])
+{
+	int i, Color, RGBIColor[3];
+
+	if (AttrGetObjectRGBColor(PObj,
+		&RGBIColor[0], &RGBIColor[1], &RGBIColor[2])) {
+			for (i = 0; i < 3; i++)
+				RGB[i] = RGBIColor[i] / 255.0;
+
+			return TRUE;
+	}
+	else if ((Color = AttrGetObjectColor(PObj)) != IP_ATTR_NO_COLOR) {
+		return CGSkelGetColorIndexRGB(Color, RGB);
+	}
+
+	return FALSE;
+}
+
+/*****************************************************************************
+* DESCRIPTION:                                                               *
+*   Translates an irit color index to its color.                             *
+*                                                                            *
+* PARAMETERS:                                                                *
+*   Color:  Index of the color, as in the COLOR attribute.                   *
+*   RGB:    as 3 floats in the domain [0, 1].                                *
+*                                                                            *
+* RETURN VALUE:                                                              *
+*   int:    TRUE if the index is known, FALSE otherwise.                     *
+*****************************************************************************/
+int CGSkelGetColorIndexRGB(int Color, double RGB[3])
 {
 	static int TransColorTable[][4] = {
 		{ /* BLACK	*/   0,    0,   0,   0 },
@@ -440,28 +1834,49 @@ int CGSkelGetObjectColor(IPObjectStruct *PObj, double RGB[3])
 		{ /* WHITE	*/   63, 255, 255, 255 },
 		{		     -1,   0,   0,   0 }
 	};
-	int i, j, Color, RGBIColor[3];
-
-	if (AttrGetObjectRGBColor(PObj,
-		&RGBIColor[0], &RGBIColor[1], &RGBIColor[2])) {
-			for (i = 0; i < 3; i++)
-				RGB[i] = RGBIColor[i] / 255.0;
+	int i, j;
 
+	for (i = 0; TransColorTable[i][0] >= 0; i++) {
+		if (TransColorTable[i][0] == Color) {
+			for (j = 0; j < 3; j++)
+				RGB[j] = TransColorTable[i][j+1] / 255.0;
 			return TRUE;
-	}
-	else if ((Color = AttrGetObjectColor(PObj)) != IP_ATTR_NO_COLOR) {
-		for (i = 0; TransColorTable[i][0] >= 0; i++) {
-			if (TransColorTable[i][0] == Color) {
-				for (j = 0; j < 3; j++)
-					RGB[j] = TransColorTable[i][j+1] / 255.0;
-				return TRUE;
-			}
 		}
 	}
 
 	return FALSE;
 }
 
+/*****************************************************************************
+* DESCRIPTION:                                                               *
+*   Returns the color of an object read by the native parser.                *
+*                                                                            *
+* PARAMETERS:                                                                *
+*   Object: Object to get its color.                                         *
+*   RGB:    as 3 floats in the domain [0, 1].                                *
+*                                                                            *
+* RETURN VALUE:                                                              *
+*   int:    TRUE if object has color, FALSE otherwise.                       *
+*****************************************************************************/
+int CGSkelGetItdObjectColor(const ItdObject &Object, double RGB[3])
+{
+	const char *Str;
+	int i, RGBIColor[3];
+
+	if ((Str = Object.getAttribute("rgb")) != NULL &&
+		sscanf(Str, "%d,%d,%d", &RGBIColor[0], &RGBIColor[1], &RGBIColor[2]) == 3) {
+		for (i = 0; i < 3; i++)
+			RGB[i] = RGBIColor[i] / 255.0;
+
+		return TRUE;
+	}
+	else if ((Str = Object.getAttribute("color")) != NULL) {
+		return CGSkelGetColorIndexRGB(atoi(Str), RGB);
+	}
+
+	return FALSE;
+}
+
 /*****************************************************************************
 * DESCRIPTION:                                                               *
 *   Returns the volumetric texture of an object, if any.                     *
@@ -8,20 +8,265 @@
 #define	IRIT_SKEL_H
 
 #include <stdlib.h>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <thread>
+#include <vector>
 #include "irit_sm.h"
 #include "iritprsr.h"
 #include "attribut.h"
 #include "allocate.h"
 #include "ip_cnvrt.h"
 #include "symb_lib.h"
+#include "IritObjects.h"
+#include "ItdParser.h"
+#include "LoadProfile.h"
+#include "MeshCache.h"
+#include "VertexNormals.h"
+#include "VertexWelder.h"
 
-bool CGSkelProcessIritDataFiles(CString &FileNames, int NumFiles);
+/* The stages of loading a file. A file is mapped from its cache, or parsed
+   natively, or read, resolved and converted by irit, and then every object
+   is welded, has its normals computed and is built */
+enum CGSkelLoadStage {
+	CGSKEL_STAGE_CACHE,
+	CGSKEL_STAGE_PARSE,
+	CGSKEL_STAGE_READ,
+	CGSKEL_STAGE_RESOLVE,
+	CGSKEL_STAGE_CONVERT,
+	CGSKEL_STAGE_WELD,
+	CGSKEL_STAGE_NORMALS,
+	CGSKEL_STAGE_BUILD,
+	CGSKEL_STAGES_NR
+};
+
+// Throughput of a load stage, counted by whichever thread runs it
+struct CGSkelStageCounters {
+	std::atomic<long long> objects_nr{0};
+	std::atomic<long long> vertices_nr{0};
+	std::atomic<long long> busy_us{0};	// Time spent working, not waiting for other stages
+	// Of the loader's own memory, irit's allocations aren't counted
+	std::atomic<long long> allocations_nr{0};
+	std::atomic<long long> bytes_allocated{0};
+};
+
+/* How freeforms are tessellated, which is also the key of a figure's
+ * tessellations. Surfaces are subdivided adaptively, until they're within
+ * the tolerance, unless the mode is uniform. Other freeforms always use
+ * the fineness. */
+struct CGSkelTessellationParams {
+	TessellationMode mode;
+	double fineness;
+	double tolerance;	// Ignored if the mode is uniform
+
+	bool operator<(const CGSkelTessellationParams &Other) const;
+	bool operator==(const CGSkelTessellationParams &Other) const;
+};
+
+// A range of a figure's objects
+struct CGSkelObjectRange {
+	int first;
+	int nr;
+};
+
+// The objects each freeform of a figure was tessellated to, in the order of the freeforms
+typedef std::vector<CGSkelObjectRange> CGSkelTessellation;
+
+/* The freeforms a figure was loaded from, so they can be tessellated again
+ * when the tessellation parameters change. Every tessellation stays in the
+ * figure, hidden while another one is shown, so going back to parameters
+ * which were used before only shows its objects again. Only the thread which owns the
+ * world changes the tessellations and which one is shown.
+ */
+struct CGSkelFreeformSource : public IritFigureSource {
+	std::vector<IPObjectStruct *> freeforms;
+	std::map<CGSkelTessellationParams, CGSkelTessellation> tessellations;
+	CGSkelTessellationParams shown;
+};
+
+/* Everything the loader keeps while it loads one file. Every file is loaded
+ * into a figure of its own, so jobs share nothing and can run at the same
+ * time. The figure's objects are published as they are stored, so it can be
+ * drawn while it's loaded. */
+struct CGSkelLoadJob {
+	CStringA file_name;
+	MeshCacheKey cache_key;
+	bool has_cache_key;
+	bool needs_irit;	// The native parser can't read the file
+	bool succeeded;
+	CString error;		// Shown once the load is over
+
+	IritFigure *figure;
+	std::unique_ptr<IritFigure> own_figure;	// Until the figure is added to the world
+	bool is_figure_in_world;
+	bool hide_new_objects;		// For tessellations which aren't shown yet
+
+	// The bounding frame of the objects stored so far
+	Vector min_bound_coord, max_bound_coord;
+	bool is_first_vertex;
+
+	// The polygons of the object being stored, allocated from the arena
+	Arena arena;
+	PolygonList *all_polygons;
+
+	CGSkelTessellationParams tessellation_params;
+	IPFreeformConvStateStruct ffc_state;
+	// The objects of an irit file, replaced by their polygons once converted
+	std::vector<IPObjectStruct *> traversed_objects;
+	// Attached to the figure once it's loaded, if the file has freeforms
+	std::unique_ptr<CGSkelFreeformSource> freeform_source;
+	/* Threads the normals of a natively parsed object are computed on, 0 for
+	   all the processors. Files loaded together share the processors */
+	int normals_threads_nr;
+
+	// Progress, read by other threads
+	std::atomic<long long> bytes_done_nr;
+	CGSkelStageCounters stages[CGSKEL_STAGES_NR];
+
+	// What the load took, read once it is over
+	const char *loaded_by;
+	long long wall_us;
+	size_t peak_rss_bytes;
+	std::vector<LoadObjectRecord> object_records;
+
+	const std::atomic<bool> *is_cancelled;	// Null if the load can't be cancelled
+	std::function<void()> on_publish;		// Called after objects are published
+
+	CGSkelLoadJob(const CString &FileName, const CGSkelTessellationParams &Tessellation);
+
+	// A job which adds objects to a figure which is already in the world
+	CGSkelLoadJob(IritFigure *Figure, const CGSkelTessellationParams &Tessellation);
+
+	bool isCancelled() const;
+};
+
+/* Loads files in the background while the world is drawn.
+ *
+ * The files are loaded by CGSkelLoadFiles on a thread of its own. Whenever
+ * a file has new complete objects, the notification callback asks the
+ * thread which owns the world (the UI thread) to call publish(), which adds
+ * new figures to the world and updates its bounding frame. The world is
+ * only changed by publish() and finish(), so the loader threads never
+ * touch it, and a figure is only shared through its published objects.
+ */
+class CGSkelAsyncLoad {
+	std::vector<std::unique_ptr<CGSkelLoadJob>> m_jobs;
+	std::atomic<bool> m_is_cancelled;
+	std::atomic<bool> m_is_done;
+	std::atomic<bool> m_is_notify_pending;
+	std::function<void()> m_notify;
+	long long m_bytes_nr;
+	std::thread m_thread;
+
+	void notify();
+
+public:
+	CGSkelAsyncLoad(const CString *FileNames, int NumFiles, const CGSkelTessellationParams &Tessellation,
+					std::function<void()> Notify);
+
+	// Cancels the load and waits for the loader threads
+	~CGSkelAsyncLoad();
+
+	CGSkelAsyncLoad(const CGSkelAsyncLoad &) = delete;
+	CGSkelAsyncLoad &operator=(const CGSkelAsyncLoad &) = delete;
+
+	// Stops the load as soon as possible. finish() must still be called
+	void cancel();
+
+	// Whether the loader threads are done, so finish() won't wait
+	bool isDone() const;
+
+	// Percent of the bytes of the files which were loaded
+	int getProgress() const;
+
+	/* Must be called before isDone() is checked, since it's what lets the
+	 * loader threads notify again */
+	void publish(IritWorld &World);
+
+	bool finish(IritWorld &World);
+};
+
+/* Tessellates the freeforms of the world's figures with new parameters in
+ * the background.
+ *
+ * Figures which were tessellated with the parameters before switch to them at
+ * once, when the tessellation is created. The others are tessellated on a
+ * thread of their own into hidden objects, and finish() shows them. Only
+ * figures with a CGSkelFreeformSource are tessellated, and those are never
+ * removed from the world, so the thread can keep pointers to them.
+ */
+class CGSkelAsyncTessellation {
+	struct Task {
+		IritFigure *figure;
+		CGSkelFreeformSource *source;
+		CGSkelTessellation tessellation;
+		bool succeeded;
+	};
+
+	std::vector<Task> m_tasks;
+	CGSkelTessellationParams m_params;
+	std::atomic<bool> m_is_cancelled;
+	std::atomic<bool> m_is_done;
+	// Whether a figure was switched to another tessellation. Only used on the owning thread
+	bool m_has_changed;
+	std::thread m_thread;
+
+public:
+	// @Notify is called from the tessellation thread once it's done
+	CGSkelAsyncTessellation(IritWorld &World, const CGSkelTessellationParams &Tessellation,
+							std::function<void()> Notify);
+
+	~CGSkelAsyncTessellation();
+
+	CGSkelAsyncTessellation(const CGSkelAsyncTessellation &) = delete;
+	CGSkelAsyncTessellation &operator=(const CGSkelAsyncTessellation &) = delete;
+
+	// Stops at the next freeform. finish() must still be called
+	void cancel();
+
+	// Whether the thread is done (or there was nothing to tessellate)
+	bool isDone() const;
+
+	// Waits for the thread, and shows the new tessellations unless cancelled
+	void finish();
+
+	/* Whether any figure now shows another tessellation, either switched to
+	   at once or by finish() */
+	bool hasChanged() const;
+};
+
+bool CGSkelProcessIritDataFiles(const CString *FileNames, int NumFiles);
+void CGSkelLoadFiles(std::vector<std::unique_ptr<CGSkelLoadJob>> &Jobs);
+void CGSkelLoadFile(CGSkelLoadJob &Job);
+bool CGSkelParseIritDataFile(CGSkelLoadJob &Job);
+ItdParseResult CGSkelLoadItdFile(CGSkelLoadJob &Job);
+bool CGSkelLoadMeshCache(CGSkelLoadJob &Job);
+void CGSkelPublishObjects(CGSkelLoadJob &Job);
+void CGSkelTraceStageCounters(const CGSkelLoadJob &Job);
+LoadFigureRecord CGSkelGetLoadRecord(const CGSkelLoadJob &Job);
+void CGSkelWriteLoadProfile(const std::vector<std::unique_ptr<CGSkelLoadJob>> &Jobs);
 void CGSkelDumpOneTraversedObject(IPObjectStruct *PObj, IrtHmgnMatType Mat, void *Data);
+void CGSkelConvertFreeForms(CGSkelLoadJob &Job);
+IPObjectStruct *CGSkelConvertSurfaceAdaptively(IPObjectStruct *PObj, double Tolerance,
+											   const IPFreeformConvStateStruct &State);
+CagdRType CGSkelNormalDeviationError(const CagdSrfStruct *Srf, CagdRType Tolerance, void *AuxData);
+bool CGSkelStoreConvertedObjects(CGSkelLoadJob &Job, const std::vector<bool> &IsFreeForm,
+								 CGSkelTessellation *Tessellation);
+CGSkelTessellationParams CGSkelGetTessellationParams(const State &State);
+bool CGSkelShowTessellation(IritFigure &Figure, const CGSkelTessellationParams &Tessellation);
+void CGSkelAttachFreeformSource(CGSkelLoadJob &Job);
 int CGSkelGetObjectColor(IPObjectStruct *PObj, double RGB[3]);
+int CGSkelGetColorIndexRGB(int Color, double RGB[3]);
+int CGSkelGetItdObjectColor(const ItdObject &Object, double RGB[3]);
 const char *CGSkelGetObjectTexture(IPObjectStruct *PObj);
 const char *CGSkelGetObjectPTexture(IPObjectStruct *PObj);
 int CGSkelGetObjectTransp(IPObjectStruct *PObj, double *Transp);
 
-bool CGSkelStoreData(IPObjectStruct *PObj);
+bool CGSkelStoreData(CGSkelLoadJob &Job, IPObjectStruct *PObj);
+bool CGSkelStoreItdObject(CGSkelLoadJob &Job, const ItdObject &Object);
+bool CGSkelWeldItdObject(CGSkelLoadJob &Job, const ItdObject &Object, VertexWelder &Welder);
+void CGSkelBuildItdObject(CGSkelLoadJob &Job, const ItdObject &Object, const VertexWelder &Welder,
+						  const VertexNormals &Normals);
 
 #endif // IRIT_SKEL_H